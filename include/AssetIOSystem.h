@@ -0,0 +1,34 @@
+#pragma once
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+#include "VirtualFileSystem.h"
+
+// Read-only Assimp stream over an asset's bytes
+class MemoryIOStream : public Assimp::IOStream
+{
+public:
+    explicit MemoryIOStream(AssetData asset);
+
+    size_t Read(void *buffer, size_t size, size_t count) override;
+    size_t Write(const void *buffer, size_t size, size_t count) override;
+    aiReturn Seek(size_t offset, aiOrigin origin) override;
+    size_t Tell() const override;
+    size_t FileSize() const override;
+    void Flush() override;
+
+private:
+    AssetData asset;
+    size_t position;
+};
+
+// Lets Assimp importers read through the virtual filesystem. Model files pull
+// in companion files (OBJ -> MTL, FBX external references), so a whole IO
+// system is needed rather than a single ReadFileFromMemory buffer.
+class AssetIOSystem : public Assimp::IOSystem
+{
+public:
+    bool Exists(const char *file) const override;
+    char getOsSeparator() const override;
+    Assimp::IOStream *Open(const char *file, const char *mode = "rb") override;
+    void Close(Assimp::IOStream *stream) override;
+};
@@ -0,0 +1,95 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// On-disk layout of assets.pak (little endian, written by tools/AssetPacker.cpp):
+//   PackHeader
+//   PackEntry[entryCount]    sorted by pathHash so lookups are a binary search
+//   path string table        entry paths, not null terminated
+//   file data                every blob starts on a PACK_DATA_ALIGNMENT boundary
+static const char PACK_MAGIC[4] = {'S', 'C', 'P', 'K'};
+static const uint32_t PACK_VERSION = 1;
+static const uint64_t PACK_DATA_ALIGNMENT = 64;
+
+struct PackHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t reserved;
+    uint64_t stringTableOffset;
+    uint64_t stringTableSize;
+};
+
+struct PackEntry
+{
+    uint64_t pathHash;    // HashPath() of the normalized path
+    uint64_t offset;      // Absolute offset of the data in the file
+    uint64_t size;        // Size of the data in bytes
+    uint64_t contentHash; // HashBytes() of the data, usable as a cache key
+    uint32_t pathOffset;  // Offset of the path inside the string table
+    uint32_t pathLength;
+};
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool open(const std::string &path);
+    void close();
+
+    const unsigned char *data() const { return mappedData; }
+    size_t size() const { return mappedSize; }
+    bool isOpen() const { return mappedData != nullptr; }
+
+private:
+    const unsigned char *mappedData;
+    size_t mappedSize;
+#ifdef _WIN32
+    void *fileHandle;
+    void *mappingHandle;
+#endif
+};
+
+// Asset archive served straight out of a memory mapping. Lookups return
+// pointers into the mapping, so loaders decode without an intermediate copy.
+class AssetPack
+{
+public:
+    bool open(const std::string &path);
+    void close();
+    bool isOpen() const { return file.isOpen(); }
+
+    // Paths are normalized first, so "../images/RockWall/a.obj" and
+    // "images/RockWall/a.obj" refer to the same entry
+    const PackEntry *findEntry(const std::string &path) const;
+    const unsigned char *find(const std::string &path, size_t &size) const;
+    bool contains(const std::string &path) const { return findEntry(path) != nullptr; }
+
+    const std::string &getPath() const { return packPath; }
+    size_t getEntryCount() const { return entryCount; }
+    std::string getEntryPath(size_t index) const;
+    const PackEntry &getEntry(size_t index) const { return entries[index]; }
+
+    static uint64_t HashPath(const std::string &normalizedPath);
+    static uint64_t HashBytes(const void *data, size_t size, uint64_t seed = 1469598103934665603ULL);
+
+    // Turns any path that reaches into images/ or shaders/ into its pack key:
+    // forward slashes, "." and ".." folded, everything before the last
+    // images/ or shaders/ component dropped
+    static std::string NormalizePath(const std::string &path);
+
+private:
+    MappedFile file;
+    std::string packPath;
+    const PackEntry *entries = nullptr;
+    size_t entryCount = 0;
+    const char *stringTable = nullptr;
+};
@@ -0,0 +1,74 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "LockFreeQueue.h"
+
+// Runtime asset streaming. File reads, image decodes and model imports run on
+// a worker pool; their results come back to the GL thread through a lock-free
+// queue and are uploaded in processUploads(), which stops once the per-frame
+// time or byte budget is spent. Requested textures get a real GL name at once
+// and show a neutral placeholder until their pixels are resident; their mip
+// chains are then handed to TextureResidency, which streams in the levels the
+// textures' on-screen size calls for.
+class AssetStreamer
+{
+public:
+    // Worker job: runs off the GL thread and returns the bytes its finish step will upload
+    using WorkFn = std::function<size_t()>;
+    // GL thread step, run from processUploads
+    using FinishFn = std::function<void()>;
+
+    static AssetStreamer &Get();
+
+    // threadCount 0 uses all cores but one, which is left to the render thread
+    void start(unsigned int threadCount = 0);
+    // Joins the workers; jobs that have not finished are dropped and keep their placeholders
+    void shutdown();
+    bool isRunning() const { return running; }
+
+    // GL thread only. Returns a texture that is usable immediately, or 0 when the file
+    // does not exist. Repeated requests for the same path return the same texture.
+    unsigned int requestTexture(const std::string &path);
+
+    // finish may be empty for jobs that only warm a cache
+    void submit(WorkFn work, FinishFn finish);
+
+    // GL thread, once per frame. Always completes at least one job when any are ready.
+    void processUploads(float budgetMs, size_t budgetBytes);
+
+    // Submitted jobs whose finish step has not run yet
+    int getPendingCount() const { return pending.load(); }
+    bool isIdle() const { return pending.load() == 0; }
+
+private:
+    AssetStreamer();
+    ~AssetStreamer();
+
+    struct Job
+    {
+        WorkFn work;
+        FinishFn finish;
+        size_t uploadBytes = 0;
+    };
+
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    std::deque<Job *> requests; // Guarded by requestMutex; workers sleep on requestReady
+    std::mutex requestMutex;
+    std::condition_variable requestReady;
+    LockFreeQueue<Job *> completed;
+    std::atomic<bool> stopping;
+    std::atomic<int> pending;
+    bool running;
+
+    std::unordered_map<std::string, unsigned int> textures; // GL thread only
+};
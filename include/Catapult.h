@@ -6,7 +6,7 @@ class Catapult
 {
 public:
     Catapult();
-    void draw(unsigned int shaderProgram, float height = 0.0f, const glm::vec3 &terrainNormal = glm::vec3(0.0f, 1.0f, 0.0f));
+    void draw(float height = 0.0f, const glm::vec3 &terrainNormal = glm::vec3(0.0f, 1.0f, 0.0f));
     void update(float deltaTime); // Update animation
     void fire();                  // Trigger arm animation
     void reset();                 // Reset catapult to initial state (reattach release rope, reset arm)
@@ -292,6 +292,8 @@ private:
     glm::vec3 pivotPoint; // Arm pivot point
     float armLength_old;  // Length of arm from pivot to bucket
     int vertexCounts[20]; // Vertex counts for each component
+    glm::vec3 boundsMin;  // Local box of the current geometry, for frustum culling
+    glm::vec3 boundsMax;
 
     // Base/tier configuration
     float plankWidthX = 2.25f;
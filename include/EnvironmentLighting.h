@@ -0,0 +1,58 @@
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+#include "ShaderProgram.h"
+
+// Sky lighting derived once from the skybox cubemap: 9-coefficient SH
+// irradiance for ambient light and a small prefiltered cubemap for glossy
+// reflections. The precompute runs on CPU worker threads, so it needs no GL
+// context, and its result is cached on disk next to the skybox cache.
+class EnvironmentLighting
+{
+public:
+    EnvironmentLighting();
+    ~EnvironmentLighting();
+
+    // Loads the cache, or reads back a small mip of the cubemap, precomputes and writes the cache.
+    // cachePath may be empty to skip caching.
+    bool build(unsigned int cubemapTexture, int cubemapSize, const std::string &cachePath);
+    // Reads the cache into a staging copy without touching GL or the live lighting, so build()
+    // only has to adopt and upload it. Safe on a worker thread while bind() runs on the GL thread.
+    bool preload(const std::string &cachePath);
+
+    // CPU-only precompute. faces holds 6 square faces of size x size RGB floats in GL face order.
+    // The result is only used by bind() once build() has uploaded it.
+    void compute(const std::vector<float> &faces, int size, unsigned int threadCount = 0);
+
+    // Sets the lighting uniforms and binds the prefiltered cubemap to textureUnit.
+    // rotation maps world directions into cubemap directions (the skybox spins).
+    void bind(ShaderProgram &program, const glm::mat3 &rotation, int textureUnit) const;
+
+    bool isReady() const { return ready; }
+    const glm::vec3 *getSHCoefficients() const { return shCoefficients; }
+
+private:
+    // What the cache holds; preload() fills one off the GL thread
+    struct Precomputed
+    {
+        glm::vec3 shCoefficients[9];
+        int prefilterSize = 0;
+        std::vector<std::vector<float>> prefilterLevels;
+    };
+
+    static bool loadCache(const std::string &path, Precomputed &out);
+    void saveCache(const std::string &path) const;
+    void adopt(Precomputed &precomputed);
+    void uploadPrefiltered();
+
+    glm::vec3 shCoefficients[9];
+    int prefilterSize;
+    std::vector<std::vector<float>> prefilterLevels; // RGB floats, 6 faces per level
+    unsigned int prefilterTexture;
+    // Set on the GL thread once the prefiltered cubemap is uploaded; bind() reads nothing before
+    bool ready;
+    Precomputed staged;
+    bool preloaded;
+};
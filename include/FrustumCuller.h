@@ -0,0 +1,81 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// World AABB of a local box, given as center and size (Model::getCenter/getSize), placed by model
+void TransformBox(const glm::mat4 &model, const glm::vec3 &localCenter, const glm::vec3 &localSize, glm::vec3 &min,
+                  glm::vec3 &max);
+
+// World-space bounds of a set of renderables, one array per component so the culling
+// kernel loads four objects per register. Each entry is an AABB and the sphere around it.
+struct CullBounds
+{
+    std::vector<float> centerX, centerY, centerZ, radius;
+    std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+
+    size_t size() const { return radius.size(); }
+    void box(size_t i, glm::vec3 &min, glm::vec3 &max) const
+    {
+        min = glm::vec3(minX[i], minY[i], minZ[i]);
+        max = glm::vec3(maxX[i], maxY[i], maxZ[i]);
+    }
+    void clear();
+    void add(const glm::vec3 &min, const glm::vec3 &max);
+    // Local box placed by model, as TransformBox()
+    void add(const glm::mat4 &model, const glm::vec3 &localCenter, const glm::vec3 &localSize);
+    // Stands in for an object whose extent is not known yet; never culled
+    void addUnbounded();
+};
+
+// Frustum test for everything drawn in a frame. Spheres reject most objects outside the
+// view with one dot product per plane; the survivors' boxes are then tested against the
+// plane's nearest corner, which removes the large spheres of long, thin walls. Both run
+// four objects at a time with SSE where available.
+class FrustumCuller
+{
+public:
+    struct Stats
+    {
+        unsigned long submitted = 0;
+        unsigned long visible = 0;
+    };
+
+    enum class Containment
+    {
+        Outside,
+        Partial,
+        Inside
+    };
+
+    static FrustumCuller &Get();
+
+    // Planes of projection * view, for every test until the next call
+    void setViewProjection(const glm::mat4 &viewProjection);
+
+    // visible[i] is 1 when entry i of bounds intersects the frustum, else 0
+    void test(const CullBounds &bounds, std::vector<uint8_t> &visible);
+    // One object; a batch of one through the same test
+    bool isVisible(const glm::vec3 &min, const glm::vec3 &max);
+    bool isVisible(const glm::mat4 &model, const glm::vec3 &localCenter, const glm::vec3 &localSize);
+    // Scalar box test for hierarchy traversal, which can accept a whole subtree when Inside.
+    // Not counted in the stats; the caller reports what it culls.
+    Containment classify(const glm::vec3 &min, const glm::vec3 &max) const;
+    // Scalar sphere test for the many small parts of one object; not counted in the stats either
+    bool intersectsSphere(const glm::vec3 &center, float radius) const;
+
+    // Objects tested in the frame so far
+    static Stats &FrameStats();
+    // Totals of the previous frame; EndFrame() moves the running counts there
+    static const Stats &LastFrameStats();
+    static void EndFrame();
+
+private:
+    FrustumCuller() = default;
+
+    // a*x + b*y + c*z + d >= 0 inside, normalised so d is a distance
+    float planeA[6] = {}, planeB[6] = {}, planeC[6] = {}, planeD[6] = {};
+    CullBounds single;
+    std::vector<uint8_t> singleResult;
+};
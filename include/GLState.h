@@ -0,0 +1,63 @@
+#pragma once
+#include <GL/glew.h>
+
+// Shadow of the GL binding and fixed-function state the draw code touches. A change
+// to the value already set is dropped, and queries are answered from the shadow
+// instead of syncing with the driver. Loaders and streaming callbacks still bind
+// directly, so invalidate() runs at the start of each frame's draw section and the
+// first change of every kind after it is always issued.
+class GLState
+{
+public:
+    struct Stats
+    {
+        unsigned long issued = 0;
+        unsigned long elided = 0;
+    };
+
+    // Texture units shadowed; higher units pass straight through
+    static const int MaxTextureUnits = 16;
+
+    static GLState &Get();
+
+    void invalidate();
+
+    void useProgram(unsigned int program);
+    void bindVertexArray(unsigned int vertexArray);
+    // Only GL_ARRAY_BUFFER is shadowed; the element buffer binding belongs to the bound VAO
+    void bindBuffer(GLenum target, unsigned int buffer);
+    // target is GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY or GL_TEXTURE_CUBE_MAP
+    void bindTexture(int unit, GLenum target, unsigned int texture);
+
+    void setDepthTest(bool enabled);
+    void setDepthFunc(GLenum func);
+    void setBlend(bool enabled);
+    void setBlendFunc(GLenum source, GLenum destination);
+    // Asks the driver only while the shadow does not know yet
+    bool isDepthTestEnabled();
+
+    // State changes of the frame so far
+    static Stats &FrameStats();
+    // Totals of the previous frame; EndFrame() moves the running counts there
+    static const Stats &LastFrameStats();
+    static void EndFrame();
+
+private:
+    GLState();
+
+    static int targetIndex(GLenum target);
+    // True when the change has to be issued; counts it either way
+    static bool differs(long &shadowed, long value);
+
+    // -1 marks a value the shadow does not know
+    long program;
+    long vertexArray;
+    long arrayBuffer;
+    long activeUnit;
+    long textures[MaxTextureUnits][3];
+    long depthTest;
+    long depthFunc;
+    long blend;
+    long blendSource;
+    long blendDestination;
+};
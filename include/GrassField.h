@@ -0,0 +1,62 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "ShaderProgram.h"
+
+// Ground cover of grass blades with no per-blade data anywhere. The area is cut into
+// square chunks, each with a seed; a chunk is one instanced draw of a seven-vertex strip
+// whose vertex shader places, shapes and sways blade gl_InstanceID from the seed alone.
+// Blades follow a low-discrepancy sequence, so any leading run of them covers the chunk
+// evenly: density falls off with distance by drawing fewer of them, and the last blades
+// still drawn shrink away instead of popping. Chunks off screen or behind the occluders
+// of SoftwareOcclusion are skipped.
+class GrassField
+{
+public:
+    struct Stats
+    {
+        unsigned long chunksDrawn = 0;
+        unsigned long chunksSkipped = 0; // Outside the frustum, too far away or occluded
+        unsigned long blades = 0;
+    };
+
+    static const int VerticesPerBlade = 7;
+
+    // Covers min to max in xz at groundHeight. Blades per square unit close to the camera come
+    // from SIMPLECATAPULT_GRASS_DENSITY when set; 0 turns the grass off.
+    GrassField(const glm::vec2 &min, const glm::vec2 &max, float groundHeight, uint32_t seed = 1);
+    ~GrassField();
+    GrassField(const GrassField &) = delete;
+    GrassField &operator=(const GrassField &) = delete;
+
+    // GL thread, after the scene draws. frameSetup sets the view, sun and environment
+    // uniforms as it does for the scene shaders; time drives the wind.
+    void draw(const std::function<void(ShaderProgram &program)> &frameSetup, const glm::vec3 &viewPos, float time);
+
+    // Counts of the frame so far
+    static Stats &FrameStats();
+    // Totals of the previous frame; EndFrame() moves the running counts there
+    static const Stats &LastFrameStats();
+    static void EndFrame();
+
+private:
+    struct Chunk
+    {
+        glm::vec2 min;
+        uint32_t seed;
+    };
+
+    bool createResources();
+
+    std::vector<Chunk> chunks;
+    float groundHeight;
+    float bladesPerChunk = 0.0f; // At full density
+    bool failed = false;
+
+    ShaderProgram shader;
+    unsigned int emptyVAO = 0; // Core profile draws need a vertex array, even one without attributes
+    int chunkOriginSlot = -1;
+    int chunkSeedSlot = -1;
+};
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Equirectangular HDR image as RGB half floats, bottom row first (GL upload order)
+struct HdrImage
+{
+    int width = 0;
+    int height = 0;
+    int sourceWidth = 0; // Resolution of the file before filtering
+    int sourceHeight = 0;
+    std::vector<uint16_t> pixels;
+};
+
+// Radiance (.hdr) decoder that never holds the full-resolution image. Scanlines
+// are RLE-decoded one at a time and box-filtered straight into the output, so
+// memory is bounded by the output size plus one scanline per worker.
+class HdrDecoder
+{
+public:
+    static bool IsRadiance(const unsigned char *data, size_t size);
+    // Header-only parse, touches just the first few hundred bytes
+    static bool ReadDimensions(const unsigned char *data, size_t size, int &width, int &height);
+
+    // Decodes and downsamples so the result is at most maxWidth wide. Worker
+    // threads each handle a band of output rows; 0 means one per core.
+    static bool Decode(const unsigned char *data, size_t size, int maxWidth, HdrImage &image, unsigned int threadCount = 0);
+
+    static uint16_t FloatToHalf(float value);
+};
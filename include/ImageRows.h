@@ -0,0 +1,22 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+// Reverses the row order of a decoded image in place. stb_image's flip flag is global and
+// would race between decoding threads, so it stays off and every loader flips its own
+// result: textures are uploaded bottom row first, as GL expects.
+template <typename T>
+inline void FlipImageRows(T *pixels, int width, int height, int components)
+{
+    size_t rowLength = static_cast<size_t>(width) * components;
+    std::vector<T> row(rowLength);
+    for (int top = 0, bottom = height - 1; top < bottom; top++, bottom--)
+    {
+        T *upper = pixels + static_cast<size_t>(top) * rowLength;
+        T *lower = pixels + static_cast<size_t>(bottom) * rowLength;
+        std::memcpy(row.data(), upper, rowLength * sizeof(T));
+        std::memcpy(upper, lower, rowLength * sizeof(T));
+        std::memcpy(lower, row.data(), rowLength * sizeof(T));
+    }
+}
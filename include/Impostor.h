@@ -0,0 +1,57 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <functional>
+#include <vector>
+#include "ShaderProgram.h"
+
+class Model;
+
+// Billboard stand-in for a static model seen from afar. bake() renders the model from
+// Frames x Frames directions over the upper hemisphere (a hemi-octahedral grid) into a
+// colour atlas and a model-space normal atlas. Each instance is then one camera-facing
+// quad which blends the four baked views around its view direction and is lit from the
+// normal atlas, so a whole forest of one model costs a single instanced draw.
+class Impostor
+{
+public:
+    static const int Frames = 8;      // Views along each side of the atlas
+    static const int FrameSize = 128; // Pixels along each side of a view
+
+    Impostor() = default;
+    ~Impostor();
+    Impostor(const Impostor &) = delete;
+    Impostor &operator=(const Impostor &) = delete;
+
+    // GL thread, once the model and its textures are resident. color stands in for untextured
+    // meshes. False, logged, when the atlases or shaders could not be made; not retried.
+    bool bake(const Model &model, const glm::vec3 &color);
+    bool isBaked() const { return colorAtlas != 0; }
+    bool hasFailed() const { return failed; }
+
+    // This frame's instances, each the model's world transform (a rotation about Y and a
+    // uniform scale) and how far it has faded in, 0 to 1
+    void clearInstances() { instances.clear(); }
+    void addInstance(const glm::mat4 &modelMatrix, float fade);
+    size_t instanceCount() const { return instances.size() / 2; }
+
+    // Draws the instances at once, outside the RenderQueue; frameSetup sets the view, sun
+    // and environment uniforms as it does for the scene shaders
+    void draw(const std::function<void(ShaderProgram &program)> &frameSetup);
+
+private:
+    bool createBakeShader();
+    bool createDrawResources();
+
+    bool failed = false;
+    glm::vec3 localCenter = glm::vec3(0.0f); // Center of the baked bounding sphere, model space
+    float localRadius = 0.0f;
+    unsigned int colorAtlas = 0; // RGBA8: colour, alpha for coverage
+    unsigned int normalAtlas = 0;
+
+    ShaderProgram bakeShader;
+    ShaderProgram drawShader;
+    unsigned int quadVAO = 0;
+    unsigned int quadVBO = 0;
+    unsigned int instanceVBO = 0;
+    std::vector<glm::vec4> instances; // Per instance: world center and radius, then x axis xz, fade
+};
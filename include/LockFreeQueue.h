@@ -0,0 +1,104 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Bounded multi-producer multi-consumer queue (Vyukov's sequence-numbered ring).
+// push and pop never block and never allocate after construction; both return
+// false when the queue is full or empty. Capacity is rounded up to a power of two.
+template <typename T>
+class LockFreeQueue
+{
+public:
+    explicit LockFreeQueue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+        mask = size - 1;
+        cells = std::vector<Cell>(size);
+        for (size_t i = 0; i < size; i++)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        enqueuePos.store(0, std::memory_order_relaxed);
+        dequeuePos.store(0, std::memory_order_relaxed);
+    }
+
+    LockFreeQueue(const LockFreeQueue &) = delete;
+    LockFreeQueue &operator=(const LockFreeQueue &) = delete;
+
+    bool push(T value)
+    {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true)
+        {
+            cell = &cells[pos & mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0)
+            {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false; // Full
+            }
+            else
+            {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &value)
+    {
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true)
+        {
+            cell = &cells[pos & mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0)
+            {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false; // Empty
+            }
+            else
+            {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        value = std::move(cell->value);
+        cell->sequence.store(pos + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T value;
+
+        Cell() : sequence(0), value() {}
+        Cell(Cell &&other) noexcept : sequence(other.sequence.load(std::memory_order_relaxed)), value(std::move(other.value)) {}
+    };
+
+    // Producer and consumer cursors on separate cache lines
+    alignas(64) std::vector<Cell> cells;
+    size_t mask;
+    alignas(64) std::atomic<size_t> enqueuePos;
+    alignas(64) std::atomic<size_t> dequeuePos;
+};
@@ -6,10 +6,13 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 #include <GL/glew.h>
+#include "RenderQueue.h"
 
 struct Vertex
 {
@@ -18,6 +21,7 @@ struct Vertex
     glm::vec2 TexCoords;
     int BoneIDs[4] = {0, 0, 0, 0};
     float Weights[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    float Layer = 0.0f; // Texture array layer, used when the mesh's texture is an array
 };
 
 struct BoneInfo
@@ -31,44 +35,130 @@ struct Texture
     unsigned int id;
     std::string type;
     std::string path;
+    int layer = -1; // Layer of a GL_TEXTURE_2D_ARRAY (see TextureArrays), -1 for a 2D texture
+};
+
+// One Assimp import, shared by every Model that loads the same file with the same flags
+struct ImportedScene
+{
+    Assimp::Importer importer;
+    const aiScene *scene = nullptr;
+};
+
+// A run of up to Mesh::MeshletMaxTriangles neighbouring triangles with contiguous
+// indices, culled as a unit. There is no backface cone: face culling is never enabled,
+// so every mesh, foliage included, is drawn double-sided.
+struct Meshlet
+{
+    glm::vec3 center; // Bounding sphere, model space
+    float radius;
+    unsigned int firstIndex;
+    unsigned int indexCount;
 };
 
 class Mesh
 {
 public:
+    static const unsigned int MeshletMaxTriangles = 128;
+
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
     std::vector<Texture> textures;
+    std::vector<Meshlet> meshlets; // Empty for meshes too small to be worth splitting
     unsigned int VAO, VBO, EBO;
 
-    Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures);
-    void Draw(unsigned int shaderProgram);
-
-private:
+    // upload false defers the GL buffers to setupMesh(), for meshes that may still be merged
+    Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures, bool upload = true);
+    // Fills in the mesh's textures, features and geometry and submits object to the RenderQueue.
+    // A count already set in object limits the draw to that index range.
+    void Draw(DrawPacket object);
     void setupMesh();
+    // Reorders indices into meshlets; before setupMesh()
+    void buildMeshlets();
+};
+
+// Stand-in drawn while a streamed model's meshes are still loading, sized from its bounds
+enum class ProxyShape
+{
+    Box,
+    Capsule // Along the longest axis, for characters
 };
 
 class Model
 {
 public:
-    Model(const std::string &path);
+    // A streamed model imports on the asset streamer's workers and has no meshes until
+    // the GL step has run; it falls back to a synchronous load when the streamer is stopped
+    Model(const std::string &path, bool streamed = false);
     ~Model();
-    void Draw(unsigned int shaderProgram);
+    // Submits one packet per mesh to the RenderQueue. Above 0, impostorFade dithers that share
+    // of the pixels out, leaving them to an impostor fading in over the model.
+    void Draw(const glm::mat4 &modelMatrix, const glm::vec3 &color, unsigned int occlusionQuery = 0,
+              float impostorFade = 0.0f);
+    // GL thread. Uploads world transforms for DrawInstanced(), skipped when they match the
+    // last call's; meshes that arrive later pick them up
+    void setInstances(const std::vector<glm::mat4> &modelMatrices);
+    // One instanced packet per mesh covering every transform given to setInstances(). Unskinned.
+    void DrawInstanced(const glm::vec3 &color);
+    // As Draw(), leaving out meshlets outside the frustum; the survivors go out as index
+    // ranges of one packet per mesh. Unskinned.
+    void DrawMeshlets(const glm::mat4 &modelMatrix, const glm::vec3 &color);
     void UpdateAnimation(float deltaTime);
     void LoadAnimation(const std::string &animationPath);
     glm::vec3 getSize() const { return modelSize; }
     glm::vec3 getCenter() const { return modelCenter; }
+    bool isResident() const { return resident; }
+    // Empty until resident
+    const std::vector<Mesh> &getMeshes() const { return meshes; }
+    // Bounds arrive before the meshes for streamed models; until then size and center are placeholders
+    bool hasBounds() const { return boundsKnown; }
+    void setProxyShape(ProxyShape shape) { proxyShape = shape; }
+    // Reports this instance's on-screen size to TextureResidency for each of its textures
+    void noteTextureUsage(const glm::mat4 &modelMatrix) const;
+
+    struct MeshletStats
+    {
+        unsigned long tested = 0;
+        unsigned long frustumCulled = 0;
+        unsigned long trianglesCulled = 0;
+    };
+    // Meshlet culling of the frame so far, across every model
+    static MeshletStats &FrameMeshletStats();
+    // Totals of the previous frame; EndFrame() moves the running counts there
+    static const MeshletStats &LastFrameMeshletStats();
+    static void EndFrame();
+
+    // Assimp post-processing used for meshes and for animation clips
+    static const unsigned int ModelImportFlags;
+    static const unsigned int AnimationImportFlags;
+
+    // Thread-safe and memoised: concurrent callers for the same file wait for a single import
+    static std::shared_ptr<const ImportedScene> ImportScene(const std::string &path, unsigned int flags);
+    // Never blocks: the cached import, or nullptr while it is missing or still running
+    static std::shared_ptr<const ImportedScene> FindScene(const std::string &path, unsigned int flags);
+    // Imports an animation file on the streamer's workers so a later LoadAnimation does not stall
+    static void PrefetchAnimation(const std::string &animationPath);
 
 private:
     std::vector<Mesh> meshes;
     std::string directory;
     static std::vector<Texture> textures_loaded; // Shared across all models
+    static std::mutex texturesMutex;             // Guards textures_loaded
     glm::vec3 modelSize;
     glm::vec3 modelCenter;
+    bool resident;
+    bool boundsKnown;
+    ProxyShape proxyShape;
+    std::unique_ptr<Mesh> proxy;
+    std::shared_ptr<Model *> streamHandle; // Cleared on destruction so a late streaming result is dropped
+    std::string pendingAnimation;          // Clip a streamed model switches to once its import lands
+    unsigned int instanceVBO;              // mat4 per instance, attributes 6-9 of every mesh VAO
+    int instanceCount;
+    int instanceCapacity;                  // Instances instanceVBO has room for
+    std::vector<glm::mat4> instanceMatrices; // Last upload, to skip repeats
 
     // Animation data
-    const aiScene *scene;
-    Assimp::Importer *importer;
+    std::shared_ptr<const ImportedScene> modelScene;
     std::map<std::string, unsigned int> boneMapping;
     std::vector<BoneInfo> boneInfo;
     unsigned int numBones;
@@ -76,11 +166,12 @@ private:
 
     // Current animation
     const aiScene *animationScene;
-    Assimp::Importer *animationImporter;
+    std::shared_ptr<const ImportedScene> animationAsset;
     float animationTime;
     bool hasAnimation;
 
     void loadModel(const std::string &path);
+    void finishLoad(const std::shared_ptr<const ImportedScene> &imported, const std::string &path);
     void processNode(aiNode *node, const aiScene *scene);
     Mesh processMesh(aiMesh *mesh, const aiScene *scene);
     void loadBones(const aiMesh *mesh, std::vector<unsigned int> &boneIDs, std::vector<float> &boneWeights);
@@ -95,8 +186,12 @@ private:
     aiQuaternion calcInterpolatedRotation(float animationTime, const aiNodeAnim *nodeAnim);
     aiVector3D calcInterpolatedScaling(float animationTime, const aiNodeAnim *nodeAnim);
     std::vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, std::string typeName);
-    unsigned int TextureFromFile(const char *path, const std::string &directory);
+    // Sets *layer when the image was baked into a texture array and the array is returned
+    unsigned int TextureFromFile(const char *path, const std::string &directory, int *layer = nullptr);
     void calculateBounds(const aiScene *scene);
+    void buildProxy();
+    void attachInstances(Mesh &mesh) const;
+    void batchTextureArrayMeshes();
 };
 
 #endif
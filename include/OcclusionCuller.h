@@ -0,0 +1,99 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+#include "ShaderProgram.h"
+
+// Occlusion culling with hardware queries, for objects that pass the frustum test.
+// After the frame's opaque draws, each requested object's world box is drawn into the
+// depth buffer with colour and depth writes off, inside a GL_SAMPLES_PASSED query.
+// The results are collected at the start of a later frame without waiting: an object
+// whose box showed no samples is skipped, and one whose query has not finished yet is
+// drawn under glBeginConditionalRender, so the GPU drops it if the answer arrives in
+// time and the CPU never stalls on a result. On with SIMPLECATAPULT_OCCLUSION=gpu (or 1).
+class OcclusionCuller
+{
+public:
+    struct Stats
+    {
+        unsigned long tested = 0;       // Box proxies drawn into a query
+        unsigned long skipped = 0;      // Instances not drawn, hidden in their last result
+        unsigned long conditional = 0;  // Objects drawn under conditional rendering
+        unsigned long pixelsShaded = 0; // Samples the scene draws passed, from the newest finished frame
+    };
+
+    static OcclusionCuller &Get();
+
+    void setEnabled(bool enabled) { this->enabled = enabled; }
+    bool isEnabled() const { return enabled; }
+
+    // GL thread, before the frame's requests. Collects finished results and forgets
+    // objects that were not requested in the previous frame.
+    void beginFrame(const glm::vec3 &viewPos);
+    // For an object inside the frustum, keyed by anything stable while it lives. False
+    // when its last result found it hidden; it is then left out, and instances is added
+    // to the skipped count. Otherwise it is drawn, under conditional rendering with
+    // conditionalQuery when that is not 0. Its box is tested again this frame either way.
+    bool request(const void *key, const glm::vec3 &min, const glm::vec3 &max, unsigned int &conditionalQuery,
+                 unsigned long instances = 1);
+    // Drops key's entry, for an object about to be destroyed, so a new one allocated at the
+    // same address does not inherit its result or its query
+    void forget(const void *key);
+
+    // Bracket the scene draws to count the samples they shade
+    void beginScene();
+    void endScene();
+    // After the opaque draws: one query per object requested this frame, unless its last is still running
+    void issueQueries(const glm::mat4 &viewProjection);
+
+    // GL thread, while the context is alive
+    void shutdown();
+
+    // Counts of the frame so far
+    static Stats &FrameStats();
+    // Totals of the previous frame; EndFrame() moves the running counts there
+    static const Stats &LastFrameStats();
+    static void EndFrame();
+
+private:
+    OcclusionCuller() = default;
+
+    struct Entry
+    {
+        unsigned int query = 0;
+        glm::vec3 min = glm::vec3(0.0f);
+        glm::vec3 max = glm::vec3(0.0f);
+        unsigned long lastFrame = 0;
+        bool pending = false;  // Query issued, result not read back yet
+        bool occluded = false; // Last result read back
+        bool testThisFrame = false;
+    };
+
+    // Scene sample queries in flight, read back oldest first
+    static const int SceneQueries = 4;
+
+    unsigned int allocateQuery();
+    bool createProxy();
+
+    bool enabled = false;
+    unsigned long frame = 0;
+    glm::vec3 viewPos = glm::vec3(0.0f);
+    std::unordered_map<const void *, Entry> entries;
+    std::vector<unsigned int> freeQueries;
+
+    unsigned int sceneQueries[SceneQueries] = {};
+    unsigned long sceneFrames[SceneQueries] = {}; // Frame a query in flight measured; 0 when idle
+    int sceneNext = 0;
+    unsigned long lastPixelsShaded = 0;
+    unsigned long lastPixelsFrame = 0; // Frame lastPixelsShaded was measured in
+
+    ShaderProgram proxyShader;
+    int viewProjectionSlot = -1;
+    int boxMinSlot = -1;
+    int boxMaxSlot = -1;
+    unsigned int proxyVAO = 0;
+    unsigned int proxyVBO = 0;
+    unsigned int proxyEBO = 0;
+    bool proxyFailed = false;
+};
@@ -1,27 +1,14 @@
 // PathUtils.h
 #pragma once
 #include <string>
-#include <fstream>
+#include "VirtualFileSystem.h"
 
 inline std::string FindImagePath(const std::string& relativePath)
 {
     // relativePath example: "Terrain/Tree/Tree1.obj" or "Skybox/my.hdr"
 
-    const std::string candidates[] = {
-        "../images/"  + relativePath,
-        "../../images/" + relativePath,
-        "images/"     + relativePath
-    };
-
-    for (const auto& path : candidates)
-    {
-        std::ifstream file(path);
-        if (file.good())
-        {
-            return path;
-        }
-    }
-
-    // Not found → return the most common one so Assimp still shows normal error
-    return "../images/" + relativePath;
+    // The virtual filesystem resolved the asset root once and memoises lookups,
+    // so this never touches the disk. Missing files still get a path back so
+    // loaders report a normal error.
+    return VirtualFileSystem::Get().resolve("images/" + relativePath);
 }
\ No newline at end of file
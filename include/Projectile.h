@@ -2,6 +2,7 @@
 #include <glm/glm.hpp>
 #include <GL/glew.h>
 #include <vector>
+#include "FrustumCuller.h"
 
 class Projectile
 {
@@ -35,6 +36,8 @@ public:
     };
     std::vector<Fragment> fragments; // Shatter fragments
     bool hasShattered;               // Whether shatter effect has been created
+    CullBounds fragmentBounds;       // Rebuilt each frame the fragments are drawn
+    std::vector<uint8_t> fragmentVisible;
 
     // Damage system
     float baseDamage;            // Base damage of projectile
@@ -46,7 +49,7 @@ public:
 
     void launch(glm::vec3 initialVelocity);
     void update(float deltaTime, class Terrain *terrain);
-    void draw(unsigned int shaderProgram);
+    void draw();
 
     // Damage calculation based on distance from impact
     float calculateDamage(float distanceFromImpact) const;
@@ -72,5 +75,5 @@ private:
     void initMesh();
     void startImpactAnimation(glm::vec3 hitPosition);
     void updateFragments(float deltaTime);
-    void drawFragments(unsigned int shaderProgram);
+    void drawFragments();
 };
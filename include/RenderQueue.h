@@ -0,0 +1,92 @@
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class RenderPass : unsigned int
+{
+    Opaque = 0,      // Sorted by state, front to back within equal state
+    Transparent = 1, // Drawn after every opaque packet, back to front, with alpha blending
+};
+
+// Everything one draw call needs, so the queue can issue it in any order
+struct DrawPacket
+{
+    RenderPass pass = RenderPass::Opaque;
+    unsigned int features = 0;     // ShaderPermutations key
+    unsigned int texture = 0;      // GL_TEXTURE_2D on unit 0; 0 leaves the unit alone
+    unsigned int arrayTexture = 0; // GL_TEXTURE_2D_ARRAY on TextureArrays::TextureUnit
+    unsigned int vertexArray = 0;
+    bool indexed = false; // glDrawElements with GL_UNSIGNED_INT indices, else glDrawArrays
+    int first = 0;        // First vertex, or first index when indexed
+    int count = 0;
+    int instances = 1;    // Drawn for SHADER_INSTANCED, whose transforms come from the VAO rather than model
+    glm::mat4 model = glm::mat4(1.0f);
+    glm::vec3 color = glm::vec3(1.0f);
+    float impostorFade = 0.0f; // SHADER_DITHER_FADE: share of the pixels left to an impostor fading in
+    int bonesOffset = -1; // Into the queue's bone storage, from addBones()
+    int bonesCount = 0;
+    unsigned int occlusionQuery = 0; // Drawn under conditional rendering on this query when not 0
+    // Index ranges from addRanges(), drawn by one glMultiDrawElements in place of first; count
+    // is then their total. Indexed, non-instanced packets only.
+    int rangesOffset = -1;
+    int rangesCount = 0;
+};
+
+// Collects the frame's draw packets from every subsystem and issues them in one pass.
+// Each packet gets a 64-bit key: pass in the top bits, then program, texture and VAO,
+// then view depth, so sorting the keys groups draws that share state and orders equal
+// state front to back. Transparent packets put depth ahead of state, reversed, so they
+// blend back to front. Packets are submitted in code order and only drawn by flush().
+class RenderQueue
+{
+public:
+    struct Stats
+    {
+        unsigned long packets = 0;
+        unsigned long unsortedChanges = 0; // Program, texture and VAO switches in submission order
+        unsigned long sortedChanges = 0;   // The same after sorting
+        unsigned long triangles = 0;       // Across every instance
+    };
+
+    static RenderQueue &Get();
+
+    // Starts the frame's queue; depth is measured along viewDir and scaled by farPlane
+    void begin(const glm::vec3 &viewPos, const glm::vec3 &viewDir, float farPlane);
+    // Copies bone matrices into storage that lives until flush(); returns the offset for a packet
+    int addBones(const glm::mat4 *bones, size_t count);
+    // Copies index ranges (first index, index count) for one packet, until flush(); returns the offset
+    int addRanges(const unsigned int *firstIndices, const int *counts, size_t count);
+    void submit(const DrawPacket &packet);
+    // Sorts and draws everything submitted since begin(), then empties the queue
+    void flush();
+
+    const glm::vec3 &getViewPos() const { return viewPos; }
+
+    // Counts of the last flush()
+    static const Stats &LastFrameStats();
+
+private:
+    RenderQueue() = default;
+
+    struct SortEntry
+    {
+        uint64_t key;
+        unsigned int index;
+    };
+
+    uint64_t makeKey(const DrawPacket &packet) const;
+    unsigned long countChanges(const std::vector<SortEntry> &order) const;
+    void execute(const DrawPacket &packet, const DrawPacket *previous);
+
+    glm::vec3 viewPos = glm::vec3(0.0f);
+    glm::vec3 viewDir = glm::vec3(0.0f, 0.0f, -1.0f);
+    float farPlane = 100.0f;
+    std::vector<DrawPacket> packets;
+    std::vector<SortEntry> order;
+    std::vector<glm::mat4> bones;
+    std::vector<GLsizei> rangeCounts;
+    std::vector<const void *> rangeOffsets; // Byte offsets into the element buffer
+};
@@ -0,0 +1,64 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Builds GLSL programs and caches the linked binaries under cache/shaders, keyed
+// by a hash of the sources and the driver (vendor, renderer, version). A cached
+// binary skips compile and link entirely; one the driver rejects is deleted and
+// the program is compiled from source instead. With KHR_parallel_shader_compile
+// the driver compiles in the background between begin() and finish().
+// Compile and link errors are logged with the program's name.
+class ShaderManager
+{
+public:
+    using Handle = int;
+
+    static ShaderManager &Get();
+
+    // GL thread, once the context is current. SIMPLECATAPULT_SHADER_CACHE=0 disables the disk cache.
+    void init();
+
+    // Starts building a program and returns at once
+    Handle begin(const std::string &name, const std::string &vertexSource, const std::string &fragmentSource);
+    Handle beginFromFiles(const std::string &vertexPath, const std::string &fragmentPath);
+    // True when finish() would not block
+    bool isReady(Handle handle) const;
+    // Waits if needed; the linked program, or 0 after logging why it failed
+    unsigned int finish(Handle handle);
+
+    unsigned int createProgram(const std::string &name, const std::string &vertexSource, const std::string &fragmentSource)
+    {
+        return finish(begin(name, vertexSource, fragmentSource));
+    }
+    unsigned int createProgramFromFiles(const std::string &vertexPath, const std::string &fragmentPath)
+    {
+        return finish(beginFromFiles(vertexPath, fragmentPath));
+    }
+
+private:
+    ShaderManager();
+
+    struct Pending
+    {
+        std::string name;
+        uint64_t sourceHash = 0;
+        unsigned int program = 0;
+        unsigned int vertexShader = 0;
+        unsigned int fragmentShader = 0;
+        bool fromCache = false;
+        bool finished = false;
+        std::chrono::steady_clock::time_point startTime;
+    };
+
+    std::string binaryPath(const Pending &pending) const;
+    bool loadBinary(Pending &pending);
+    void saveBinary(const Pending &pending);
+
+    std::vector<Pending> pending;
+    bool initialized;
+    bool binariesSupported;
+    bool parallelCompile;
+    uint64_t driverHash;
+};
@@ -0,0 +1,96 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include "ShaderManager.h"
+#include "ShaderProgram.h"
+
+// Feature bits of a permutation key; each one is a #define in the compiled source
+enum ShaderFeature : unsigned int
+{
+    SHADER_SKINNED = 1u << 0,       // Bone matrices blended per vertex
+    SHADER_TEXTURED = 1u << 1,      // Diffuse colour from texture_diffuse1
+    SHADER_TEXTURE_ARRAY = 1u << 2, // Diffuse colour from texture_array at the vertex's layer; implies TEXTURED
+    SHADER_INSTANCED = 1u << 3,     // Model matrix per instance from attributes 6-9 instead of the uniform
+    SHADER_DITHER_FADE = 1u << 4,   // Dithered out by impostorFade, the complement of an impostor fading in
+};
+
+// Compiles one vertex/fragment source pair into specialised programs, one per feature
+// key, so static geometry never runs the skinning path and untextured draws never
+// sample. Per-object values (model and normal matrix, colour, bones) are held here
+// and pushed to a variant only when it is bound with stale copies, which lets a
+// draw switch variants without its caller knowing which one is in use.
+class ShaderPermutations
+{
+public:
+    static ShaderPermutations &Get();
+
+    // GL thread. Reads the sources; nothing is compiled yet.
+    void load(const std::string &vertexPath, const std::string &fragmentPath);
+    // Starts building the given keys at once, so a parallel compiler can work on all of them
+    void prepare(const std::vector<unsigned int> &keys);
+    // Collects everything prepare() started; variants not prepared are built on first use
+    void finishPending();
+
+    // Called on each variant the first time it is bound in a frame, to set view,
+    // lighting and other values shared by every draw
+    void beginFrame(std::function<void(ShaderProgram &program)> frameSetup);
+
+    // Binds the variant for key and brings its per-object uniforms up to date; null when it failed to build
+    ShaderProgram *use(unsigned int key);
+
+    // Per-object values. The bound variant gets them immediately, the others when used.
+    void setModel(const glm::mat4 &model);
+    void setColor(const glm::vec3 &color);
+    void setImpostorFade(float fade);
+    void setBones(const glm::mat4 *bones, size_t count);
+
+    void shutdown();
+
+private:
+    ShaderPermutations();
+
+    struct Variant
+    {
+        ShaderProgram program;
+        ShaderManager::Handle pendingBuild = -1;
+        int modelSlot = -1;
+        int normalMatrixSlot = -1;
+        int colorSlot = -1;
+        int impostorFadeSlot = -1;
+        int bonesSlot = -1;
+        unsigned long modelVersion = 0;
+        unsigned long colorVersion = 0;
+        unsigned long impostorFadeVersion = 0;
+        unsigned long bonesVersion = 0;
+        unsigned long frame = 0;
+    };
+
+    std::string withDefines(const std::string &source, unsigned int key) const;
+    void start(unsigned int key, Variant &variant);
+    void finish(Variant &variant);
+    void uploadModel(Variant &variant);
+    void uploadColor(Variant &variant);
+    void uploadImpostorFade(Variant &variant);
+    void uploadBones(Variant &variant);
+
+    std::string vertexSource;
+    std::string fragmentSource;
+    std::string name;
+    std::map<unsigned int, Variant> variants;
+    Variant *active;
+    std::function<void(ShaderProgram &)> frameSetup;
+    unsigned long frame;
+
+    glm::mat4 model;
+    glm::mat3 normalMatrix;
+    glm::vec3 color;
+    float impostorFade;
+    std::vector<glm::mat4> bones;
+    unsigned long modelVersion;
+    unsigned long colorVersion;
+    unsigned long impostorFadeVersion;
+    unsigned long bonesVersion;
+};
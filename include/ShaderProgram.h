@@ -0,0 +1,68 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A linked GL program's active uniforms, reflected once into a slot table with a
+// shadow copy of every value. Setters take a slot (resolve names once, at setup)
+// or a name for cold paths; either way no string reaches the driver, and a value
+// equal to the one the program already holds is not sent again. The program has
+// to be bound when a setter runs, as with glUniform*. The program object itself
+// stays owned by whoever created it.
+class ShaderProgram
+{
+public:
+    struct Stats
+    {
+        unsigned long issued = 0;
+        unsigned long skipped = 0;
+    };
+
+    ShaderProgram() = default;
+    explicit ShaderProgram(unsigned int program) { attach(program); }
+
+    // Reflects program's active uniforms, forgetting any previous program; 0 detaches
+    void attach(unsigned int program);
+    unsigned int id() const { return program; }
+
+    // Slot of an active uniform, arrays by their bare name; -1 when the linker removed it
+    int slot(const std::string &name) const;
+
+    void set(int slot, int value);
+    void set(int slot, float value);
+    void set(int slot, const glm::vec3 &value);
+    void set(int slot, const glm::mat3 &value);
+    void set(int slot, const glm::mat4 &value);
+    void set(int slot, const glm::vec3 *values, int count);
+    void set(int slot, const glm::mat4 *values, int count);
+
+    template <typename T>
+    void set(const std::string &name, const T &value) { set(slot(name), value); }
+    template <typename T>
+    void set(const std::string &name, const T *values, int count) { set(slot(name), values, count); }
+
+    // Uniform updates of the frame so far, across every program
+    static Stats &FrameStats();
+    // Totals of the previous frame; EndFrame() moves the running counts there
+    static const Stats &LastFrameStats();
+    static void EndFrame();
+
+private:
+    struct Uniform
+    {
+        int location;
+        size_t offset;     // Into shadow
+        size_t bytes;      // Whole array for array uniforms
+        size_t knownBytes; // Leading bytes of shadow known to match the program
+    };
+
+    // True, after updating the shadow, when data differs from what the program holds
+    bool changed(int slot, const void *data, size_t bytes);
+
+    unsigned int program = 0;
+    std::vector<Uniform> uniforms;
+    std::unordered_map<std::string, int> slots;
+    std::vector<unsigned char> shadow;
+};
@@ -2,30 +2,62 @@
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <memory>
 #include <string>
+#include "AssetPack.h"
+#include "HdrDecoder.h"
+#include "EnvironmentLighting.h"
+#include "ShaderProgram.h"
 
 class Skybox
 {
 public:
+    // Loads and creates everything on the calling thread
     Skybox(const std::string &hdrPath);
+    // Two-phase construction for the startup graph: load() makes no GL calls and may
+    // run on a worker; createResources() must then run on the GL thread
+    Skybox();
     ~Skybox();
 
+    void load(const std::string &hdrPath);
+    void createResources();
+
+    // Until createResources() has run this draws a flat horizon-to-zenith gradient instead
     void Draw(const glm::mat4 &view, const glm::mat4 &projection, float deltaTime = 0.0f);
     void Update(float deltaTime);
 
+    // Sky lighting precomputed from the cubemap, plus the world -> cubemap rotation to sample it with
+    const EnvironmentLighting &getEnvironment() const { return environment; }
+    glm::mat3 getEnvironmentRotation() const;
+    bool isReady() const { return skyboxShader.id() != 0 && cubemapTexture != 0; }
+
 private:
     unsigned int cubemapTexture;
+    int cubemapSize; // Edge length of the top mip
     unsigned int skyboxVAO, skyboxVBO;
-    unsigned int shaderProgram;
+    ShaderProgram skyboxShader;
+    ShaderProgram gradientShader; // Placeholder sky, created on first use
+
+    void drawGradient(const glm::mat4 &view, const glm::mat4 &projection);
 
     void loadHDRTexture(const std::string &path);
     void setupSkyboxCube();
     unsigned int compileSkyboxShader();
     void convertEquirectangularToCubemap();
 
-    // HDR data
-    float *hdrData;
-    int hdrWidth, hdrHeight, hdrChannels;
+    // Disk cache of the converted cubemap (R11F_G11F_B10F with mips)
+    std::string getCachePath(const std::string &hdrPath);
+    bool mapCachedCubemap(const std::string &cachePath);
+    void uploadCachedCubemap();
+    void saveCachedCubemap(const std::string &cachePath);
+
+    std::string cubemapCachePath;
+    std::unique_ptr<MappedFile> cachedCubemap; // Validated and paged in by load(), released after upload
+
+    // HDR data, already filtered down to the equirect resolution the conversion needs
+    HdrImage hdrImage;
+
+    EnvironmentLighting environment;
 
     // Rotation for animated skybox
     float rotationAngle;
@@ -0,0 +1,88 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "FrustumCuller.h"
+
+// Occlusion culling on the CPU, for machines where GPU queries cost about as much as
+// the draws they would save. Each frame the occluder boxes (the rock walls, shrunk so
+// they stay inside the rock) are rasterized into a small depth buffer, split into
+// horizontal bands that run on worker threads, four pixels at a time with SSE where
+// available. Each band then keeps the farthest depth of every 8x8 tile. An occludee's
+// box is hidden when its nearest point is behind the tile maximum of every tile it
+// covers, or failing that, behind every depth sample under it.
+class SoftwareOcclusion
+{
+public:
+    struct Stats
+    {
+        unsigned long tested = 0; // Occludees on screen and clear of the near plane
+        unsigned long rejected = 0;
+        unsigned long occluderTriangles = 0; // After near plane clipping
+        float rasterMs = 0.0f;               // Clearing, rasterizing and tile reduction, all bands
+        float testMs = 0.0f;                 // Of test(); single isVisible() calls are not timed
+    };
+
+    static const int Width = 256;
+    static const int Height = 128;
+    static const int TileSize = 8;
+
+    static SoftwareOcclusion &Get();
+
+    // threadCount 0 uses up to three workers; the calling thread always renders one band too
+    void start(unsigned int threadCount = 0);
+    void shutdown();
+    bool isRunning() const { return running; }
+
+    // Occluders live until cleared; each is a local box placed by model, as TransformBox()
+    void clearOccluders();
+    void addOccluder(const glm::mat4 &model, const glm::vec3 &localCenter, const glm::vec3 &localSize);
+
+    // Rasterizes the occluders for this view; returns once every band is done
+    void render(const glm::mat4 &viewProjection);
+    // False only when the box is certainly hidden; always true while not running
+    bool isVisible(const glm::vec3 &min, const glm::vec3 &max);
+    // Clears visible[i] for entries of bounds that are hidden; entries already 0 are not tested
+    void test(const CullBounds &bounds, std::vector<uint8_t> &visible);
+
+    // Counts of the frame so far
+    static Stats &FrameStats();
+    // Totals of the previous frame; EndFrame() moves the running counts there
+    static const Stats &LastFrameStats();
+    static void EndFrame();
+
+private:
+    SoftwareOcclusion() = default;
+    ~SoftwareOcclusion();
+
+    // Screen-space triangle: pixels in x and y, NDC depth in z
+    struct Triangle
+    {
+        glm::vec3 v[3];
+    };
+
+    void setupTriangles();
+    void renderBand(int band);
+    void workerLoop(int band);
+
+    bool running = false;
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    std::vector<glm::vec3> occluderCorners; // Eight world corners per occluder
+    std::vector<Triangle> triangles;
+    std::vector<float> depth;   // Width * Height, nearest occluder, 1 where none
+    std::vector<float> tileMax; // Farthest depth per tile
+    bool rendered = false;      // Buffers hold the current view
+
+    int bandCount = 1;
+    std::vector<std::thread> workers; // Worker i renders band i + 1
+    std::mutex mutex;
+    std::condition_variable workReady;
+    std::condition_variable workDone;
+    unsigned long generation = 0; // Guarded by mutex, with the two below
+    int bandsRemaining = 0;
+    bool stopping = false;
+};
@@ -0,0 +1,105 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "FrustumCuller.h"
+
+// Bounding volume hierarchy over boxes that never move, built once with binned SAH
+// splits. Nodes are stored depth first in one array, 32 bytes each: a node's left
+// child is the next node and only the right child's index is kept, so traversal walks
+// mostly forward through memory. Items are referred to by their index in the boxes
+// given to build(); every query costs O(log n) node visits for a small result.
+class StaticBVH
+{
+public:
+    struct Box
+    {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+
+    // Replaces the hierarchy; an empty list leaves it empty
+    void build(const std::vector<Box> &boxes);
+    void clear();
+    bool empty() const { return nodes.empty(); }
+    size_t itemCount() const { return itemBoxes.size(); }
+
+    // visible[i] is 1 when item i's box is at least partly inside the frustum. Subtrees
+    // wholly inside are accepted without testing their items.
+    void queryFrustum(const FrustumCuller &frustum, std::vector<uint8_t> &visible) const;
+    // Nearest item whose box the ray enters within maxDistance; direction need not be unit length
+    bool raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, uint32_t &item,
+                 float &distance) const;
+
+    // Calls visit(item) for every item whose box overlaps the query; visit returns false to stop
+    template <typename Visit>
+    void queryBox(const glm::vec3 &min, const glm::vec3 &max, Visit &&visit) const
+    {
+        traverse([&](const glm::vec3 &boxMin, const glm::vec3 &boxMax)
+                 {
+                     return boxMin.x <= max.x && boxMin.y <= max.y && boxMin.z <= max.z && boxMax.x >= min.x &&
+                            boxMax.y >= min.y && boxMax.z >= min.z;
+                 },
+                 visit);
+    }
+
+    template <typename Visit>
+    void querySphere(const glm::vec3 &center, float radius, Visit &&visit) const
+    {
+        traverse([&](const glm::vec3 &boxMin, const glm::vec3 &boxMax)
+                 {
+                     glm::vec3 offset = center - glm::clamp(center, boxMin, boxMax);
+                     return glm::dot(offset, offset) <= radius * radius;
+                 },
+                 visit);
+    }
+
+private:
+    struct Node
+    {
+        glm::vec3 min;
+        uint32_t rightOrFirst; // Interior: index of the right child. Leaf: first slot in items.
+        glm::vec3 max;
+        uint32_t count; // Items in a leaf; 0 marks an interior node
+    };
+
+    // Deep enough for any tree this builds: leaves split until SAH stops paying off,
+    // and an unbalanced split still removes at least one item per level
+    static const int MaxDepth = 64;
+
+    uint32_t buildNode(uint32_t begin, uint32_t end, const std::vector<glm::vec3> &centroids, int depth);
+
+    template <typename Overlaps, typename Visit>
+    void traverse(Overlaps &&overlaps, Visit &&visit) const
+    {
+        if (nodes.empty())
+            return;
+        uint32_t stack[MaxDepth];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0)
+        {
+            const Node &node = nodes[stack[--top]];
+            if (!overlaps(node.min, node.max))
+                continue;
+            if (node.count == 0)
+            {
+                uint32_t left = static_cast<uint32_t>(&node - nodes.data()) + 1;
+                stack[top++] = node.rightOrFirst;
+                stack[top++] = left;
+                continue;
+            }
+            for (uint32_t i = node.rightOrFirst; i < node.rightOrFirst + node.count; i++)
+            {
+                const Box &box = itemBoxes[items[i]];
+                if (overlaps(box.min, box.max) && !visit(items[i]))
+                    return;
+            }
+        }
+    }
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> items; // Item indices in leaf order
+    std::vector<Box> itemBoxes;  // By item index
+};
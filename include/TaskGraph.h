@@ -0,0 +1,86 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Where a task may run. GL calls are only legal on the thread that owns the
+// context, so anything that creates GL objects must be MainThread.
+enum class TaskAffinity
+{
+    Worker,
+    MainThread
+};
+
+// One-shot dependency graph used for startup. Worker tasks run on a pool that
+// lives until every task has run; MainThread tasks run on the thread that calls
+// run() or poll(), in the order they become ready. Every task is timed so the
+// report can show the timeline and the critical path that bounded the total.
+// Destroying a graph that has not finished cancels it: no task runs from the destructor.
+class TaskGraph
+{
+public:
+    using TaskId = int;
+
+    TaskGraph();
+    ~TaskGraph();
+
+    TaskId add(const std::string &name, TaskAffinity affinity, std::function<void()> work,
+               const std::vector<TaskId> &dependencies = {});
+
+    // Blocks until every task has run. workerCount 0 uses all cores but the calling one.
+    void run(unsigned int workerCount = 0);
+
+    // Non-blocking alternative to run(): start() launches the workers, then poll() is
+    // called once per frame and runs ready MainThread tasks until budgetMs is spent
+    void start(unsigned int workerCount = 0);
+    void poll(float budgetMs);
+    bool isFinished() const;
+    // Drops every task not yet begun and waits for the workers' running ones. MainThread
+    // tasks never run afterwards, so call it while whatever they touch is still alive.
+    void cancel();
+
+    // Per-task timeline, busy time per thread and the critical path, on std::cout
+    void printReport() const;
+
+    float getTotalMs() const { return totalMs; }
+
+private:
+    struct Task
+    {
+        std::string name;
+        TaskAffinity affinity;
+        std::function<void()> work;
+        std::vector<TaskId> dependencies;
+        std::vector<TaskId> dependents;
+        int unmetDependencies = 0;
+        int lane = -1; // 0 is the main thread, workers are 1..n
+        float startMs = 0.0f;
+        float endMs = 0.0f;
+    };
+
+    float elapsedMs() const;
+    void enqueue(TaskId id); // Caller holds mutex
+    void execute(TaskId id, int lane);
+    void workerLoop(int lane);
+    void joinWorkers();
+
+    std::vector<Task> tasks;
+    std::vector<std::thread> workers;
+    std::deque<TaskId> workerQueue; // Both queues guarded by mutex
+    std::deque<TaskId> mainQueue;
+    mutable std::mutex mutex;
+    std::condition_variable workerReady;
+    std::condition_variable mainReady;
+    size_t remaining;
+    bool started;
+    bool cancelled;
+
+    std::chrono::steady_clock::time_point startTime;
+    unsigned int laneCount;
+    float totalMs;
+};
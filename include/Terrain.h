@@ -1,32 +1,61 @@
 #pragma once
 #include <GL/glew.h>
 #include <glm/glm.hpp>
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
+#include "GrassField.h"
+#include "Impostor.h"
 #include "Model.h"
+#include "StaticBVH.h"
 
 struct TreeInstance
 {
     Model *model;
     glm::vec3 position;
-    float rotation; // Rotation around Y axis
-    float scale;    // Scale factor for variation
+    float rotation;         // Rotation around Y axis
+    float scale;            // Scale factor for variation
+    glm::mat4 modelMatrix;  // World transform, computed once at placement
 };
 
 struct RockWallInstance
 {
     Model *model;
     glm::vec3 position;
-    float rotation; // Rotation around Y axis
-    float scale;    // Scale factor for variation
+    float rotation;         // Rotation around Y axis
+    float scale;            // Scale factor for variation
+    glm::mat4 modelMatrix;  // World transform, computed once at placement
+};
+
+// Ground kept free of trees: within radius of the segment a to b (a == b for a spot)
+struct TreeClearing
+{
+    glm::vec2 a; // xz
+    glm::vec2 b;
+    float radius;
 };
 
 class Terrain
 {
 public:
-    Terrain(float size = 10.0f, int divisions = 20, glm::vec3 offset = glm::vec3(0.0f));
+    // A streamed terrain returns without waiting for its tree and wall models: they draw as
+    // proxies until resident, and the walls are placed once their model's bounds are known
+    Terrain(float size = 10.0f, int divisions = 20, glm::vec3 offset = glm::vec3(0.0f), bool streamed = false);
     ~Terrain();
-    void draw(unsigned int shaderProgram);
+
+    // Models the constructor loads, so startup can import them ahead of time on other threads
+    static std::vector<std::string> GetModelPaths();
+    void draw();
+    // Gameplay ground, such as spawn points and patrol paths, that the scatter must leave
+    // open. Trees already scattered are scattered again around it.
+    void setTreeClearings(const std::vector<TreeClearing> &clearings);
+    // Distant trees gathered by draw(), as billboards; after the scene draws. Bakes each tree
+    // model's impostor first, once the model and every streamed texture are resident.
+    void drawImpostors(const std::function<void(ShaderProgram &program)> &frameSetup);
+    size_t getImpostorCount() const;
+    // Grass over the whole terrain, after the scene draws; time drives the wind
+    void drawGrass(const std::function<void(ShaderProgram &program)> &frameSetup, float time);
     float getHeight(float x, float z) const;                                                         // Get terrain height at position (x, z)
     glm::vec3 getNormal(float x, float z) const;                                                     // Get terrain normal at position (x, z) for slope calculation
     bool checkTreeCollision(float x, float z, float radius = 0.5f) const;                            // Check if position collides with any tree
@@ -43,14 +72,54 @@ private:
     // Trees
     std::vector<TreeInstance> trees;
     std::vector<Model *> treeModels; // Store models for cleanup
+    std::vector<std::unique_ptr<Impostor>> treeImpostors; // One per tree model
+    std::vector<TreeClearing> treeClearings;
+    std::unique_ptr<GrassField> grass;
 
     // Rock Walls
     std::vector<RockWallInstance> rockWalls;
     std::vector<Model *> rockWallModels; // Store models for cleanup
 
+    // Trees, then rock walls, as items of one hierarchy for culling and collision queries
+    StaticBVH staticScene;
+    bool staticBoundsKnown;             // False while a streamed model lacks bounds; rebuilt until then
+    std::vector<uint8_t> staticVisible; // This frame's frustum and occlusion result per item
+
+    // Trees of one scatter chunk, contiguous in trees and all of one model. A chunk is
+    // frustum culled, occlusion tested and batched as a unit before its trees are looked at.
+    struct TreeChunk
+    {
+        glm::vec3 min; // Bounds of its trees; inverted when it has none
+        glm::vec3 max;
+        Model *model;
+        uint32_t firstTree;
+        uint32_t treeCount;
+        std::vector<glm::mat4> matrices; // Transforms of its trees, built with the chunk
+        uint32_t visibleTrees;           // This frame's count of its trees set in staticVisible
+    };
+    std::vector<TreeChunk> treeChunks;
+    CullBounds treeOccludees; // Tree boxes again, for the software occlusion test
+    bool streamModels;
+    bool rockWallsPlaced;
+
     void loadTerrainTexture();
     void loadTrees();
-    void placeTrees(int numTrees = 100);
+    // Poisson-disk scatter over the terrain, chunk by chunk, clear of the walls; after placeRockWalls()
+    void scatterTrees();
     void loadRockWalls();
     void placeRockWalls();
+    // World transform of an instance standing on the terrain at position
+    glm::mat4 instanceMatrix(const glm::vec3 &position, float rotation, float scale) const;
+    // Caches every instance's world transform and rebuilds the static scene
+    template <typename Instance>
+    void placeInstances(std::vector<Instance> &instances);
+    // Render bounds of every tree and wall, widened to their collision footprints
+    void buildStaticScene();
+    // One instanced draw per tree model from the chunks with trees left in staticVisible
+    void drawTrees(const glm::vec3 &color);
+    // Draws each model once with the transforms of its instances marked in staticVisible,
+    // where instance i is item firstItem + i
+    template <typename Instance>
+    void drawInstances(const std::vector<Instance> &instances, const std::vector<Model *> &models, size_t firstItem,
+                       const glm::vec3 &color);
 };
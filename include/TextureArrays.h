@@ -0,0 +1,98 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ShaderProgram.h"
+
+// Baked texture array (little endian, written into the pack by tools/AssetPacker.cpp):
+//   TextureArrayHeader
+//   TextureArrayLayer[layerCount]   pack key of the image each layer was baked from
+//   path string table
+//   RGBA8 texels of level 0, one layer after another, from dataOffset
+static const char TEXTURE_ARRAY_MAGIC[4] = {'S', 'C', 'T', 'A'};
+static const uint32_t TEXTURE_ARRAY_VERSION = 1;
+
+struct TextureArrayHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t layerCount;
+    uint32_t stringTableSize;
+    uint64_t dataOffset;
+};
+
+struct TextureArrayLayer
+{
+    uint32_t pathOffset;
+    uint32_t pathLength;
+};
+
+// Material images the packer bakes into one array. Every layer is resized to the
+// largest power-of-two square that no source has to be enlarged for, up to maxEdge.
+struct TextureArrayDefinition
+{
+    const char *key;
+    int maxEdge;
+    std::vector<const char *> layers;
+};
+
+inline const std::vector<TextureArrayDefinition> &GetTextureArrayDefinitions()
+{
+    static const std::vector<TextureArrayDefinition> definitions = {
+        {"images/baked/scenery_materials.texarray", 1024,
+         {"images/Terrain/Tree/textures/gleditsia triacanthos bark a1.jpg",
+          "images/Terrain/Tree/textures/gleditsia triacanthos bark a2.jpg",
+          "images/Terrain/Tree/textures/gleditsia triacanthos bark2 a1.jpg",
+          "images/Terrain/Tree/textures/gleditsia triacanthos leaf color a1.jpg",
+          "images/Terrain/Tree/textures/gleditsia triacanthos leaf color a2.jpg",
+          "images/Terrain/Tree/textures/gleditsia triacanthos leaf color b1.jpg",
+          "images/Terrain/Tree/textures/gleditsia triacanthos leaf color b2.jpg",
+          "images/Terrain/Tree/textures/gleditsia triacanthos beans color.jpg",
+          "images/Terrain/Tree/textures/gleditsia triacanthos flowers color.jpg",
+          "images/Terrain/Tree/textures/gleditsia triacanthos stem.jpg",
+          "images/RockWall/brown/stonewall_Base_Color.png"}},
+    };
+    return definitions;
+}
+
+// Runtime side: maps material image paths to a layer of a baked GL_TEXTURE_2D_ARRAY,
+// so meshes using any of them share one texture binding. Running from loose files,
+// or with a pack built without the arrays, every lookup misses and models keep
+// their individual textures.
+class TextureArrays
+{
+public:
+    // Unit the array sampler is bound to, clear of the 2D sampler and the environment cube
+    static const int TextureUnit = 2;
+
+    static TextureArrays &Get();
+
+    // GL thread. The array holding path as a layer, or 0 when it was not baked into one.
+    // The texels are decoded by the asset streamer, then uploaded and kept under budget by
+    // TextureUploader and TextureResidency; until the first levels land the array is grey.
+    unsigned int find(const std::string &path, int &layer);
+
+    // Points the shader's array sampler at TextureUnit, so it never aliases another sampler type
+    void bind(ShaderProgram &program) const;
+
+    void shutdown();
+
+private:
+    TextureArrays() = default;
+
+    void mountBakedArrays();
+
+    struct LayerRef
+    {
+        unsigned int texture;
+        int layer;
+    };
+
+    std::unordered_map<std::string, LayerRef> layers; // Keyed by virtual path
+    std::vector<unsigned int> arrays;
+    bool mounted = false;
+};
@@ -0,0 +1,73 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "TextureUploader.h"
+
+// Mip residency for streamed textures. Draw code reports how large each
+// texture's surface is on screen; once per frame update() turns that into
+// the finest mip level each texture needs, uploads missing levels through
+// TextureUploader and drops unneeded ones by raising GL_TEXTURE_BASE_LEVEL and
+// freeing the finer levels. When the wanted levels would exceed the budget,
+// the least recently drawn textures give up their finest levels first.
+// The CPU mip chains stay in memory so dropped levels can be re-uploaded.
+class TextureResidency
+{
+public:
+    static TextureResidency &Get();
+
+    void setBudget(size_t bytes) { budgetBytes = bytes; }
+    size_t getBudget() const { return budgetBytes; }
+    // Estimated video memory held by the levels currently resident
+    size_t getResidentBytes() const { return residentBytes; }
+
+    // GL thread. Takes over the texture's mip chain, level 0 first. Until the texture is
+    // first reported it is streamed in at full resolution. A GL_TEXTURE_2D_ARRAY is counted
+    // and dropped a level at a time across all its layers.
+    void registerTexture(unsigned int texture, int components, std::vector<TextureUploader::MipLevel> levels,
+                         GLenum target = GL_TEXTURE_2D);
+
+    // Camera for this frame's reports. pixelsPerUnit is the on-screen size of one world
+    // unit at distance one, i.e. viewport height / (2 tan(fovY / 2)).
+    void setView(const glm::vec3 &viewPos, float pixelsPerUnit);
+    glm::vec3 getViewPos() const { return viewPos; }
+    // On-screen diameter, in pixels, of a sphere in world space
+    float projectedSize(const glm::vec3 &center, float radius) const;
+    // texture is drawn across screenSizePx pixels this frame; the largest report wins
+    void noteUsage(unsigned int texture, float screenSizePx);
+
+    // GL thread, once per frame before TextureUploader::update
+    void update();
+    void shutdown();
+
+private:
+    TextureResidency();
+
+    struct Entry
+    {
+        int components = 0;
+        GLenum target = GL_TEXTURE_2D;
+        std::shared_ptr<const std::vector<TextureUploader::MipLevel>> levels;
+        int residentLevel = 0;  // Finest level resident; levels->size() when none is
+        int uploadTarget = -1;  // Finest level of the upload in flight, -1 when idle
+        int floorLevel = 0;     // Coarsest level ever wanted; never dropped
+        int neededLevel = 0;    // From the last frame the texture was drawn
+        int frameLevel = 0;     // Accumulates this frame's reports
+        bool reported = false;
+        unsigned long lastUsedFrame = 0;
+    };
+
+    static size_t levelBytes(const Entry &entry, int level);
+    static size_t bytesFrom(const Entry &entry, int level);
+    void onLevelResident(unsigned int texture, int level);
+    void drop(unsigned int texture, Entry &entry, int level);
+
+    std::unordered_map<unsigned int, Entry> textures;
+    size_t budgetBytes;
+    size_t residentBytes;
+    unsigned long frame;
+    glm::vec3 viewPos;
+    float pixelsPerUnit;
+};
@@ -0,0 +1,89 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Incremental texture uploads through a ring of pixel buffer objects.
+// Mip chains are built on the CPU by the decoder, then copied into a PBO and
+// transferred with glTexSubImage2D in strips, a few per frame. The smallest
+// mips of every queued texture go first, so a texture becomes usable at low
+// resolution within a frame and sharpens as its larger levels arrive.
+// GL_TEXTURE_BASE_LEVEL tracks the finest level that is fully resident.
+// Texture arrays go the same way, one layer's strips at a time.
+// The chain itself belongs to TextureResidency, which asks for ranges of
+// levels as the textures' on-screen size changes.
+class TextureUploader
+{
+public:
+    struct MipLevel
+    {
+        int width = 0;
+        int height = 0;
+        int layers = 1; // Of a texture array, each a whole image after the previous one
+        std::vector<unsigned char> pixels;
+    };
+
+    static TextureUploader &Get();
+
+    // CPU only, safe on worker threads. Box-filters down to 1x1, level 0 first.
+    static std::vector<MipLevel> BuildMipChain(const unsigned char *pixels, int width, int height, int components);
+
+    // Called on the GL thread each time a level becomes the texture's base level
+    using LevelCallback = std::function<void(unsigned int texture, int level)>;
+
+    static GLenum FormatFor(int components);
+
+    // GL thread. Uploads levels coarsest down to finest, inclusive; texture keeps whatever it
+    // samples now until the first of them lands. levels must stay unchanged until then.
+    // target is GL_TEXTURE_2D or GL_TEXTURE_2D_ARRAY.
+    void enqueue(unsigned int texture, int components, std::shared_ptr<const std::vector<MipLevel>> levels,
+                 int coarsest, int finest, GLenum target = GL_TEXTURE_2D);
+    // Drops texture's queued levels; the ones already resident stay
+    void cancel(unsigned int texture);
+    void setLevelCallback(LevelCallback callback) { onLevelResident = std::move(callback); }
+
+    // GL thread, once per frame. Copies at most budgetBytes and never waits on the GPU:
+    // when the next ring slot is still in flight the rest is left for the next frame.
+    void update(size_t budgetBytes);
+
+    // Deletes the ring; pending uploads are dropped
+    void shutdown();
+
+    bool isIdle() const { return pending.empty(); }
+    size_t getPendingBytes() const { return pendingBytes; }
+
+private:
+    TextureUploader();
+
+    struct PendingTexture
+    {
+        unsigned int texture;
+        GLenum target;
+        GLenum format;
+        int components;
+        std::shared_ptr<const std::vector<MipLevel>> levels;
+        int level; // Level being uploaded, counts down to finest
+        int finest;
+        int row;   // Next row of that level, counted through its layers
+        bool resident; // At least one level uploaded
+    };
+
+    struct Slot
+    {
+        unsigned int buffer = 0;
+        size_t capacity = 0;
+        GLsync fence = nullptr;
+    };
+
+    PendingTexture *pickNext();
+    Slot *acquireSlot(size_t bytes);
+
+    std::deque<PendingTexture> pending;
+    std::vector<Slot> ring;
+    size_t nextSlot;
+    size_t pendingBytes;
+    LevelCallback onLevelResident;
+};
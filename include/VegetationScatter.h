@@ -0,0 +1,82 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Blue-noise (Poisson-disk) placements for vegetation over a rectangle of ground, made
+// chunk by chunk on worker threads. A chunk is seeded from the scatter seed and its
+// cell alone, so it comes out the same whatever else is generated, and its points keep
+// half the spacing clear of its edges, so neighbouring chunks never need each other.
+// The points are then thinned by a density map and dropped from excluded ground.
+class VegetationScatter
+{
+public:
+    struct Settings
+    {
+        glm::vec2 min = glm::vec2(-50.0f); // Area in xz
+        glm::vec2 max = glm::vec2(50.0f);
+        float chunkSize = 10.0f;
+        float spacing = 3.0f; // Least distance between two points
+        uint32_t seed = 1;
+        float minScale = 1.0f;
+        float maxScale = 1.0f;
+    };
+
+    struct Point
+    {
+        glm::vec2 position; // xz
+        float rotation;     // Around Y, radians
+        float scale;
+    };
+
+    struct Chunk
+    {
+        int cellX = 0; // min + cell * chunkSize is the chunk's corner
+        int cellZ = 0;
+        glm::vec2 min = glm::vec2(0.0f);
+        glm::vec2 max = glm::vec2(0.0f);
+        std::vector<Point> points;
+        std::vector<glm::mat4> matrices; // Placement of each point
+        float generationMs = 0.0f;
+    };
+
+    // Chance, 0 to 1, that a point at (x, z) is kept. Called on worker threads.
+    using DensityMap = std::function<float(float x, float z)>;
+    // World transform of a kept point. Called on worker threads.
+    using Placement = std::function<glm::mat4(const Point &point)>;
+
+    // Ground no point may land on, such as a wall footprint
+    void addExclusion(const glm::vec2 &min, const glm::vec2 &max);
+    // Ground within radius of the segment a to b, such as a path; a circle when a == b
+    void addClearing(const glm::vec2 &a, const glm::vec2 &b, float radius);
+    void clearExclusions()
+    {
+        exclusions.clear();
+        clearings.clear();
+    }
+
+    // Every chunk overlapping the area, row by row, empty ones included. Blocks until all are done.
+    std::vector<Chunk> generate(const Settings &settings, const DensityMap &density, const Placement &placement) const;
+
+private:
+    struct Exclusion
+    {
+        glm::vec2 min;
+        glm::vec2 max;
+    };
+
+    struct Clearing
+    {
+        glm::vec2 a;
+        glm::vec2 b;
+        float radius;
+    };
+
+    void generateChunk(const Settings &settings, const DensityMap &density, const Placement &placement,
+                       Chunk &chunk) const;
+    bool isExcluded(const glm::vec2 &point) const;
+
+    std::vector<Exclusion> exclusions;
+    std::vector<Clearing> clearings;
+};
@@ -0,0 +1,90 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "AssetPack.h"
+
+// Bytes of one asset. Points into the pack mapping, or into a private mapping
+// of a loose file that lives as long as this object.
+class AssetData
+{
+public:
+    const unsigned char *data() const { return bytes; }
+    size_t size() const { return length; }
+    bool valid() const { return bytes != nullptr; }
+    std::string text() const { return valid() ? std::string(reinterpret_cast<const char *>(bytes), length) : std::string(); }
+
+private:
+    friend class VirtualFileSystem;
+    const unsigned char *bytes = nullptr;
+    size_t length = 0;
+    std::unique_ptr<MappedFile> mapping;
+};
+
+// Virtual paths are pack keys: "images/..." and "shaders/...". Any path that
+// reaches into those folders ("../images/x.png", "../shaders/vertex.glsl")
+// is accepted and normalized. Mounts are searched newest first, so the usual
+// order is loose directory, then pack, then override directory.
+class VirtualFileSystem
+{
+public:
+    static VirtualFileSystem &Get();
+
+    // Resolves the loose asset root once and mounts, in order:
+    //   SIMPLECATAPULT_ASSET_ROOT or the first of ".", "..", "../.." holding images/
+    //   SIMPLECATAPULT_ASSET_PACK or the first of "assets.pak", "../assets.pak", "build/assets.pak"
+    //   relative to the working directory (unless SIMPLECATAPULT_LOOSE_ASSETS is set)
+    //   SIMPLECATAPULT_ASSET_OVERRIDE, if set
+    void mountDefaults();
+
+    // Root must contain images/ and/or shaders/; its tree is snapshotted once
+    bool mountDirectory(const std::string &root);
+    bool mountPack(const std::string &packPath);
+    void unmountAll();
+
+    // Answered from the directory snapshots and pack directories, never from the disk
+    bool exists(const std::string &path);
+    // Normalized virtual path, memoised
+    std::string resolve(const std::string &path);
+    AssetData open(const std::string &path);
+    std::string readText(const std::string &path);
+
+    // The mounted pack, or nullptr when running from loose files. Packs are never
+    // unmounted singly, so the pointer stays valid until unmountAll()
+    const AssetPack *getPack() const;
+    // Disk location of a loose file, empty when the path is packed or missing
+    std::string getDiskPath(const std::string &path);
+
+    // Cheap identity for derived-data cache keys: the packer's content hash for
+    // packed files; size, modification time and the first and last 64 KB for
+    // loose ones. Returns 0 when the file is missing.
+    uint64_t fingerprint(const std::string &path);
+
+private:
+    VirtualFileSystem() = default;
+
+    struct Mount
+    {
+        std::string root;                    // Loose directory, empty for packs
+        std::unordered_set<std::string> files; // Snapshot of virtual paths under root
+        std::unique_ptr<AssetPack> pack;
+    };
+
+    struct Resolved
+    {
+        std::string key;
+        int mount; // Index into mounts, -1 when missing
+    };
+
+    const Resolved &lookup(const std::string &path);
+
+    std::vector<Mount> mounts;
+    std::unordered_map<std::string, Resolved> resolvedPaths;
+    bool defaultsMounted = false; // Guarded by defaultsMutex, which is always taken before mutex
+    std::mutex defaultsMutex;
+    mutable std::mutex mutex;
+};
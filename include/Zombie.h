@@ -1,6 +1,7 @@
 #ifndef ZOMBIE_H
 #define ZOMBIE_H
 
+#include "FrustumCuller.h"
 #include "Model.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -8,6 +9,7 @@
 #include <assimp/scene.h>
 #include <string>
 #include <map>
+#include <vector>
 
 // Zombie behavior types
 enum class ZombieBehavior
@@ -40,7 +42,10 @@ public:
 
     // Update with catapult distance checking
     void update(float deltaTime, const glm::vec3 &targetPosition, float terrainHeight, float distanceToCatapult);
-    void draw(unsigned int shaderProgram);
+    // A nonzero occlusionQuery draws the zombie under conditional rendering on it
+    void draw(unsigned int occlusionQuery = 0);
+    // World bounds for frustum culling, unbounded until the model knows its size
+    void addBounds(CullBounds &bounds) const;
 
     // Animation control
     void setAnimationState(ZombieAnimationState state);
@@ -48,6 +53,8 @@ public:
     // Static animation cache to share animations between all zombies
     static void initializeAnimationCache();
     static void cleanupAnimationCache();
+    // Every clip a zombie can switch to
+    static std::vector<std::string> GetAnimationPaths();
 
     // Getters and setters
     glm::vec3 getPosition() const { return position; }
@@ -104,6 +111,8 @@ public:
     bool isAttacking() const { return currentAnimState == ZombieAnimationState::ATTACKING; }
 
 private:
+    glm::mat4 getModelMatrix() const;
+
     Model *model;
     glm::vec3 position;
     glm::vec3 rotation;
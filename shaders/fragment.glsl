@@ -8,25 +8,90 @@ out vec4 FragColor;
 
 in vec3 FragPos;
 in vec3 Normal;
+#ifdef TEXTURED
 in vec2 TexCoord;
+#endif
+#ifdef TEXTURE_ARRAY
+flat in float TexLayer;
+#endif
 
+// TEXTURED and TEXTURE_ARRAY are inserted by ShaderPermutations (see vertex.glsl)
 uniform vec3 objectColor;
+#ifdef DITHER_FADE
+uniform float impostorFade; // Share of the pixels the object's impostor covers
+#endif
+#ifdef TEXTURE_ARRAY
+uniform sampler2DArray texture_array; // Baked material layers, indexed by TexLayer
+#elif defined(TEXTURED)
 uniform sampler2D texture_diffuse1;
-uniform bool useTexture;
+#endif
 uniform vec3 sunDirection;  // Direction TO the sun (normalized)
 uniform vec3 sunColor;
 uniform vec3 viewPos;
 uniform vec3 sunPos;        // Actual position of sun in world
 
+// Sky lighting precomputed from the skybox (EnvironmentLighting)
+uniform bool useEnvironmentLighting;
+uniform vec3 shCoefficients[9];       // Irradiance SH, pre-divided by pi
+uniform mat3 environmentRotation;     // World direction -> skybox cubemap direction
+uniform float environmentIntensity;
+uniform samplerCube prefilteredEnvironment;
+uniform float prefilteredMaxLod;
+
+vec3 evaluateSH(vec3 n)
+{
+    return shCoefficients[0] * 0.282095
+         + shCoefficients[1] * 0.488603 * n.y
+         + shCoefficients[2] * 0.488603 * n.z
+         + shCoefficients[3] * 0.488603 * n.x
+         + shCoefficients[4] * 1.092548 * n.x * n.y
+         + shCoefficients[5] * 1.092548 * n.y * n.z
+         + shCoefficients[6] * 0.315392 * (3.0 * n.z * n.z - 1.0)
+         + shCoefficients[7] * 1.092548 * n.x * n.z
+         + shCoefficients[8] * 0.546274 * (n.x * n.x - n.y * n.y);
+}
+
+#ifdef DITHER_FADE
+// Same ordered 4x4 threshold as the impostor shader (Impostor.cpp)
+float bayer4(vec2 pixel)
+{
+    const float thresholds[16] = float[16](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0,
+                                           3.0, 11.0, 1.0, 9.0, 15.0, 7.0, 13.0, 5.0);
+    ivec2 p = ivec2(mod(pixel, 4.0));
+    return (thresholds[p.x + 4 * p.y] + 0.5) / 16.0;
+}
+#endif
+
 void main()
 {
+#ifdef DITHER_FADE
+    // The impostor keeps exactly the pixels whose threshold is below its fade, so the two
+    // cover each pixel once between them
+    if (impostorFade > bayer4(gl_FragCoord.xy))
+        discard;
+#endif
+
     // === DIRECTIONAL LIGHT (Global sun illumination) ===
     vec3 norm = normalize(Normal);
     vec3 lightDir = normalize(sunDirection);
     
-    // Ambient lighting (base illumination)
-    float ambientStrength = 0.3;
-    vec3 ambient = ambientStrength * sunColor;
+    vec3 viewDir = normalize(viewPos - FragPos);
+
+    // Ambient lighting (base illumination): sky irradiance when available
+    vec3 ambient;
+    vec3 environmentSpecular = vec3(0.0);
+    if(useEnvironmentLighting) {
+        ambient = max(evaluateSH(environmentRotation * norm), vec3(0.0)) * environmentIntensity;
+
+        // Glossy sky reflection, mostly visible at grazing angles (Schlick Fresnel, F0 = 0.04)
+        vec3 reflected = environmentRotation * reflect(-viewDir, norm);
+        float fresnel = 0.04 + 0.96 * pow(1.0 - max(dot(norm, viewDir), 0.0), 5.0);
+        environmentSpecular = textureLod(prefilteredEnvironment, reflected, prefilteredMaxLod * 0.6).rgb
+                            * fresnel * environmentIntensity;
+    } else {
+        float ambientStrength = 0.3;
+        ambient = ambientStrength * sunColor;
+    }
     
     // Diffuse lighting (sun shining on surfaces)
     float diff = max(dot(norm, lightDir), 0.0);
@@ -34,7 +99,6 @@ void main()
     
     // Specular lighting (shiny highlights)
     float specularStrength = 0.5;
-    vec3 viewDir = normalize(viewPos - FragPos);
     vec3 reflectDir = reflect(-lightDir, norm);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
     vec3 specular = specularStrength * spec * sunColor;
@@ -59,10 +123,13 @@ void main()
     vec3 pointSpecular = pointSpec * sunColor * attenuation;
     
     // === COMBINE ALL LIGHTING ===
+#ifdef TEXTURE_ARRAY
+    vec3 baseColor = texture(texture_array, vec3(TexCoord, TexLayer)).rgb;
+#elif defined(TEXTURED)
+    vec3 baseColor = texture(texture_diffuse1, TexCoord).rgb;
+#else
     vec3 baseColor = objectColor;
-    if(useTexture) {
-        baseColor = texture(texture_diffuse1, TexCoord).rgb;
-    }
-    vec3 result = (ambient + diffuse + specular + pointDiffuse + pointSpecular) * baseColor;
+#endif
+    vec3 result = (ambient + diffuse + specular + pointDiffuse + pointSpecular) * baseColor + environmentSpecular;
     FragColor = vec4(result, 1.0);
 }
@@ -1,47 +1,73 @@
 #version 330 core
+// Compiled once per feature set by ShaderPermutations, which inserts the #defines:
+//   SKINNED        blend up to four bone matrices per vertex
+//   TEXTURED       pass texture coordinates on
+//   TEXTURE_ARRAY  pass the vertex's texture array layer on
+//   INSTANCED      take the model matrix from a per-instance attribute
+//   DITHER_FADE    fragment shader only: dither out as an impostor dithers in
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoord;
+#ifdef SKINNED
 layout (location = 3) in ivec4 aBoneIDs;
 layout (location = 4) in vec4 aWeights;
+#endif
+#ifdef TEXTURE_ARRAY
+layout (location = 5) in float aLayer; // Texture array layer of the vertex's material
+#endif
+#ifdef INSTANCED
+layout (location = 6) in mat4 aInstanceModel; // Locations 6-9, advanced once per instance
+#endif
 
 uniform mat4 model;
+uniform mat3 normalMatrix; // transpose(inverse(mat3(model))), computed once per object
 uniform mat4 view;
 uniform mat4 projection;
+#ifdef SKINNED
 uniform mat4 gBones[100];
-uniform bool useAnimation;
+#endif
 
 out vec3 FragPos;
 out vec3 Normal;
+#ifdef TEXTURED
 out vec2 TexCoord;
+#endif
+#ifdef TEXTURE_ARRAY
+flat out float TexLayer;
+#endif
 
 void main()
 {
-    vec4 totalPosition = vec4(0.0);
-    vec3 totalNormal = vec3(0.0);
-    
-    if(useAnimation && aWeights[0] > 0.0)
-    {
-        // Apply bone transformations
-        for(int i = 0; i < 4; i++)
-        {
-            if(aBoneIDs[i] >= 0)
-            {
-                mat4 boneTransform = gBones[aBoneIDs[i]];
-                totalPosition += boneTransform * vec4(aPos, 1.0) * aWeights[i];
-                totalNormal += mat3(boneTransform) * aNormal * aWeights[i];
-            }
-        }
-    }
-    else
-    {
-        totalPosition = vec4(aPos, 1.0);
-        totalNormal = aNormal;
-    }
-    
-    FragPos = vec3(model * totalPosition);
-    Normal = mat3(transpose(inverse(model))) * normalize(totalNormal);
+#ifdef SKINNED
+    // Unused slots carry zero weight, so the four matrices blend without branching.
+    // Vertices without bone influences keep their bind pose.
+    mat4 skin = gBones[aBoneIDs[0]] * aWeights[0] + gBones[aBoneIDs[1]] * aWeights[1]
+              + gBones[aBoneIDs[2]] * aWeights[2] + gBones[aBoneIDs[3]] * aWeights[3];
+    if (aWeights[0] <= 0.0)
+        skin = mat4(1.0);
+    vec4 localPosition = skin * vec4(aPos, 1.0);
+    vec3 localNormal = mat3(skin) * aNormal;
+#else
+    vec4 localPosition = vec4(aPos, 1.0);
+    vec3 localNormal = aNormal;
+#endif
+
+#ifdef INSTANCED
+    // Instances are only rotated and uniformly scaled, so mat3 of the transform keeps
+    // normals perpendicular; the fragment shader normalises their length
+    vec4 worldPosition = aInstanceModel * localPosition;
+    Normal = mat3(aInstanceModel) * localNormal;
+#else
+    vec4 worldPosition = model * localPosition;
+    Normal = normalMatrix * localNormal;
+#endif
+    FragPos = vec3(worldPosition);
+#ifdef TEXTURED
     TexCoord = aTexCoord;
-    
-    gl_Position = projection * view * model * totalPosition;
+#endif
+#ifdef TEXTURE_ARRAY
+    TexLayer = aLayer;
+#endif
+
+    gl_Position = projection * view * worldPosition;
 }
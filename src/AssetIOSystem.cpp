@@ -0,0 +1,96 @@
+#include "AssetIOSystem.h"
+#include <cstring>
+#include <utility>
+
+// ===== MemoryIOStream =====
+MemoryIOStream::MemoryIOStream(AssetData asset)
+    : asset(std::move(asset)), position(0)
+{
+}
+
+size_t MemoryIOStream::Read(void *buffer, size_t elementSize, size_t count)
+{
+    size_t size = asset.size();
+    if (elementSize == 0 || count == 0 || position >= size)
+        return 0;
+
+    size_t available = (size - position) / elementSize;
+    size_t elements = count < available ? count : available;
+    std::memcpy(buffer, asset.data() + position, elements * elementSize);
+    position += elements * elementSize;
+    return elements;
+}
+
+size_t MemoryIOStream::Write(const void *, size_t, size_t)
+{
+    return 0; // Assets are read-only
+}
+
+aiReturn MemoryIOStream::Seek(size_t offset, aiOrigin origin)
+{
+    size_t size = asset.size();
+    size_t target;
+    switch (origin)
+    {
+    case aiOrigin_SET:
+        target = offset;
+        break;
+    case aiOrigin_CUR:
+        target = position + offset;
+        break;
+    case aiOrigin_END:
+        if (offset > size)
+            return aiReturn_FAILURE;
+        target = size - offset;
+        break;
+    default:
+        return aiReturn_FAILURE;
+    }
+
+    if (target > size)
+        return aiReturn_FAILURE;
+    position = target;
+    return aiReturn_SUCCESS;
+}
+
+size_t MemoryIOStream::Tell() const
+{
+    return position;
+}
+
+size_t MemoryIOStream::FileSize() const
+{
+    return asset.size();
+}
+
+void MemoryIOStream::Flush()
+{
+}
+
+// ===== AssetIOSystem =====
+bool AssetIOSystem::Exists(const char *file) const
+{
+    return VirtualFileSystem::Get().exists(file);
+}
+
+char AssetIOSystem::getOsSeparator() const
+{
+    return '/';
+}
+
+Assimp::IOStream *AssetIOSystem::Open(const char *file, const char *mode)
+{
+    // Importers only ever read
+    if (std::strchr(mode, 'w') != nullptr || std::strchr(mode, 'a') != nullptr)
+        return nullptr;
+
+    AssetData asset = VirtualFileSystem::Get().open(file);
+    if (!asset.valid())
+        return nullptr;
+    return new MemoryIOStream(std::move(asset));
+}
+
+void AssetIOSystem::Close(Assimp::IOStream *stream)
+{
+    delete stream;
+}
@@ -0,0 +1,282 @@
+#include "AssetPack.h"
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// ===== MappedFile =====
+MappedFile::MappedFile()
+    : mappedData(nullptr), mappedSize(0)
+#ifdef _WIN32
+      ,
+      fileHandle(nullptr), mappingHandle(nullptr)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::string &path)
+{
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle = file;
+    mappingHandle = mapping;
+    mappedData = static_cast<const unsigned char *>(view);
+    mappedSize = static_cast<size_t>(fileSize.QuadPart);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void *view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps the file alive, the descriptor is no longer needed
+    ::close(fd);
+    if (view == MAP_FAILED)
+        return false;
+
+    mappedData = static_cast<const unsigned char *>(view);
+    mappedSize = static_cast<size_t>(st.st_size);
+#endif
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (!mappedData)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(mappedData);
+    CloseHandle(static_cast<HANDLE>(mappingHandle));
+    CloseHandle(static_cast<HANDLE>(fileHandle));
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    munmap(const_cast<unsigned char *>(mappedData), mappedSize);
+#endif
+    mappedData = nullptr;
+    mappedSize = 0;
+}
+
+// ===== AssetPack =====
+bool AssetPack::open(const std::string &path)
+{
+    close();
+
+    if (!file.open(path))
+        return false;
+
+    const unsigned char *base = file.data();
+    if (file.size() < sizeof(PackHeader))
+    {
+        std::cerr << "Asset pack too small: " << path << std::endl;
+        close();
+        return false;
+    }
+
+    const PackHeader *header = reinterpret_cast<const PackHeader *>(base);
+    if (std::memcmp(header->magic, PACK_MAGIC, 4) != 0 || header->version != PACK_VERSION)
+    {
+        std::cerr << "Asset pack has wrong magic or version: " << path << std::endl;
+        close();
+        return false;
+    }
+
+    // Sizes are compared against what is left rather than summed, so no field can overflow past a check
+    uint64_t fileSize = file.size();
+    uint64_t directoryEnd = sizeof(PackHeader) + uint64_t(header->entryCount) * sizeof(PackEntry);
+    if (directoryEnd > fileSize || header->stringTableOffset > fileSize ||
+        header->stringTableSize > fileSize - header->stringTableOffset)
+    {
+        std::cerr << "Asset pack directory is truncated: " << path << std::endl;
+        close();
+        return false;
+    }
+
+    entries = reinterpret_cast<const PackEntry *>(base + sizeof(PackHeader));
+    entryCount = header->entryCount;
+    stringTable = reinterpret_cast<const char *>(base + header->stringTableOffset);
+
+    for (size_t i = 0; i < entryCount; i++)
+    {
+        // The path is checked first, since the error message for a bad data range prints it
+        const PackEntry &entry = entries[i];
+        if (entry.pathOffset > header->stringTableSize || entry.pathLength > header->stringTableSize - entry.pathOffset)
+        {
+            std::cerr << "Asset pack entry " << i << " has its path outside the string table: " << path << std::endl;
+            close();
+            return false;
+        }
+        if (entry.offset > fileSize || entry.size > fileSize - entry.offset)
+        {
+            std::cerr << "Asset pack entry out of range: " << getEntryPath(i) << std::endl;
+            close();
+            return false;
+        }
+    }
+
+    packPath = path;
+    return true;
+}
+
+void AssetPack::close()
+{
+    file.close();
+    entries = nullptr;
+    entryCount = 0;
+    stringTable = nullptr;
+    packPath.clear();
+}
+
+const PackEntry *AssetPack::findEntry(const std::string &path) const
+{
+    if (!isOpen())
+        return nullptr;
+
+    std::string key = NormalizePath(path);
+    uint64_t hash = HashPath(key);
+
+    const PackEntry *end = entries + entryCount;
+    const PackEntry *it = std::lower_bound(entries, end, hash,
+                                           [](const PackEntry &entry, uint64_t value)
+                                           { return entry.pathHash < value; });
+
+    // Confirm against the stored path so a hash collision can never return the wrong asset
+    for (; it != end && it->pathHash == hash; ++it)
+    {
+        if (it->pathLength == key.size() &&
+            std::memcmp(stringTable + it->pathOffset, key.data(), key.size()) == 0)
+            return it;
+    }
+    return nullptr;
+}
+
+const unsigned char *AssetPack::find(const std::string &path, size_t &size) const
+{
+    const PackEntry *entry = findEntry(path);
+    if (!entry)
+    {
+        size = 0;
+        return nullptr;
+    }
+    size = static_cast<size_t>(entry->size);
+    return file.data() + entry->offset;
+}
+
+std::string AssetPack::getEntryPath(size_t index) const
+{
+    return std::string(stringTable + entries[index].pathOffset, entries[index].pathLength);
+}
+
+uint64_t AssetPack::HashPath(const std::string &normalizedPath)
+{
+    return HashBytes(normalizedPath.data(), normalizedPath.size());
+}
+
+uint64_t AssetPack::HashBytes(const void *data, size_t size, uint64_t seed)
+{
+    // 64-bit FNV-1a
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+std::string AssetPack::NormalizePath(const std::string &path)
+{
+    std::vector<std::string> segments;
+    std::string segment;
+
+    auto flush = [&]()
+    {
+        if (segment.empty() || segment == ".")
+            ; // Empty and current-directory components carry no information
+        else if (segment == ".." && !segments.empty() && segments.back() != "..")
+            segments.pop_back();
+        else
+            segments.push_back(segment);
+        segment.clear();
+    };
+
+    for (char c : path)
+    {
+        if (c == '/' || c == '\\')
+            flush();
+        else
+            segment += c;
+    }
+    flush();
+
+    // Keep everything from the last asset root onwards
+    size_t first = 0;
+    for (size_t i = segments.size(); i-- > 0;)
+    {
+        if (segments[i] == "images" || segments[i] == "shaders")
+        {
+            first = i;
+            break;
+        }
+    }
+
+    std::string result;
+    for (size_t i = first; i < segments.size(); i++)
+    {
+        if (!result.empty())
+            result += '/';
+        result += segments[i];
+    }
+    return result;
+}
@@ -0,0 +1,214 @@
+#include "AssetStreamer.h"
+#include <GL/glew.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include "../third_party/stb_image.h"
+#include "ImageRows.h"
+#include "TextureResidency.h"
+#include "VirtualFileSystem.h"
+
+static const size_t COMPLETION_QUEUE_CAPACITY = 256;
+
+AssetStreamer &AssetStreamer::Get()
+{
+    static AssetStreamer instance;
+    return instance;
+}
+
+AssetStreamer::AssetStreamer()
+    : completed(COMPLETION_QUEUE_CAPACITY), stopping(false), pending(0), running(false)
+{
+}
+
+AssetStreamer::~AssetStreamer()
+{
+    // The GL context is gone by now; only the threads need cleaning up
+    stopping = true;
+    requestReady.notify_all();
+    for (auto &worker : workers)
+    {
+        if (worker.joinable())
+            worker.join();
+    }
+}
+
+void AssetStreamer::start(unsigned int threadCount)
+{
+    if (running)
+        return;
+
+    if (threadCount == 0)
+    {
+        unsigned int cores = std::thread::hardware_concurrency();
+        threadCount = cores > 1 ? cores - 1 : 1;
+    }
+
+    stopping = false;
+    for (unsigned int i = 0; i < threadCount; i++)
+        workers.emplace_back(&AssetStreamer::workerLoop, this);
+    running = true;
+
+    std::cout << "Asset streamer started with " << threadCount << " worker threads" << std::endl;
+}
+
+void AssetStreamer::shutdown()
+{
+    if (!running)
+        return;
+
+    stopping = true;
+    requestReady.notify_all();
+    for (auto &worker : workers)
+        worker.join();
+    workers.clear();
+    running = false;
+
+    for (Job *job : requests)
+        delete job;
+    requests.clear();
+
+    Job *job = nullptr;
+    while (completed.pop(job))
+        delete job;
+    pending = 0;
+}
+
+void AssetStreamer::workerLoop()
+{
+    while (true)
+    {
+        Job *job = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(requestMutex);
+            requestReady.wait(lock, [this]() { return stopping || !requests.empty(); });
+            if (stopping)
+                return;
+            job = requests.front();
+            requests.pop_front();
+        }
+
+        job->uploadBytes = job->work ? job->work() : 0;
+
+        // The GL thread drains the queue every frame, so a full queue only lasts a frame
+        while (!completed.push(job))
+        {
+            if (stopping)
+            {
+                delete job;
+                return;
+            }
+            std::this_thread::yield();
+        }
+    }
+}
+
+void AssetStreamer::submit(WorkFn work, FinishFn finish)
+{
+    Job *job = new Job();
+    job->work = std::move(work);
+    job->finish = std::move(finish);
+    pending++;
+
+    if (!running)
+    {
+        // No workers: behave like the old synchronous loaders
+        job->uploadBytes = job->work ? job->work() : 0;
+        if (job->finish)
+            job->finish();
+        delete job;
+        pending--;
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(requestMutex);
+        requests.push_back(job);
+    }
+    requestReady.notify_one();
+}
+
+void AssetStreamer::processUploads(float budgetMs, size_t budgetBytes)
+{
+    auto startTime = std::chrono::steady_clock::now();
+    size_t uploadedBytes = 0;
+
+    Job *job = nullptr;
+    while (completed.pop(job))
+    {
+        if (job->finish)
+            job->finish();
+        uploadedBytes += job->uploadBytes;
+        delete job;
+        pending--;
+
+        float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+        if (ms >= budgetMs || uploadedBytes >= budgetBytes)
+            break;
+    }
+}
+
+// ===== Textures =====
+namespace
+{
+    struct DecodedImage
+    {
+        std::vector<TextureUploader::MipLevel> levels;
+        int components = 0;
+    };
+}
+
+unsigned int AssetStreamer::requestTexture(const std::string &path)
+{
+    auto cached = textures.find(path);
+    if (cached != textures.end())
+        return cached->second;
+
+    // Existence comes from the mount snapshots, so fallback chains still work without waiting for a decode
+    if (!VirtualFileSystem::Get().exists(path))
+        return 0;
+
+    // The final texture name is handed out now and holds a 1x1 grey placeholder until the decode lands
+    unsigned int textureID = 0;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    unsigned char greyPixel[] = {128, 128, 128, 255};
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, greyPixel);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    textures[path] = textureID;
+
+    // Decode and mip generation both happen on the worker; the GL side only streams bytes
+    std::shared_ptr<DecodedImage> image = std::make_shared<DecodedImage>();
+    submit(
+        [path, image]() -> size_t
+        {
+            AssetData asset = VirtualFileSystem::Get().open(path);
+            if (!asset.valid())
+                return 0;
+
+            int width = 0, height = 0;
+            unsigned char *pixels = stbi_load_from_memory(asset.data(), static_cast<int>(asset.size()),
+                                                          &width, &height, &image->components, 0);
+            if (pixels)
+            {
+                FlipImageRows(pixels, width, height, image->components);
+                image->levels = TextureUploader::BuildMipChain(pixels, width, height, image->components);
+                stbi_image_free(pixels);
+            }
+            return 0; // The texture uploader spends its own byte budget
+        },
+        [path, image, textureID]()
+        {
+            if (image->levels.empty())
+            {
+                std::cerr << "Failed to load texture: " << path << std::endl;
+                return;
+            }
+            TextureResidency::Get().registerTexture(textureID, image->components, std::move(image->levels));
+        });
+
+    return textureID;
+}
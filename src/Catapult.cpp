@@ -1,4 +1,6 @@
 #include "Catapult.h"
+#include "FrustumCuller.h"
+#include "RenderQueue.h"
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -617,6 +619,15 @@ void Catapult::rebuildGeometry()
     for (int k = wheelStart + 4; k < 20; ++k)
         vertexCounts[k] = 0; // Zero out unused vertex count slots
 
+    boundsMin = glm::vec3(0.0f);
+    boundsMax = glm::vec3(0.0f);
+    for (size_t i = 0; i + 2 < vertices.size(); i += 6)
+    {
+        glm::vec3 p(vertices[i], vertices[i + 1], vertices[i + 2]);
+        boundsMin = i == 0 ? p : glm::min(boundsMin, p);
+        boundsMax = i == 0 ? p : glm::max(boundsMax, p);
+    }
+
     glBindVertexArray(VAO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
@@ -817,11 +828,13 @@ void Catapult::updateWheelSteering(float deltaTime, bool isTurning)
 }
 
 // Draws the entire catapult using stored vertex data
-void Catapult::draw(unsigned int shaderProgram, float height, const glm::vec3 &terrainNormal)
+void Catapult::draw(float height, const glm::vec3 &terrainNormal)
 {
-    glUseProgram(shaderProgram);
-    unsigned int modelLoc = glGetUniformLocation(shaderProgram, "model");
-    unsigned int colorLoc = glGetUniformLocation(shaderProgram, "objectColor");
+    // Plain vertex colours: the untextured, unskinned permutation. Each part is one
+    // packet; the queue keeps them in this order since they share all their state.
+    RenderQueue &queue = RenderQueue::Get();
+    DrawPacket part;
+    part.vertexArray = VAO;
 
     // Build model matrix: translate to position, apply terrain height, rotate to match terrain slope, then rotate around Y
     // Wheels are positioned at Y = -0.2f relative to catapult origin
@@ -853,55 +866,36 @@ void Catapult::draw(unsigned int shaderProgram, float height, const glm::vec3 &t
 
     // Rotate around Y axis for steering
     model = glm::rotate(model, rotation, glm::vec3(0.0f, 1.0f, 0.0f));
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+    part.model = model;
 
-    glBindVertexArray(VAO);
+    // Steered front wheels stay inside the body's box give or take their small turn
+    if (!FrustumCuller::Get().isVisible(model, 0.5f * (boundsMin + boundsMax), boundsMax - boundsMin))
+        return;
 
     int vertexOffset = 0;
-    glUniform3f(colorLoc, 0.75f, 0.55f, 0.35f);
-    int tiers = tierCount < 1 ? 1 : tierCount;
-    for (int i = 0; i < tiers; ++i)
+    auto drawPart = [&](int count, const glm::vec3 &color)
     {
-        glDrawArrays(GL_TRIANGLES, vertexOffset, vertexCounts[i]);
-        vertexOffset += vertexCounts[i];
-    }
-
-    glUniform3f(colorLoc, 0.75f, 0.55f, 0.35f);
-    glDrawArrays(GL_TRIANGLES, vertexOffset, vertexCounts[tiers]);
-    vertexOffset += vertexCounts[tiers];
-    glDrawArrays(GL_TRIANGLES, vertexOffset, vertexCounts[tiers + 1]);
-    vertexOffset += vertexCounts[tiers + 1];
-
-    glUniform3f(colorLoc, 0.75f, 0.55f, 0.35f);
-    glDrawArrays(GL_TRIANGLES, vertexOffset, vertexCounts[tiers + 2]);
-    vertexOffset += vertexCounts[tiers + 2];
-
-    glUniform3f(colorLoc, 0.5f, 0.35f, 0.2f);
-    glDrawArrays(GL_TRIANGLES, vertexOffset, vertexCounts[tiers + 3]);
-    vertexOffset += vertexCounts[tiers + 3];
-
-    glUniform3f(colorLoc, 0.5f, 0.0f, 0.2f);
-    glDrawArrays(GL_TRIANGLES, vertexOffset, vertexCounts[tiers + 4]);
-    vertexOffset += vertexCounts[tiers + 4];
-
-    glUniform3f(colorLoc, 0.5f, 0.5f, 0.5f);
-    glDrawArrays(GL_TRIANGLES, vertexOffset, vertexCounts[tiers + 5]);
-    vertexOffset += vertexCounts[tiers + 5];
-
-    glUniform3f(colorLoc, 0.0f, 0.0f, 0.0f);
-    glDrawArrays(GL_TRIANGLES, vertexOffset, vertexCounts[tiers + 6]);
-    vertexOffset += vertexCounts[tiers + 6];
+        part.first = vertexOffset;
+        part.count = count;
+        part.color = color;
+        queue.submit(part);
+        vertexOffset += count;
+    };
 
-    glUniform3f(colorLoc, 0.3f, 0.2f, 0.1f);
-    glDrawArrays(GL_TRIANGLES, vertexOffset, vertexCounts[tiers + 7]);
-    vertexOffset += vertexCounts[tiers + 7];
+    int tiers = tierCount < 1 ? 1 : tierCount;
+    for (int i = 0; i < tiers; ++i)
+        drawPart(vertexCounts[i], glm::vec3(0.75f, 0.55f, 0.35f));
+
+    drawPart(vertexCounts[tiers], glm::vec3(0.75f, 0.55f, 0.35f));
+    drawPart(vertexCounts[tiers + 1], glm::vec3(0.75f, 0.55f, 0.35f));
+    drawPart(vertexCounts[tiers + 2], glm::vec3(0.75f, 0.55f, 0.35f));
+    drawPart(vertexCounts[tiers + 3], glm::vec3(0.5f, 0.35f, 0.2f));
+    drawPart(vertexCounts[tiers + 4], glm::vec3(0.5f, 0.0f, 0.2f));
+    drawPart(vertexCounts[tiers + 5], glm::vec3(0.5f, 0.5f, 0.5f));
+    drawPart(vertexCounts[tiers + 6], glm::vec3(0.0f, 0.0f, 0.0f));
+    drawPart(vertexCounts[tiers + 7], glm::vec3(0.3f, 0.2f, 0.1f));
     vertexOffset += vertexCounts[tiers + 8];
-
-    glUniform3f(colorLoc, 1.0f, 1.0f, 1.0f);
-    glDrawArrays(GL_TRIANGLES, vertexOffset, vertexCounts[tiers + 9]);
-    vertexOffset += vertexCounts[tiers + 9];
-
-    glUniform3f(colorLoc, 0.8f, 0.1f, 0.1f);
+    drawPart(vertexCounts[tiers + 9], glm::vec3(1.0f, 1.0f, 1.0f));
 
     float xoff = wheelHalfWidthX;
     float zoff = wheelHalfDepthZ;
@@ -939,15 +933,14 @@ void Catapult::draw(unsigned int shaderProgram, float height, const glm::vec3 &t
             wheelModel = glm::translate(wheelModel, wheelPositions[i]);
             wheelModel = glm::rotate(wheelModel, frontWheelSteerAngle, glm::vec3(0.0f, 1.0f, 0.0f));
             wheelModel = glm::translate(wheelModel, -wheelPositions[i]); // Rotate around wheel center
-            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(wheelModel));
+            part.model = wheelModel;
         }
 
-        glDrawArrays(GL_TRIANGLES, vertexOffset, vertexCounts[tiers + 10 + i]);
-        vertexOffset += vertexCounts[tiers + 10 + i];
+        drawPart(vertexCounts[tiers + 10 + i], glm::vec3(0.8f, 0.1f, 0.1f));
 
         if (i == 1 || i == 3)
         {
-            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+            part.model = model;
         }
     }
 }
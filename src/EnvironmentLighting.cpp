@@ -0,0 +1,376 @@
+#include "EnvironmentLighting.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include "GLState.h"
+
+// Edge length of the cubemap mip the precompute reads, and of the top prefiltered level
+static const int ENVIRONMENT_SOURCE_SIZE = 32;
+static const int PREFILTER_LEVELS = 5;
+// The sun disc is lit analytically; clamping keeps it from swamping the ambient term
+static const float MAX_SOURCE_RADIANCE = 4.0f;
+// Matches the brightness of the old constant ambient term
+static const float ENVIRONMENT_INTENSITY = 0.45f;
+
+static const char ENVIRONMENT_CACHE_MAGIC[4] = {'S', 'C', 'E', 'V'};
+static const uint32_t ENVIRONMENT_CACHE_VERSION = 1;
+
+struct EnvironmentCacheHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t prefilterSize;
+    uint32_t prefilterLevels;
+};
+
+// Direction through texel (x, y) of a GL cubemap face
+static glm::vec3 texelDirection(int face, int x, int y, int size)
+{
+    float s = 2.0f * (x + 0.5f) / size - 1.0f;
+    float t = 2.0f * (y + 0.5f) / size - 1.0f;
+    glm::vec3 dir;
+    switch (face)
+    {
+    case 0: dir = glm::vec3(1.0f, -t, -s); break;
+    case 1: dir = glm::vec3(-1.0f, -t, s); break;
+    case 2: dir = glm::vec3(s, 1.0f, t); break;
+    case 3: dir = glm::vec3(s, -1.0f, -t); break;
+    case 4: dir = glm::vec3(s, -t, 1.0f); break;
+    default: dir = glm::vec3(-s, -t, -1.0f); break;
+    }
+    return glm::normalize(dir);
+}
+
+// Solid angle covered by texel (x, y)
+static float texelSolidAngle(int x, int y, int size)
+{
+    float s = 2.0f * (x + 0.5f) / size - 1.0f;
+    float t = 2.0f * (y + 0.5f) / size - 1.0f;
+    float texel = 2.0f / size;
+    return texel * texel / std::pow(1.0f + s * s + t * t, 1.5f);
+}
+
+static void shBasis(const glm::vec3 &n, float basis[9])
+{
+    basis[0] = 0.282095f;
+    basis[1] = 0.488603f * n.y;
+    basis[2] = 0.488603f * n.z;
+    basis[3] = 0.488603f * n.x;
+    basis[4] = 1.092548f * n.x * n.y;
+    basis[5] = 1.092548f * n.y * n.z;
+    basis[6] = 0.315392f * (3.0f * n.z * n.z - 1.0f);
+    basis[7] = 1.092548f * n.x * n.z;
+    basis[8] = 0.546274f * (n.x * n.x - n.y * n.y);
+}
+
+// Runs job(first, last) over [0, count) split across threadCount threads
+template <typename Job>
+static void parallelFor(int count, unsigned int threadCount, const Job &job)
+{
+    std::vector<std::thread> workers;
+    int perThread = (count + static_cast<int>(threadCount) - 1) / static_cast<int>(threadCount);
+    for (int first = 0; first < count; first += perThread)
+        workers.emplace_back(job, first, std::min(count, first + perThread));
+    for (auto &worker : workers)
+        worker.join();
+}
+
+EnvironmentLighting::EnvironmentLighting()
+    : prefilterSize(0), prefilterTexture(0), ready(false), preloaded(false)
+{
+    for (auto &c : shCoefficients)
+        c = glm::vec3(0.0f);
+}
+
+EnvironmentLighting::~EnvironmentLighting()
+{
+    if (prefilterTexture != 0)
+        glDeleteTextures(1, &prefilterTexture);
+}
+
+bool EnvironmentLighting::build(unsigned int cubemapTexture, int cubemapSize, const std::string &cachePath)
+{
+    if (preloaded || (!cachePath.empty() && loadCache(cachePath, staged)))
+    {
+        adopt(staged);
+        preloaded = false;
+        uploadPrefiltered();
+        ready = true;
+        std::cout << "Loaded environment lighting from cache: " << cachePath << std::endl;
+        return true;
+    }
+
+    if (cubemapTexture == 0 || cubemapSize == 0)
+        return false;
+
+    // Read back the mip closest to the source size; the full-resolution faces are never needed
+    int level = 0;
+    while ((cubemapSize >> (level + 1)) >= ENVIRONMENT_SOURCE_SIZE)
+        level++;
+    int size = std::max(1, cubemapSize >> level);
+
+    std::vector<float> faces(static_cast<size_t>(6) * size * size * 3);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    for (int face = 0; face < 6; face++)
+        glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_RGB, GL_FLOAT,
+                      &faces[static_cast<size_t>(face) * size * size * 3]);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+    compute(faces, size);
+    uploadPrefiltered();
+    ready = true;
+    if (!cachePath.empty())
+        saveCache(cachePath);
+    return true;
+}
+
+bool EnvironmentLighting::preload(const std::string &cachePath)
+{
+    preloaded = !cachePath.empty() && loadCache(cachePath, staged);
+    return preloaded;
+}
+
+void EnvironmentLighting::adopt(Precomputed &precomputed)
+{
+    std::copy(std::begin(precomputed.shCoefficients), std::end(precomputed.shCoefficients), shCoefficients);
+    prefilterSize = precomputed.prefilterSize;
+    prefilterLevels = std::move(precomputed.prefilterLevels);
+    precomputed = Precomputed();
+}
+
+void EnvironmentLighting::compute(const std::vector<float> &faces, int size, unsigned int threadCount)
+{
+    auto startTime = std::chrono::steady_clock::now();
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    const int texelCount = 6 * size * size;
+    std::vector<glm::vec3> directions(texelCount);
+    std::vector<glm::vec3> radiance(texelCount);
+    std::vector<float> solidAngles(texelCount);
+    for (int face = 0; face < 6; face++)
+    {
+        for (int y = 0; y < size; y++)
+        {
+            for (int x = 0; x < size; x++)
+            {
+                int i = (face * size + y) * size + x;
+                directions[i] = texelDirection(face, x, y, size);
+                solidAngles[i] = texelSolidAngle(x, y, size);
+                radiance[i] = glm::min(glm::vec3(faces[i * 3], faces[i * 3 + 1], faces[i * 3 + 2]), glm::vec3(MAX_SOURCE_RADIANCE));
+            }
+        }
+    }
+
+    // ===== SH projection =====
+    // Each worker projects one slice of texels into its own partial sum
+    std::vector<std::vector<glm::vec3>> partials;
+    std::vector<std::pair<int, int>> slices;
+    int perThread = (texelCount + static_cast<int>(threadCount) - 1) / static_cast<int>(threadCount);
+    for (int first = 0; first < texelCount; first += perThread)
+        slices.push_back(std::make_pair(first, std::min(texelCount, first + perThread)));
+    partials.assign(slices.size(), std::vector<glm::vec3>(9, glm::vec3(0.0f)));
+
+    auto project = [&](size_t slice)
+    {
+        float basis[9];
+        for (int i = slices[slice].first; i < slices[slice].second; i++)
+        {
+            shBasis(directions[i], basis);
+            for (int k = 0; k < 9; k++)
+                partials[slice][k] += radiance[i] * (basis[k] * solidAngles[i]);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t slice = 0; slice < slices.size(); slice++)
+        workers.emplace_back(project, slice);
+    for (auto &worker : workers)
+        worker.join();
+
+    // Cosine-lobe convolution per band, divided by pi so the shader gets radiance for a white surface
+    const float bandScale[3] = {1.0f, 2.0f / 3.0f, 0.25f};
+    for (int k = 0; k < 9; k++)
+    {
+        glm::vec3 sum(0.0f);
+        for (const auto &partial : partials)
+            sum += partial[k];
+        int band = k == 0 ? 0 : (k < 4 ? 1 : 2);
+        shCoefficients[k] = sum * bandScale[band];
+    }
+
+    // ===== Prefiltered specular =====
+    // Level 0 is the (clamped) source itself, rougher levels integrate a Phong lobe matched to GGX roughness
+    prefilterSize = size;
+    prefilterLevels.assign(PREFILTER_LEVELS, std::vector<float>());
+    prefilterLevels[0].resize(static_cast<size_t>(texelCount) * 3);
+    for (int i = 0; i < texelCount; i++)
+    {
+        prefilterLevels[0][i * 3 + 0] = radiance[i].x;
+        prefilterLevels[0][i * 3 + 1] = radiance[i].y;
+        prefilterLevels[0][i * 3 + 2] = radiance[i].z;
+    }
+    for (int level = 1; level < PREFILTER_LEVELS; level++)
+    {
+        int levelSize = std::max(1, size >> level);
+        float roughness = static_cast<float>(level) / (PREFILTER_LEVELS - 1);
+        float alpha = roughness * roughness;
+        float power = std::max(1.0f, 2.0f / (alpha * alpha) - 2.0f);
+
+        std::vector<float> &out = prefilterLevels[level];
+        out.assign(static_cast<size_t>(6) * levelSize * levelSize * 3, 0.0f);
+        auto filterTexels = [&](int first, int last)
+        {
+            for (int o = first; o < last; o++)
+            {
+                int face = o / (levelSize * levelSize);
+                int y = (o / levelSize) % levelSize;
+                int x = o % levelSize;
+                glm::vec3 n = texelDirection(face, x, y, levelSize);
+
+                glm::vec3 sum(0.0f);
+                float weightSum = 0.0f;
+                for (int i = 0; i < texelCount; i++)
+                {
+                    float cosine = glm::dot(n, directions[i]);
+                    if (cosine <= 0.0f)
+                        continue;
+                    float weight = std::pow(cosine, power) * solidAngles[i];
+                    sum += radiance[i] * weight;
+                    weightSum += weight;
+                }
+                if (weightSum > 0.0f)
+                    sum /= weightSum;
+                out[o * 3 + 0] = sum.x;
+                out[o * 3 + 1] = sum.y;
+                out[o * 3 + 2] = sum.z;
+            }
+        };
+        parallelFor(6 * levelSize * levelSize, threadCount, filterTexels);
+    }
+
+    float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    std::cout << "Environment lighting precomputed from " << size << "x" << size << " faces on "
+              << threadCount << " threads in " << ms << " ms" << std::endl;
+}
+
+void EnvironmentLighting::uploadPrefiltered()
+{
+    if (prefilterLevels.empty())
+        return;
+
+    if (prefilterTexture == 0)
+        glGenTextures(1, &prefilterTexture);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    for (size_t level = 0; level < prefilterLevels.size(); level++)
+    {
+        int levelSize = std::max(1, prefilterSize >> level);
+        for (int face = 0; face < 6; face++)
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, static_cast<GLint>(level), GL_R11F_G11F_B10F,
+                         levelSize, levelSize, 0, GL_RGB, GL_FLOAT,
+                         &prefilterLevels[level][static_cast<size_t>(face) * levelSize * levelSize * 3]);
+    }
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(prefilterLevels.size()) - 1);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+    // Filter across face edges, the small mips would show seams otherwise
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+}
+
+void EnvironmentLighting::bind(ShaderProgram &program, const glm::mat3 &rotation, int textureUnit) const
+{
+    // The sampler always points at its own unit so it never aliases the 2D sampler on unit 0
+    program.set("prefilteredEnvironment", textureUnit);
+    program.set("useEnvironmentLighting", ready ? 1 : 0);
+    if (!ready)
+        return;
+
+    program.set("shCoefficients", shCoefficients, 9);
+    program.set("environmentRotation", rotation);
+    program.set("environmentIntensity", ENVIRONMENT_INTENSITY);
+    program.set("prefilteredMaxLod", static_cast<float>(prefilterLevels.size() - 1));
+
+    GLState::Get().bindTexture(textureUnit, GL_TEXTURE_CUBE_MAP, prefilterTexture);
+}
+
+// ===== Cache =====
+// Layout: EnvironmentCacheHeader, 9 RGB SH coefficients, then every prefiltered level as RGB floats
+bool EnvironmentLighting::loadCache(const std::string &path, Precomputed &out)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return false;
+
+    EnvironmentCacheHeader header;
+    in.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!in || std::memcmp(header.magic, ENVIRONMENT_CACHE_MAGIC, 4) != 0 ||
+        header.version != ENVIRONMENT_CACHE_VERSION || header.prefilterSize == 0 ||
+        header.prefilterSize > 4096 || header.prefilterLevels == 0 || header.prefilterLevels > 16)
+        return false;
+
+    in.read(reinterpret_cast<char *>(out.shCoefficients), sizeof(out.shCoefficients));
+    out.prefilterSize = static_cast<int>(header.prefilterSize);
+    out.prefilterLevels.assign(header.prefilterLevels, std::vector<float>());
+    for (uint32_t level = 0; level < header.prefilterLevels; level++)
+    {
+        int levelSize = std::max(1, out.prefilterSize >> level);
+        out.prefilterLevels[level].resize(static_cast<size_t>(6) * levelSize * levelSize * 3);
+        in.read(reinterpret_cast<char *>(out.prefilterLevels[level].data()), out.prefilterLevels[level].size() * sizeof(float));
+    }
+
+    if (!in)
+    {
+        std::cerr << "Ignoring truncated environment cache: " << path << std::endl;
+        out.prefilterLevels.clear();
+        return false;
+    }
+    return true;
+}
+
+void EnvironmentLighting::saveCache(const std::string &path) const
+{
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+
+    std::string tempPath = path + ".tmp";
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        std::cerr << "Cannot write environment cache: " << path << std::endl;
+        return;
+    }
+
+    EnvironmentCacheHeader header;
+    std::memcpy(header.magic, ENVIRONMENT_CACHE_MAGIC, 4);
+    header.version = ENVIRONMENT_CACHE_VERSION;
+    header.prefilterSize = static_cast<uint32_t>(prefilterSize);
+    header.prefilterLevels = static_cast<uint32_t>(prefilterLevels.size());
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(shCoefficients), sizeof(shCoefficients));
+    for (const auto &level : prefilterLevels)
+        out.write(reinterpret_cast<const char *>(level.data()), level.size() * sizeof(float));
+    out.close();
+
+    if (!out)
+    {
+        std::cerr << "Cannot write environment cache: " << path << std::endl;
+        std::filesystem::remove(tempPath, ec);
+        return;
+    }
+    std::filesystem::rename(tempPath, path, ec);
+    if (ec)
+        std::filesystem::remove(tempPath, ec);
+}
@@ -0,0 +1,220 @@
+#include "FrustumCuller.h"
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define FRUSTUM_CULLER_SSE 1
+#endif
+
+static FrustumCuller::Stats frameStats;
+static FrustumCuller::Stats lastFrameStats;
+
+// Extent given to objects whose bounds are not known; large, but far from overflowing a dot product
+static const float UnboundedExtent = 1e30f;
+
+// ===== Bounds =====
+void TransformBox(const glm::mat4 &model, const glm::vec3 &localCenter, const glm::vec3 &localSize, glm::vec3 &min,
+                  glm::vec3 &max)
+{
+    // Each world axis gathers the absolute contribution of every local half extent
+    glm::vec3 center = glm::vec3(model * glm::vec4(localCenter, 1.0f));
+    glm::vec3 half = 0.5f * localSize;
+    glm::vec3 extent(0.0f);
+    for (int axis = 0; axis < 3; axis++)
+        extent += glm::abs(glm::vec3(model[axis])) * half[axis];
+    min = center - extent;
+    max = center + extent;
+}
+
+void CullBounds::clear()
+{
+    for (std::vector<float> *component : {&centerX, &centerY, &centerZ, &radius, &minX, &minY, &minZ, &maxX, &maxY, &maxZ})
+        component->clear();
+}
+
+void CullBounds::add(const glm::vec3 &min, const glm::vec3 &max)
+{
+    glm::vec3 center = 0.5f * (min + max);
+    centerX.push_back(center.x);
+    centerY.push_back(center.y);
+    centerZ.push_back(center.z);
+    radius.push_back(glm::length(0.5f * (max - min)));
+    minX.push_back(min.x);
+    minY.push_back(min.y);
+    minZ.push_back(min.z);
+    maxX.push_back(max.x);
+    maxY.push_back(max.y);
+    maxZ.push_back(max.z);
+}
+
+void CullBounds::add(const glm::mat4 &model, const glm::vec3 &localCenter, const glm::vec3 &localSize)
+{
+    glm::vec3 min, max;
+    TransformBox(model, localCenter, localSize, min, max);
+    add(min, max);
+}
+
+void CullBounds::addUnbounded()
+{
+    add(glm::vec3(-UnboundedExtent), glm::vec3(UnboundedExtent));
+}
+
+// ===== Frustum =====
+FrustumCuller &FrustumCuller::Get()
+{
+    static FrustumCuller instance;
+    return instance;
+}
+
+void FrustumCuller::setViewProjection(const glm::mat4 &m)
+{
+    // Rows of the matrix combined pairwise (Gribb and Hartmann): left, right, bottom, top, near, far
+    for (int i = 0; i < 6; i++)
+    {
+        int row = i / 2;
+        float sign = (i % 2 == 0) ? 1.0f : -1.0f;
+        glm::vec4 plane(m[0][3] + sign * m[0][row], m[1][3] + sign * m[1][row], m[2][3] + sign * m[2][row],
+                        m[3][3] + sign * m[3][row]);
+        float length = glm::length(glm::vec3(plane));
+        if (length > 0.0f)
+            plane /= length;
+        planeA[i] = plane.x;
+        planeB[i] = plane.y;
+        planeC[i] = plane.z;
+        planeD[i] = plane.w;
+    }
+}
+
+void FrustumCuller::test(const CullBounds &bounds, std::vector<uint8_t> &visible)
+{
+    size_t count = bounds.size();
+    visible.assign(count, 0);
+    size_t i = 0;
+
+#ifdef FRUSTUM_CULLER_SSE
+    const __m128 zero = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 cx = _mm_loadu_ps(&bounds.centerX[i]);
+        __m128 cy = _mm_loadu_ps(&bounds.centerY[i]);
+        __m128 cz = _mm_loadu_ps(&bounds.centerZ[i]);
+        __m128 r = _mm_loadu_ps(&bounds.radius[i]);
+        __m128 negativeR = _mm_sub_ps(zero, r);
+
+        // Spheres: outside when behind any plane by more than the radius, wholly
+        // inside when in front of every plane by at least the radius
+        __m128 inside = _mm_cmpeq_ps(zero, zero);
+        __m128 contained = inside;
+        for (int p = 0; p < 6; p++)
+        {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planeA[p]), cx), _mm_mul_ps(_mm_set1_ps(planeB[p]), cy)),
+                                         _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planeC[p]), cz), _mm_set1_ps(planeD[p])));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeR));
+            contained = _mm_and_ps(contained, _mm_cmpge_ps(distance, r));
+        }
+
+        // Boxes, only for spheres that straddle a plane: the corner furthest along each
+        // plane's normal has to be in front of it
+        if (_mm_movemask_ps(_mm_andnot_ps(contained, inside)) != 0)
+        {
+            for (int p = 0; p < 6; p++)
+            {
+                __m128 px = _mm_loadu_ps(planeA[p] >= 0.0f ? &bounds.maxX[i] : &bounds.minX[i]);
+                __m128 py = _mm_loadu_ps(planeB[p] >= 0.0f ? &bounds.maxY[i] : &bounds.minY[i]);
+                __m128 pz = _mm_loadu_ps(planeC[p] >= 0.0f ? &bounds.maxZ[i] : &bounds.minZ[i]);
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planeA[p]), px), _mm_mul_ps(_mm_set1_ps(planeB[p]), py)),
+                                             _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planeC[p]), pz), _mm_set1_ps(planeD[p])));
+                inside = _mm_and_ps(inside, _mm_or_ps(contained, _mm_cmpge_ps(distance, zero)));
+            }
+        }
+
+        int mask = _mm_movemask_ps(inside);
+        for (int lane = 0; lane < 4; lane++)
+            visible[i + lane] = static_cast<uint8_t>((mask >> lane) & 1);
+    }
+#endif
+
+    // Remainder, or everything without SSE: the same two tests one object at a time
+    for (; i < count; i++)
+    {
+        bool inside = true;
+        bool contained = true;
+        for (int p = 0; p < 6 && inside; p++)
+        {
+            float distance = planeA[p] * bounds.centerX[i] + planeB[p] * bounds.centerY[i] + planeC[p] * bounds.centerZ[i] + planeD[p];
+            inside = distance >= -bounds.radius[i];
+            contained = contained && distance >= bounds.radius[i];
+        }
+        for (int p = 0; p < 6 && inside && !contained; p++)
+        {
+            float px = planeA[p] >= 0.0f ? bounds.maxX[i] : bounds.minX[i];
+            float py = planeB[p] >= 0.0f ? bounds.maxY[i] : bounds.minY[i];
+            float pz = planeC[p] >= 0.0f ? bounds.maxZ[i] : bounds.minZ[i];
+            inside = planeA[p] * px + planeB[p] * py + planeC[p] * pz + planeD[p] >= 0.0f;
+        }
+        visible[i] = inside ? 1 : 0;
+    }
+
+    frameStats.submitted += count;
+    for (uint8_t flag : visible)
+        frameStats.visible += flag;
+}
+
+bool FrustumCuller::isVisible(const glm::vec3 &min, const glm::vec3 &max)
+{
+    single.clear();
+    single.add(min, max);
+    test(single, singleResult);
+    return singleResult[0] != 0;
+}
+
+bool FrustumCuller::isVisible(const glm::mat4 &model, const glm::vec3 &localCenter, const glm::vec3 &localSize)
+{
+    single.clear();
+    single.add(model, localCenter, localSize);
+    test(single, singleResult);
+    return singleResult[0] != 0;
+}
+
+FrustumCuller::Containment FrustumCuller::classify(const glm::vec3 &min, const glm::vec3 &max) const
+{
+    Containment result = Containment::Inside;
+    for (int p = 0; p < 6; p++)
+    {
+        // Corners furthest along and against the plane's normal
+        glm::vec3 positive(planeA[p] >= 0.0f ? max.x : min.x, planeB[p] >= 0.0f ? max.y : min.y, planeC[p] >= 0.0f ? max.z : min.z);
+        glm::vec3 negative(planeA[p] >= 0.0f ? min.x : max.x, planeB[p] >= 0.0f ? min.y : max.y, planeC[p] >= 0.0f ? min.z : max.z);
+        if (planeA[p] * positive.x + planeB[p] * positive.y + planeC[p] * positive.z + planeD[p] < 0.0f)
+            return Containment::Outside;
+        if (planeA[p] * negative.x + planeB[p] * negative.y + planeC[p] * negative.z + planeD[p] < 0.0f)
+            result = Containment::Partial;
+    }
+    return result;
+}
+
+bool FrustumCuller::intersectsSphere(const glm::vec3 &center, float radius) const
+{
+    for (int p = 0; p < 6; p++)
+    {
+        if (planeA[p] * center.x + planeB[p] * center.y + planeC[p] * center.z + planeD[p] < -radius)
+            return false;
+    }
+    return true;
+}
+
+// ===== Stats =====
+FrustumCuller::Stats &FrustumCuller::FrameStats()
+{
+    return frameStats;
+}
+
+const FrustumCuller::Stats &FrustumCuller::LastFrameStats()
+{
+    return lastFrameStats;
+}
+
+void FrustumCuller::EndFrame()
+{
+    lastFrameStats = frameStats;
+    frameStats = Stats();
+}
@@ -0,0 +1,172 @@
+#include "GLState.h"
+
+static GLState::Stats frameStats;
+static GLState::Stats lastFrameStats;
+
+GLState &GLState::Get()
+{
+    static GLState instance;
+    return instance;
+}
+
+GLState::GLState()
+{
+    invalidate();
+}
+
+void GLState::invalidate()
+{
+    program = -1;
+    vertexArray = -1;
+    arrayBuffer = -1;
+    activeUnit = -1;
+    for (auto &unit : textures)
+    {
+        for (long &texture : unit)
+            texture = -1;
+    }
+    depthTest = -1;
+    depthFunc = -1;
+    blend = -1;
+    blendSource = -1;
+    blendDestination = -1;
+}
+
+bool GLState::differs(long &shadowed, long value)
+{
+    if (shadowed == value)
+    {
+        frameStats.elided++;
+        return false;
+    }
+    shadowed = value;
+    frameStats.issued++;
+    return true;
+}
+
+int GLState::targetIndex(GLenum target)
+{
+    switch (target)
+    {
+    case GL_TEXTURE_2D:
+        return 0;
+    case GL_TEXTURE_2D_ARRAY:
+        return 1;
+    case GL_TEXTURE_CUBE_MAP:
+        return 2;
+    default:
+        return -1;
+    }
+}
+
+// ===== Bindings =====
+void GLState::useProgram(unsigned int id)
+{
+    if (differs(program, id))
+        glUseProgram(id);
+}
+
+void GLState::bindVertexArray(unsigned int id)
+{
+    if (differs(vertexArray, id))
+        glBindVertexArray(id);
+}
+
+void GLState::bindBuffer(GLenum target, unsigned int buffer)
+{
+    if (target != GL_ARRAY_BUFFER)
+    {
+        frameStats.issued++;
+        glBindBuffer(target, buffer);
+        return;
+    }
+    if (differs(arrayBuffer, buffer))
+        glBindBuffer(target, buffer);
+}
+
+void GLState::bindTexture(int unit, GLenum target, unsigned int texture)
+{
+    int index = targetIndex(target);
+    if (unit < 0 || unit >= MaxTextureUnits || index < 0)
+    {
+        frameStats.issued++;
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(target, texture);
+        activeUnit = unit;
+        return;
+    }
+
+    if (textures[unit][index] == static_cast<long>(texture))
+    {
+        frameStats.elided++;
+        return;
+    }
+    if (differs(activeUnit, unit))
+        glActiveTexture(GL_TEXTURE0 + unit);
+    differs(textures[unit][index], texture);
+    glBindTexture(target, texture);
+}
+
+// ===== Fixed Function =====
+void GLState::setDepthTest(bool enabled)
+{
+    if (!differs(depthTest, enabled ? 1 : 0))
+        return;
+    if (enabled)
+        glEnable(GL_DEPTH_TEST);
+    else
+        glDisable(GL_DEPTH_TEST);
+}
+
+void GLState::setDepthFunc(GLenum func)
+{
+    if (differs(depthFunc, func))
+        glDepthFunc(func);
+}
+
+void GLState::setBlend(bool enabled)
+{
+    if (!differs(blend, enabled ? 1 : 0))
+        return;
+    if (enabled)
+        glEnable(GL_BLEND);
+    else
+        glDisable(GL_BLEND);
+}
+
+void GLState::setBlendFunc(GLenum source, GLenum destination)
+{
+    if (blendSource == static_cast<long>(source) && blendDestination == static_cast<long>(destination))
+    {
+        frameStats.elided++;
+        return;
+    }
+    blendSource = source;
+    blendDestination = destination;
+    frameStats.issued++;
+    glBlendFunc(source, destination);
+}
+
+bool GLState::isDepthTestEnabled()
+{
+    if (depthTest < 0)
+        depthTest = glIsEnabled(GL_DEPTH_TEST) ? 1 : 0;
+    return depthTest == 1;
+}
+
+// ===== Stats =====
+GLState::Stats &GLState::FrameStats()
+{
+    return frameStats;
+}
+
+const GLState::Stats &GLState::LastFrameStats()
+{
+    return lastFrameStats;
+}
+
+void GLState::EndFrame()
+{
+    lastFrameStats = frameStats;
+    frameStats = Stats();
+}
@@ -0,0 +1,270 @@
+#include "GrassField.h"
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include "FrustumCuller.h"
+#include "GLState.h"
+#include "ShaderManager.h"
+#include "SoftwareOcclusion.h"
+
+static GrassField::Stats frameStats;
+static GrassField::Stats lastFrameStats;
+
+static const float ChunkSize = 5.0f;
+static const float DefaultDensity = 200.0f; // Blades per square unit
+static const float MaxBladeHeight = 0.5f;   // With the wind's lean, for the chunk boxes
+// Full density out to the first distance, none past the second
+static const float FullDensityDistance = 8.0f;
+static const float NoDensityDistance = 35.0f;
+// Blades whose rank is within 1 / RankFade of the density cut-off are shrunk, not dropped
+static const float RankFade = 8.0f;
+
+// Share of a chunk's blades drawn at distance; the vertex shader uses the same curve per blade
+static float densityAt(float distance)
+{
+    float t = std::min(std::max((distance - FullDensityDistance) / (NoDensityDistance - FullDensityDistance), 0.0f), 1.0f);
+    return 1.0f - t * t * (3.0f - 2.0f * t);
+}
+
+static uint32_t chunkSeed(uint32_t seed, int x, int z)
+{
+    uint32_t h = seed * 0x9E3779B9u ^ static_cast<uint32_t>(x) * 0x85EBCA6Bu ^ static_cast<uint32_t>(z) * 0xC2B2AE35u;
+    h ^= h >> 16;
+    h *= 0x7FEB352Du;
+    h ^= h >> 15;
+    h *= 0x846CA68Bu;
+    return h ^ (h >> 16);
+}
+
+GrassField::GrassField(const glm::vec2 &min, const glm::vec2 &max, float groundHeight, uint32_t seed)
+    : groundHeight(groundHeight)
+{
+    float density = DefaultDensity;
+    if (const char *value = std::getenv("SIMPLECATAPULT_GRASS_DENSITY"))
+        density = std::max(static_cast<float>(std::atof(value)), 0.0f);
+    bladesPerChunk = std::floor(density * ChunkSize * ChunkSize);
+    if (bladesPerChunk <= 0.0f)
+        return;
+
+    int columns = static_cast<int>(std::ceil((max.x - min.x) / ChunkSize));
+    int rows = static_cast<int>(std::ceil((max.y - min.y) / ChunkSize));
+    for (int z = 0; z < rows; z++)
+    {
+        for (int x = 0; x < columns; x++)
+            chunks.push_back({min + glm::vec2(x * ChunkSize, z * ChunkSize), chunkSeed(seed, x, z)});
+    }
+    std::cout << "Grass: " << chunks.size() << " chunks of up to " << bladesPerChunk << " blades" << std::endl;
+}
+
+GrassField::~GrassField()
+{
+    if (shader.id() != 0)
+        glDeleteProgram(shader.id());
+    if (emptyVAO != 0)
+        glDeleteVertexArrays(1, &emptyVAO);
+}
+
+bool GrassField::createResources()
+{
+    if (emptyVAO != 0)
+        return true;
+    if (failed)
+        return false;
+
+    const char *grassVertexShader = R"(
+        #version 330 core
+        uniform mat4 view;
+        uniform mat4 projection;
+        uniform vec3 viewPos;
+        uniform vec3 chunkOrigin; // Corner of the chunk on the ground
+        uniform int chunkSeed;
+        uniform float chunkSize;
+        uniform float bladesPerChunk;
+        uniform float fullDensityDistance;
+        uniform float noDensityDistance;
+        uniform float rankFade;
+        uniform float time;
+        out vec3 Normal;
+        out float BladeHeight; // 0 at the root, 1 at the tip
+        flat out vec3 Tint;
+
+        uint hash(uint x)
+        {
+            x ^= x >> 16;
+            x *= 0x7FEB352Du;
+            x ^= x >> 15;
+            x *= 0x846CA68Bu;
+            return x ^ (x >> 16);
+        }
+
+        float random(uint blade, uint salt)
+        {
+            return float(hash(uint(chunkSeed) ^ (blade * 8u + salt)) & 0xFFFFFFu) / 16777215.0;
+        }
+
+        void main()
+        {
+            uint blade = uint(gl_InstanceID);
+
+            // R2 sequence from a per-chunk start: every leading run of blades is spread evenly
+            vec2 start = vec2(random(0u, 0u), random(0u, 1u));
+            vec2 cell = fract(start + float(gl_InstanceID) * vec2(0.7548776662, 0.5698402910));
+            vec3 root = chunkOrigin + vec3(cell.x, 0.0, cell.y) * chunkSize;
+
+            // Fewer blades with distance; those just past the cut-off shrink instead of popping
+            float distance = length(root.xz - viewPos.xz);
+            float density = 1.0 - smoothstep(fullDensityDistance, noDensityDistance, distance);
+            float rank = (float(gl_InstanceID) + 0.5) / bladesPerChunk;
+            float presence = clamp((density * (1.0 + 1.0 / rankFade) - rank) * rankFade, 0.0, 1.0);
+
+            float height = mix(0.22, 0.4, random(blade, 2u)) * presence;
+            // Distant blades widen so they stay wider than a pixel
+            float width = mix(0.025, 0.04, random(blade, 3u)) * presence * (1.0 + distance / 20.0);
+            float facing = random(blade, 4u) * 6.2831853;
+            vec3 right = vec3(cos(facing), 0.0, sin(facing));
+            vec3 forward = vec3(-right.z, 0.0, right.x);
+
+            // A resting curl plus a gust that travels across the field along the wind
+            vec3 wind = normalize(vec3(1.0, 0.0, 0.4));
+            float gust = sin(time * 1.7 + dot(root.xz, wind.xz) * 0.8 + random(blade, 5u) * 2.0) * 0.5 + 0.5;
+            vec3 lean = forward * (random(blade, 6u) * 0.35) + wind * (0.1 + 0.3 * gust);
+
+            // Strip: left and right at three heights, then the tip
+            int vertex = gl_VertexID;
+            float t = float(vertex / 2) / 3.0;
+            float side = vertex == 6 ? 0.0 : (vertex % 2 == 0 ? -0.5 : 0.5);
+            vec3 position = root + right * (side * width * (1.0 - t)) + (vec3(0.0, t, 0.0) + lean * t * t) * height;
+
+            // Normal of the bent blade, turned towards the eye so both faces are lit alike
+            vec3 tangent = normalize(vec3(0.0, 1.0, 0.0) + 2.0 * lean * t);
+            vec3 normal = normalize(cross(right, tangent));
+            if (dot(normal, viewPos - position) < 0.0)
+                normal = -normal;
+
+            Normal = normal;
+            BladeHeight = t;
+            Tint = mix(vec3(0.9, 1.0, 0.8), vec3(1.1, 1.0, 0.7), random(blade, 7u));
+            gl_Position = projection * view * vec4(position, 1.0);
+        }
+    )";
+    const char *grassFragmentShader = R"(
+        #version 330 core
+        in vec3 Normal;
+        in float BladeHeight;
+        flat in vec3 Tint;
+        uniform vec3 sunDirection;
+        uniform vec3 sunColor;
+        uniform bool useEnvironmentLighting;
+        uniform vec3 shCoefficients[9];
+        uniform mat3 environmentRotation;
+        uniform float environmentIntensity;
+        out vec4 FragColor;
+
+        // As in fragment.glsl
+        vec3 evaluateSH(vec3 n)
+        {
+            return shCoefficients[0] * 0.282095
+                 + shCoefficients[1] * 0.488603 * n.y
+                 + shCoefficients[2] * 0.488603 * n.z
+                 + shCoefficients[3] * 0.488603 * n.x
+                 + shCoefficients[4] * 1.092548 * n.x * n.y
+                 + shCoefficients[5] * 1.092548 * n.y * n.z
+                 + shCoefficients[6] * 0.315392 * (3.0 * n.z * n.z - 1.0)
+                 + shCoefficients[7] * 1.092548 * n.x * n.z
+                 + shCoefficients[8] * 0.546274 * (n.x * n.x - n.y * n.y);
+        }
+
+        void main()
+        {
+            vec3 norm = normalize(Normal);
+            vec3 baseColor = mix(vec3(0.08, 0.18, 0.04), vec3(0.42, 0.58, 0.18), BladeHeight) * Tint;
+            vec3 ambient = useEnvironmentLighting
+                               ? max(evaluateSH(environmentRotation * norm), vec3(0.0)) * environmentIntensity
+                               : 0.3 * sunColor;
+            // Thin blades pass some light through, so the side away from the sun is not black
+            float diffuse = max(dot(norm, normalize(sunDirection)), 0.0) * 0.8 + 0.2;
+            // Darker near the ground, where the blades shade each other
+            float occlusion = mix(0.4, 1.0, BladeHeight);
+            FragColor = vec4((ambient + diffuse * sunColor) * baseColor * occlusion, 1.0);
+        }
+    )";
+    unsigned int program = ShaderManager::Get().createProgram("grass", grassVertexShader, grassFragmentShader);
+    if (program == 0)
+    {
+        std::cerr << "Grass disabled: the grass shader failed to build" << std::endl;
+        failed = true;
+        return false;
+    }
+    shader.attach(program);
+    chunkOriginSlot = shader.slot("chunkOrigin");
+    chunkSeedSlot = shader.slot("chunkSeed");
+
+    glGenVertexArrays(1, &emptyVAO);
+    return true;
+}
+
+void GrassField::draw(const std::function<void(ShaderProgram &program)> &frameSetup, const glm::vec3 &viewPos, float time)
+{
+    if (chunks.empty() || !createResources())
+        return;
+
+    GLState &state = GLState::Get();
+    state.useProgram(shader.id());
+    frameSetup(shader);
+    shader.set("chunkSize", ChunkSize);
+    shader.set("bladesPerChunk", bladesPerChunk);
+    shader.set("fullDensityDistance", FullDensityDistance);
+    shader.set("noDensityDistance", NoDensityDistance);
+    shader.set("rankFade", RankFade);
+    shader.set("time", time);
+    state.bindVertexArray(emptyVAO);
+    state.setDepthTest(true);
+
+    const FrustumCuller &frustum = FrustumCuller::Get();
+    SoftwareOcclusion &softwareOcclusion = SoftwareOcclusion::Get();
+    for (const Chunk &chunk : chunks)
+    {
+        // The nearest point of the chunk bounds how many of its blades are drawn
+        float nearestX = std::min(std::max(viewPos.x, chunk.min.x), chunk.min.x + ChunkSize);
+        float nearestZ = std::min(std::max(viewPos.z, chunk.min.y), chunk.min.y + ChunkSize);
+        float distance = std::sqrt((nearestX - viewPos.x) * (nearestX - viewPos.x) +
+                                   (nearestZ - viewPos.z) * (nearestZ - viewPos.z));
+        float share = std::min(densityAt(distance) * (1.0f + 1.0f / RankFade), 1.0f);
+        int blades = static_cast<int>(std::ceil(share * bladesPerChunk));
+
+        glm::vec3 boxMin(chunk.min.x - MaxBladeHeight, groundHeight, chunk.min.y - MaxBladeHeight);
+        glm::vec3 boxMax(chunk.min.x + ChunkSize + MaxBladeHeight, groundHeight + MaxBladeHeight,
+                         chunk.min.y + ChunkSize + MaxBladeHeight);
+        if (blades <= 0 || frustum.classify(boxMin, boxMax) == FrustumCuller::Containment::Outside ||
+            !softwareOcclusion.isVisible(boxMin, boxMax))
+        {
+            frameStats.chunksSkipped++;
+            continue;
+        }
+
+        shader.set(chunkOriginSlot, glm::vec3(chunk.min.x, groundHeight, chunk.min.y));
+        shader.set(chunkSeedSlot, static_cast<int>(chunk.seed));
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, VerticesPerBlade, blades);
+        frameStats.chunksDrawn++;
+        frameStats.blades += blades;
+    }
+}
+
+// ===== Stats =====
+GrassField::Stats &GrassField::FrameStats()
+{
+    return frameStats;
+}
+
+const GrassField::Stats &GrassField::LastFrameStats()
+{
+    return lastFrameStats;
+}
+
+void GrassField::EndFrame()
+{
+    lastFrameStats = frameStats;
+    frameStats = Stats();
+}
@@ -0,0 +1,339 @@
+#include "HdrDecoder.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+
+// ===== Header parsing =====
+// Reads one header line, returns false at the end of the buffer
+static bool readLine(const unsigned char *&p, const unsigned char *end, std::string &line)
+{
+    line.clear();
+    while (p < end && *p != '\n')
+        line += static_cast<char>(*p++);
+    if (p >= end)
+        return false;
+    ++p; // Skip '\n'
+    return true;
+}
+
+bool HdrDecoder::IsRadiance(const unsigned char *data, size_t size)
+{
+    return (size >= 10 && std::memcmp(data, "#?RADIANCE", 10) == 0) ||
+           (size >= 6 && std::memcmp(data, "#?RGBE", 6) == 0);
+}
+
+// Validates the header and returns the image size and the first scanline
+static bool parseHeader(const unsigned char *data, size_t size, int &width, int &height,
+                        const unsigned char *&pixels, bool verbose)
+{
+    if (!HdrDecoder::IsRadiance(data, size))
+    {
+        if (verbose)
+            std::cerr << "HDR decode: not a Radiance file" << std::endl;
+        return false;
+    }
+
+    const unsigned char *p = data;
+    const unsigned char *end = data + size;
+    std::string line;
+
+    // Header ends with an empty line
+    bool validFormat = false;
+    while (true)
+    {
+        if (!readLine(p, end, line))
+        {
+            if (verbose)
+                std::cerr << "HDR decode: truncated header" << std::endl;
+            return false;
+        }
+        if (line.empty())
+            break;
+        if (line == "FORMAT=32-bit_rle_rgbe")
+            validFormat = true;
+    }
+    if (!validFormat)
+    {
+        if (verbose)
+            std::cerr << "HDR decode: unsupported pixel format" << std::endl;
+        return false;
+    }
+
+    // Only the standard orientation is supported, same as stb_image
+    if (!readLine(p, end, line) || std::sscanf(line.c_str(), "-Y %d +X %d", &height, &width) != 2 ||
+        width <= 0 || height <= 0)
+    {
+        if (verbose)
+            std::cerr << "HDR decode: unsupported resolution line '" << line << "'" << std::endl;
+        return false;
+    }
+
+    pixels = p;
+    return true;
+}
+
+bool HdrDecoder::ReadDimensions(const unsigned char *data, size_t size, int &width, int &height)
+{
+    const unsigned char *pixels = nullptr;
+    return parseHeader(data, size, width, height, pixels, false);
+}
+
+// ===== Scanline walking =====
+// Returns the start of the next scanline without decoding pixel values, or nullptr if malformed
+static const unsigned char *skipScanline(const unsigned char *p, const unsigned char *end, int width)
+{
+    if (end - p < 4)
+        return nullptr;
+
+    bool newRle = width >= 8 && width < 0x8000 && p[0] == 2 && p[1] == 2 && !(p[2] & 0x80);
+    if (newRle)
+    {
+        if (((p[2] << 8) | p[3]) != width)
+            return nullptr;
+        p += 4;
+        for (int channel = 0; channel < 4; channel++)
+        {
+            int x = 0;
+            while (x < width)
+            {
+                if (p >= end)
+                    return nullptr;
+                int count = *p++;
+                if (count > 128)
+                {
+                    count -= 128;
+                    p += 1;
+                }
+                else
+                {
+                    p += count;
+                }
+                if (count == 0 || x + count > width || p > end)
+                    return nullptr;
+                x += count;
+            }
+        }
+        return p;
+    }
+
+    // Flat pixels, possibly with old-style (1,1,1,n) repeat runs
+    int x = 0;
+    int shift = 0;
+    while (x < width)
+    {
+        if (end - p < 4)
+            return nullptr;
+        if (p[0] == 1 && p[1] == 1 && p[2] == 1)
+        {
+            if (x == 0)
+                return nullptr;
+            x += p[3] << shift;
+            shift += 8;
+        }
+        else
+        {
+            x++;
+            shift = 0;
+        }
+        p += 4;
+    }
+    return x == width ? p : nullptr;
+}
+
+// Decodes one scanline into width RGBE quadruplets
+static bool decodeScanline(const unsigned char *p, const unsigned char *end, int width, unsigned char *rgbe)
+{
+    bool newRle = width >= 8 && width < 0x8000 && p[0] == 2 && p[1] == 2 && !(p[2] & 0x80);
+    if (newRle)
+    {
+        p += 4;
+        for (int channel = 0; channel < 4; channel++)
+        {
+            int x = 0;
+            while (x < width)
+            {
+                int count = *p++;
+                if (count > 128)
+                {
+                    count -= 128;
+                    unsigned char value = *p++;
+                    for (int i = 0; i < count; i++)
+                        rgbe[(x + i) * 4 + channel] = value;
+                }
+                else
+                {
+                    for (int i = 0; i < count; i++)
+                        rgbe[(x + i) * 4 + channel] = p[i];
+                    p += count;
+                }
+                x += count;
+            }
+        }
+        return true;
+    }
+
+    int x = 0;
+    int shift = 0;
+    while (x < width && end - p >= 4)
+    {
+        if (p[0] == 1 && p[1] == 1 && p[2] == 1)
+        {
+            int count = std::min(p[3] << shift, width - x);
+            for (int i = 0; i < count; i++, x++)
+                std::memcpy(rgbe + x * 4, rgbe + (x - 1) * 4, 4);
+            shift += 8;
+        }
+        else
+        {
+            std::memcpy(rgbe + x * 4, p, 4);
+            x++;
+            shift = 0;
+        }
+        p += 4;
+    }
+    return x == width;
+}
+
+uint16_t HdrDecoder::FloatToHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int exponent = static_cast<int>((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    if (exponent >= 31)
+        return static_cast<uint16_t>(sign | 0x7BFF); // Clamp to the largest finite half
+    if (exponent <= 0)
+    {
+        if (exponent < -10)
+            return static_cast<uint16_t>(sign);
+        mantissa |= 0x800000;
+        return static_cast<uint16_t>(sign | (mantissa >> (14 - exponent)));
+    }
+    return static_cast<uint16_t>(sign | (exponent << 10) | (mantissa >> 13));
+}
+
+// ===== Decode =====
+bool HdrDecoder::Decode(const unsigned char *data, size_t size, int maxWidth, HdrImage &image, unsigned int threadCount)
+{
+    auto startTime = std::chrono::steady_clock::now();
+
+    int srcWidth = 0, srcHeight = 0;
+    const unsigned char *p = nullptr;
+    if (!parseHeader(data, size, srcWidth, srcHeight, p, true))
+        return false;
+    const unsigned char *end = data + size;
+
+    // First pass: scanline offset table, so bands can be decoded independently
+    std::vector<const unsigned char *> rowStart(srcHeight);
+    for (int y = 0; y < srcHeight; y++)
+    {
+        rowStart[y] = p;
+        p = skipScanline(p, end, srcWidth);
+        if (!p)
+        {
+            std::cerr << "HDR decode: corrupt scanline " << y << std::endl;
+            return false;
+        }
+    }
+
+    int outWidth = std::max(1, std::min(srcWidth, maxWidth));
+    int outHeight = std::max(1, static_cast<int>(static_cast<long long>(srcHeight) * outWidth / srcWidth));
+
+    image.width = outWidth;
+    image.height = outHeight;
+    image.sourceWidth = srcWidth;
+    image.sourceHeight = srcHeight;
+    image.pixels.assign(static_cast<size_t>(outWidth) * outHeight * 3, 0);
+
+    // Box filter footprint: every source column maps to exactly one output column
+    std::vector<int> columnTarget(srcWidth);
+    std::vector<int> columnCount(outWidth, 0);
+    for (int x = 0; x < srcWidth; x++)
+    {
+        columnTarget[x] = static_cast<int>(static_cast<long long>(x) * outWidth / srcWidth);
+        columnCount[columnTarget[x]]++;
+    }
+
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    threadCount = std::min<unsigned int>(threadCount, static_cast<unsigned int>(outHeight));
+
+    std::atomic<bool> failed(false);
+    auto decodeBand = [&](int firstRow, int lastRow)
+    {
+        std::vector<unsigned char> rgbe(static_cast<size_t>(srcWidth) * 4);
+        std::vector<float> accum(static_cast<size_t>(outWidth) * 3);
+
+        for (int outY = firstRow; outY < lastRow && !failed; outY++)
+        {
+            int srcY0 = static_cast<int>(static_cast<long long>(outY) * srcHeight / outHeight);
+            int srcY1 = static_cast<int>(static_cast<long long>(outY + 1) * srcHeight / outHeight);
+            std::fill(accum.begin(), accum.end(), 0.0f);
+
+            for (int srcY = srcY0; srcY < srcY1; srcY++)
+            {
+                if (!decodeScanline(rowStart[srcY], end, srcWidth, rgbe.data()))
+                {
+                    failed = true;
+                    return;
+                }
+                for (int x = 0; x < srcWidth; x++)
+                {
+                    const unsigned char *px = &rgbe[x * 4];
+                    if (px[3] == 0)
+                        continue;
+                    float scale = std::ldexp(1.0f, px[3] - (128 + 8));
+                    float *dst = &accum[columnTarget[x] * 3];
+                    dst[0] += px[0] * scale;
+                    dst[1] += px[1] * scale;
+                    dst[2] += px[2] * scale;
+                }
+            }
+
+            // File rows run top to bottom; GL wants the bottom row first
+            uint16_t *row = &image.pixels[static_cast<size_t>(outHeight - 1 - outY) * outWidth * 3];
+            int rows = srcY1 - srcY0;
+            for (int x = 0; x < outWidth; x++)
+            {
+                float weight = 1.0f / static_cast<float>(rows * columnCount[x]);
+                row[x * 3 + 0] = FloatToHalf(accum[x * 3 + 0] * weight);
+                row[x * 3 + 1] = FloatToHalf(accum[x * 3 + 1] * weight);
+                row[x * 3 + 2] = FloatToHalf(accum[x * 3 + 2] * weight);
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    int rowsPerBand = (outHeight + threadCount - 1) / threadCount;
+    for (unsigned int t = 0; t < threadCount; t++)
+    {
+        int firstRow = static_cast<int>(t) * rowsPerBand;
+        int lastRow = std::min(outHeight, firstRow + rowsPerBand);
+        if (firstRow < lastRow)
+            workers.emplace_back(decodeBand, firstRow, lastRow);
+    }
+    for (auto &worker : workers)
+        worker.join();
+
+    if (failed)
+    {
+        std::cerr << "HDR decode: corrupt scanline data" << std::endl;
+        image.pixels.clear();
+        return false;
+    }
+
+    float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    std::cout << "HDR streamed " << srcWidth << "x" << srcHeight << " -> " << outWidth << "x" << outHeight
+              << " on " << workers.size() << " threads in " << ms << " ms ("
+              << image.pixels.size() * sizeof(uint16_t) / (1024 * 1024) << " MB output)" << std::endl;
+    return true;
+}
@@ -0,0 +1,502 @@
+#include "Impostor.h"
+#include <GL/glew.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <cmath>
+#include <iostream>
+#include "GLState.h"
+#include "Model.h"
+#include "ShaderManager.h"
+#include "TextureArrays.h"
+
+// Units clear of the 2D texture (0), the environment cube (1) and TextureArrays
+static const int ColorAtlasUnit = 3;
+static const int NormalAtlasUnit = 4;
+
+// ===== Views =====
+// Direction towards the eye of view (x, y), at the center of its cell of the hemi-octahedral grid
+static glm::vec3 frameDirection(int x, int y)
+{
+    float fx = (x + 0.5f) / Impostor::Frames * 2.0f - 1.0f;
+    float fy = (y + 0.5f) / Impostor::Frames * 2.0f - 1.0f;
+    float px = 0.5f * (fx + fy);
+    float pz = 0.5f * (fx - fy);
+    return glm::normalize(glm::vec3(px, 1.0f - std::fabs(px) - std::fabs(pz), pz));
+}
+
+// Screen axes of a view; the draw shader builds the same basis to find where a view's pixels lie
+static void frameBasis(const glm::vec3 &direction, glm::vec3 &right, glm::vec3 &up)
+{
+    right = glm::cross(glm::vec3(0.0f, 1.0f, 0.0f), direction);
+    float length = glm::length(right);
+    right = length > 1e-3f ? right / length : glm::vec3(1.0f, 0.0f, 0.0f);
+    up = glm::cross(direction, right);
+}
+
+Impostor::~Impostor()
+{
+    if (colorAtlas != 0)
+        glDeleteTextures(1, &colorAtlas);
+    if (normalAtlas != 0)
+        glDeleteTextures(1, &normalAtlas);
+    if (bakeShader.id() != 0)
+        glDeleteProgram(bakeShader.id());
+    if (drawShader.id() != 0)
+        glDeleteProgram(drawShader.id());
+    if (quadVAO != 0)
+        glDeleteVertexArrays(1, &quadVAO);
+    if (quadVBO != 0)
+        glDeleteBuffers(1, &quadVBO);
+    if (instanceVBO != 0)
+        glDeleteBuffers(1, &instanceVBO);
+}
+
+// ===== Bake =====
+bool Impostor::createBakeShader()
+{
+    if (bakeShader.id() != 0)
+        return true;
+
+    const char *bakeVertexShader = R"(
+        #version 330 core
+        layout (location = 0) in vec3 aPos;
+        layout (location = 1) in vec3 aNormal;
+        layout (location = 2) in vec2 aTexCoord;
+        layout (location = 5) in float aLayer;
+        uniform mat4 viewProjection;
+        out vec3 Normal;
+        out vec2 TexCoord;
+        flat out float TexLayer;
+        void main()
+        {
+            Normal = aNormal;
+            TexCoord = aTexCoord;
+            TexLayer = aLayer;
+            gl_Position = viewProjection * vec4(aPos, 1.0);
+        }
+    )";
+    const char *bakeFragmentShader = R"(
+        #version 330 core
+        in vec3 Normal;
+        in vec2 TexCoord;
+        flat in float TexLayer;
+        uniform int textureMode; // 0 colour, 1 texture_diffuse1, 2 texture_array
+        uniform vec3 objectColor;
+        uniform sampler2D texture_diffuse1;
+        uniform sampler2DArray texture_array;
+        layout (location = 0) out vec4 Albedo;
+        layout (location = 1) out vec4 ModelNormal;
+        void main()
+        {
+            vec3 color = objectColor;
+            if (textureMode == 1)
+                color = texture(texture_diffuse1, TexCoord).rgb;
+            else if (textureMode == 2)
+                color = texture(texture_array, vec3(TexCoord, TexLayer)).rgb;
+            // Leaves are single sheets; light whichever side is seen
+            vec3 normal = normalize(gl_FrontFacing ? Normal : -Normal);
+            Albedo = vec4(color, 1.0);
+            ModelNormal = vec4(normal * 0.5 + 0.5, 1.0);
+        }
+    )";
+    unsigned int program = ShaderManager::Get().createProgram("impostor_bake", bakeVertexShader, bakeFragmentShader);
+    if (program == 0)
+    {
+        std::cerr << "Impostor bake shader failed to build" << std::endl;
+        return false;
+    }
+    bakeShader.attach(program);
+    return true;
+}
+
+bool Impostor::bake(const Model &model, const glm::vec3 &color)
+{
+    if (isBaked() || failed)
+        return isBaked();
+    localCenter = model.getCenter();
+    localRadius = 0.5f * glm::length(model.getSize());
+    if (localRadius <= 0.0f || !createBakeShader())
+    {
+        failed = true;
+        return false;
+    }
+
+    GLint previousViewport[4];
+    GLint previousFramebuffer = 0;
+    GLfloat previousClearColor[4];
+    glGetIntegerv(GL_VIEWPORT, previousViewport);
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, previousClearColor);
+
+    // Colour is cleared to transparent black, so filtered texels at a silhouette come out
+    // premultiplied by their coverage; the normal atlas is stored the same way
+    const int atlasSize = Frames * FrameSize;
+    int maxLevel = 0;
+    while ((FrameSize >> (maxLevel + 1)) >= 4)
+        maxLevel++; // Stops while a view still spans a few texels, before mips bleed across views
+    unsigned int atlases[2];
+    glGenTextures(2, atlases);
+    for (unsigned int atlas : atlases)
+    {
+        glBindTexture(GL_TEXTURE_2D, atlas);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, atlasSize, atlasSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, maxLevel);
+    }
+
+    unsigned int captureFBO, captureRBO;
+    glGenFramebuffers(1, &captureFBO);
+    glGenRenderbuffers(1, &captureRBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, atlasSize, atlasSize);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, captureRBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, atlases[0], 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, atlases[1], 0);
+    const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    glDrawBuffers(2, drawBuffers);
+
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    if (complete)
+    {
+        glViewport(0, 0, atlasSize, atlasSize);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_LESS);
+
+        glUseProgram(bakeShader.id());
+        bakeShader.set("objectColor", color);
+        bakeShader.set("texture_diffuse1", 0);
+        bakeShader.set(bakeShader.slot("texture_array"), TextureArrays::TextureUnit);
+        int viewProjectionSlot = bakeShader.slot("viewProjection");
+        int textureModeSlot = bakeShader.slot("textureMode");
+
+        // Orthographic views of the bounding sphere, from outside it towards its center
+        glm::mat4 projection = glm::ortho(-localRadius, localRadius, -localRadius, localRadius, localRadius,
+                                          3.0f * localRadius);
+        for (int y = 0; y < Frames; y++)
+        {
+            for (int x = 0; x < Frames; x++)
+            {
+                glm::vec3 direction = frameDirection(x, y);
+                glm::vec3 right, up;
+                frameBasis(direction, right, up);
+                glm::mat4 view = glm::lookAt(localCenter + 2.0f * localRadius * direction, localCenter, up);
+                bakeShader.set(viewProjectionSlot, projection * view);
+                glViewport(x * FrameSize, y * FrameSize, FrameSize, FrameSize);
+
+                for (const Mesh &mesh : model.getMeshes())
+                {
+                    // As Mesh::Draw(): the first diffuse texture, 2D or a layer of an array
+                    int textureMode = 0;
+                    for (const Texture &texture : mesh.textures)
+                    {
+                        if (texture.type != "texture_diffuse")
+                            continue;
+                        if (texture.layer >= 0)
+                        {
+                            glActiveTexture(GL_TEXTURE0 + TextureArrays::TextureUnit);
+                            glBindTexture(GL_TEXTURE_2D_ARRAY, texture.id);
+                            textureMode = 2;
+                        }
+                        else
+                        {
+                            glActiveTexture(GL_TEXTURE0);
+                            glBindTexture(GL_TEXTURE_2D, texture.id);
+                            textureMode = 1;
+                        }
+                        break;
+                    }
+                    bakeShader.set(textureModeSlot, textureMode);
+                    glBindVertexArray(mesh.VAO);
+                    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(mesh.indices.size()), GL_UNSIGNED_INT, 0);
+                }
+            }
+        }
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+    }
+    else
+    {
+        std::cerr << "Impostor atlas framebuffer incomplete" << std::endl;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+    glDeleteFramebuffers(1, &captureFBO);
+    glDeleteRenderbuffers(1, &captureRBO);
+    glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+    glClearColor(previousClearColor[0], previousClearColor[1], previousClearColor[2], previousClearColor[3]);
+
+    if (!complete)
+    {
+        glDeleteTextures(2, atlases);
+        failed = true;
+        GLState::Get().invalidate();
+        return false;
+    }
+    for (unsigned int atlas : atlases)
+    {
+        glBindTexture(GL_TEXTURE_2D, atlas);
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+    colorAtlas = atlases[0];
+    normalAtlas = atlases[1];
+
+    // Baked mid-frame, behind the state cache's back
+    GLState::Get().invalidate();
+    std::cout << "Baked impostor: " << Frames * Frames << " views into " << atlasSize << "x" << atlasSize
+              << " atlases" << std::endl;
+    return true;
+}
+
+// ===== Draw =====
+void Impostor::addInstance(const glm::mat4 &modelMatrix, float fade)
+{
+    // The model's x axis gives its rotation about Y and its length the scale
+    glm::vec3 axis(modelMatrix[0]);
+    float scale = glm::length(axis);
+    if (scale <= 0.0f)
+        return;
+    glm::vec3 center(modelMatrix * glm::vec4(localCenter, 1.0f));
+    instances.push_back(glm::vec4(center, localRadius * scale));
+    instances.push_back(glm::vec4(axis.x / scale, axis.z / scale, fade, 0.0f));
+}
+
+bool Impostor::createDrawResources()
+{
+    if (quadVAO != 0)
+        return true;
+    if (failed)
+        return false;
+
+    const char *drawVertexShader = R"(
+        #version 330 core
+        layout (location = 0) in vec2 aCorner;
+        layout (location = 1) in vec4 aCenterRadius; // Per instance, world space
+        layout (location = 2) in vec4 aAxisFade;     // Model x axis in xz, then fade
+        uniform mat4 view;
+        uniform mat4 projection;
+        uniform vec3 viewPos;
+        uniform float frames;
+        out vec3 FragPos;
+        out vec2 FrameUV[4];
+        flat out vec4 FrameWeights;
+        flat out vec4 FrameCells01;
+        flat out vec4 FrameCells23;
+        flat out vec2 Axis;
+        flat out float Fade;
+
+        vec3 toModel(vec3 v, vec2 axis)
+        {
+            return vec3(axis.x * v.x + axis.y * v.z, v.y, -axis.y * v.x + axis.x * v.z);
+        }
+
+        // Same as frameBasis() in Impostor.cpp
+        void frameBasis(vec3 direction, out vec3 right, out vec3 up)
+        {
+            right = cross(vec3(0.0, 1.0, 0.0), direction);
+            float len = length(right);
+            right = len > 1e-3 ? right / len : vec3(1.0, 0.0, 0.0);
+            up = cross(direction, right);
+        }
+
+        vec3 frameDirection(vec2 cell)
+        {
+            vec2 f = (cell + 0.5) / frames * 2.0 - 1.0;
+            vec2 p = vec2(f.x + f.y, f.x - f.y) * 0.5;
+            return normalize(vec3(p.x, 1.0 - abs(p.x) - abs(p.y), p.y));
+        }
+
+        void main()
+        {
+            vec3 center = aCenterRadius.xyz;
+            float radius = aCenterRadius.w;
+            vec3 toEye = normalize(viewPos - center);
+            vec3 right, up;
+            frameBasis(toEye, right, up);
+            vec3 offset = (right * aCorner.x + up * aCorner.y) * radius;
+            FragPos = center + offset;
+            gl_Position = projection * view * vec4(FragPos, 1.0);
+
+            // The eye in model space, kept to the baked hemisphere, on the octahedral grid
+            vec3 eye = toModel(toEye, aAxisFade.xy);
+            eye.y = max(eye.y, 0.0);
+            eye /= abs(eye.x) + eye.y + abs(eye.z) + 1e-6;
+            vec2 grid = (vec2(eye.x + eye.z, eye.x - eye.z) * 0.5 + 0.5) * frames - 0.5;
+            vec2 base = floor(grid);
+            vec2 t = grid - base;
+            FrameWeights = vec4((1.0 - t.x) * (1.0 - t.y), t.x * (1.0 - t.y), (1.0 - t.x) * t.y, t.x * t.y);
+
+            // Where this corner lands in each of the four views: projected along the view's direction
+            vec2 cells[4] = vec2[4](base, base + vec2(1.0, 0.0), base + vec2(0.0, 1.0), base + vec2(1.0, 1.0));
+            vec3 local = toModel(offset, aAxisFade.xy) / radius;
+            for (int i = 0; i < 4; i++)
+            {
+                cells[i] = clamp(cells[i], vec2(0.0), vec2(frames - 1.0));
+                vec3 frameRight, frameUp;
+                frameBasis(frameDirection(cells[i]), frameRight, frameUp);
+                FrameUV[i] = vec2(dot(local, frameRight), dot(local, frameUp)) * 0.5 + 0.5;
+            }
+            FrameCells01 = vec4(cells[0], cells[1]);
+            FrameCells23 = vec4(cells[2], cells[3]);
+            Axis = aAxisFade.xy;
+            Fade = aAxisFade.z;
+        }
+    )";
+    const char *drawFragmentShader = R"(
+        #version 330 core
+        in vec3 FragPos;
+        in vec2 FrameUV[4];
+        flat in vec4 FrameWeights;
+        flat in vec4 FrameCells01;
+        flat in vec4 FrameCells23;
+        flat in vec2 Axis;
+        flat in float Fade;
+        uniform sampler2D colorAtlas;
+        uniform sampler2D normalAtlas;
+        uniform float frames;
+        uniform vec3 sunDirection;
+        uniform vec3 sunColor;
+        uniform vec3 viewPos;
+        uniform vec3 sunPos;
+        uniform bool useEnvironmentLighting;
+        uniform vec3 shCoefficients[9];
+        uniform mat3 environmentRotation;
+        uniform float environmentIntensity;
+        uniform samplerCube prefilteredEnvironment;
+        uniform float prefilteredMaxLod;
+        out vec4 FragColor;
+
+        // As in fragment.glsl
+        vec3 evaluateSH(vec3 n)
+        {
+            return shCoefficients[0] * 0.282095
+                 + shCoefficients[1] * 0.488603 * n.y
+                 + shCoefficients[2] * 0.488603 * n.z
+                 + shCoefficients[3] * 0.488603 * n.x
+                 + shCoefficients[4] * 1.092548 * n.x * n.y
+                 + shCoefficients[5] * 1.092548 * n.y * n.z
+                 + shCoefficients[6] * 0.315392 * (3.0 * n.z * n.z - 1.0)
+                 + shCoefficients[7] * 1.092548 * n.x * n.z
+                 + shCoefficients[8] * 0.546274 * (n.x * n.x - n.y * n.y);
+        }
+
+        // Ordered 4x4 threshold, so a fading impostor covers a growing share of its pixels
+        float bayer4(vec2 pixel)
+        {
+            const float thresholds[16] = float[16](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0,
+                                                   3.0, 11.0, 1.0, 9.0, 15.0, 7.0, 13.0, 5.0);
+            ivec2 p = ivec2(mod(pixel, 4.0));
+            return (thresholds[p.x + 4 * p.y] + 0.5) / 16.0;
+        }
+
+        void main()
+        {
+            if (Fade <= bayer4(gl_FragCoord.xy))
+                discard;
+
+            vec2 cells[4] = vec2[4](FrameCells01.xy, FrameCells01.zw, FrameCells23.xy, FrameCells23.zw);
+            vec4 color = vec4(0.0);
+            vec3 normal = vec3(0.0);
+            for (int i = 0; i < 4; i++)
+            {
+                vec2 uv = FrameUV[i];
+                if (FrameWeights[i] <= 0.0 || uv.x < 0.0 || uv.y < 0.0 || uv.x > 1.0 || uv.y > 1.0)
+                    continue;
+                vec2 atlasUV = (cells[i] + uv) / frames;
+                vec4 normalSample = texture(normalAtlas, atlasUV);
+                color += texture(colorAtlas, atlasUV) * FrameWeights[i];
+                normal += (normalSample.rgb * 2.0 - normalSample.a) * FrameWeights[i];
+            }
+            if (color.a < 0.5)
+                discard;
+
+            vec3 baseColor = color.rgb / color.a;
+            vec3 local = length(normal) > 1e-4 ? normalize(normal) : vec3(0.0, 1.0, 0.0);
+            vec3 norm = vec3(Axis.x * local.x - Axis.y * local.z, local.y, Axis.y * local.x + Axis.x * local.z);
+
+            // Every term of fragment.glsl, so the mesh and its impostor match across the cross-fade
+            vec3 lightDir = normalize(sunDirection);
+            vec3 viewDir = normalize(viewPos - FragPos);
+            vec3 ambient = 0.3 * sunColor;
+            vec3 environmentSpecular = vec3(0.0);
+            if (useEnvironmentLighting)
+            {
+                ambient = max(evaluateSH(environmentRotation * norm), vec3(0.0)) * environmentIntensity;
+                vec3 reflected = environmentRotation * reflect(-viewDir, norm);
+                float fresnel = 0.04 + 0.96 * pow(1.0 - max(dot(norm, viewDir), 0.0), 5.0);
+                environmentSpecular = textureLod(prefilteredEnvironment, reflected, prefilteredMaxLod * 0.6).rgb
+                                    * fresnel * environmentIntensity;
+            }
+            vec3 diffuse = max(dot(norm, lightDir), 0.0) * sunColor;
+            vec3 specular = 0.5 * pow(max(dot(viewDir, reflect(-lightDir, norm)), 0.0), 32.0) * sunColor;
+
+            vec3 sunLightDir = normalize(sunPos - FragPos);
+            float distanceToSun = length(sunPos - FragPos);
+            float attenuation = 1.0 / (1.0 + 0.09 * distanceToSun + 0.032 * distanceToSun * distanceToSun);
+            vec3 pointDiffuse = max(dot(norm, sunLightDir), 0.0) * sunColor * attenuation * 2.0;
+            vec3 pointSpecular = pow(max(dot(viewDir, reflect(-sunLightDir, norm)), 0.0), 32.0) * sunColor * attenuation;
+
+            vec3 result = (ambient + diffuse + specular + pointDiffuse + pointSpecular) * baseColor + environmentSpecular;
+            FragColor = vec4(result, 1.0);
+        }
+    )";
+    unsigned int program = ShaderManager::Get().createProgram("impostor", drawVertexShader, drawFragmentShader);
+    if (program == 0)
+    {
+        std::cerr << "Impostors disabled: the impostor shader failed to build" << std::endl;
+        failed = true;
+        return false;
+    }
+    drawShader.attach(program);
+
+    const float corners[] = {-1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f};
+    glGenVertexArrays(1, &quadVAO);
+    glGenBuffers(1, &quadVBO);
+    glGenBuffers(1, &instanceVBO);
+    glBindVertexArray(quadVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void *)0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    for (int attribute = 1; attribute <= 2; attribute++)
+    {
+        glEnableVertexAttribArray(attribute);
+        glVertexAttribPointer(attribute, 4, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec4),
+                              (void *)((attribute - 1) * sizeof(glm::vec4)));
+        glVertexAttribDivisor(attribute, 1);
+    }
+    glBindVertexArray(0);
+
+    // Created mid-frame, behind the state cache's back
+    GLState::Get().invalidate();
+    return true;
+}
+
+void Impostor::draw(const std::function<void(ShaderProgram &program)> &frameSetup)
+{
+    if (!isBaked() || instances.empty() || !createDrawResources())
+        return;
+
+    GLState &state = GLState::Get();
+    state.useProgram(drawShader.id());
+    frameSetup(drawShader);
+    drawShader.set("frames", static_cast<float>(Frames));
+    drawShader.set(drawShader.slot("colorAtlas"), ColorAtlasUnit);
+    drawShader.set(drawShader.slot("normalAtlas"), NormalAtlasUnit);
+    state.bindTexture(ColorAtlasUnit, GL_TEXTURE_2D, colorAtlas);
+    state.bindTexture(NormalAtlasUnit, GL_TEXTURE_2D, normalAtlas);
+
+    // Rewritten whole every frame, so the old contents are orphaned rather than waited on
+    state.bindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(glm::vec4), instances.data(), GL_STREAM_DRAW);
+
+    state.bindVertexArray(quadVAO);
+    state.setDepthTest(true);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(instanceCount()));
+}
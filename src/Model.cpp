@@ -5,20 +5,37 @@
 #include <limits>
 #include <cstring>
 #include <cstddef>
+#include <cmath>
+#include <chrono>
+#include <glm/gtc/constants.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtc/type_ptr.hpp>
-#include <algorithm>
 #include "../third_party/stb_image.h"
+#include "ImageRows.h"
 #include "PathUtils.h"
+#include "AssetIOSystem.h"
+#include "AssetStreamer.h"
+#include "FrustumCuller.h"
+#include "GLState.h"
+#include "RenderQueue.h"
+#include "ShaderPermutations.h"
+#include "TextureArrays.h"
+#include "TextureResidency.h"
+#include <future>
 
 // Static member initialization for shared texture cache
 std::vector<Texture> Model::textures_loaded;
+std::mutex Model::texturesMutex;
+
+const unsigned int Model::ModelImportFlags = aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace | aiProcess_GenNormals | aiProcess_LimitBoneWeights;
+const unsigned int Model::AnimationImportFlags = aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_LimitBoneWeights;
 
 // Mesh implementation
-Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures)
-    : vertices(vertices), indices(indices), textures(textures)
+Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures, bool upload)
+    : vertices(vertices), indices(indices), textures(textures), VAO(0), VBO(0), EBO(0)
 {
-    setupMesh();
+    if (upload)
+        setupMesh();
 }
 
 void Mesh::setupMesh()
@@ -49,94 +66,502 @@ void Mesh::setupMesh()
     // Bone weights
     glEnableVertexAttribArray(4);
     glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, Weights));
+    // Texture array layer
+    glEnableVertexAttribArray(5);
+    glVertexAttribPointer(5, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, Layer));
 
     glBindVertexArray(0);
 }
 
-void Mesh::Draw(unsigned int shaderProgram)
+void Mesh::Draw(DrawPacket object)
 {
     // Only load diffuse textures (shader only uses texture_diffuse1)
-    bool hasTextures = false;
     for (unsigned int i = 0; i < textures.size(); i++)
     {
         if (textures[i].type == "texture_diffuse")
         {
-            glActiveTexture(GL_TEXTURE0);
-            glUniform1i(glGetUniformLocation(shaderProgram, "texture_diffuse1"), 0);
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
-            hasTextures = true;
+            if (textures[i].layer >= 0)
+            {
+                // The layer comes from the vertices, so one binding covers every material in the array
+                object.arrayTexture = textures[i].id;
+                object.features |= SHADER_TEXTURE_ARRAY;
+            }
+            else
+            {
+                object.texture = textures[i].id;
+                object.features |= SHADER_TEXTURED;
+            }
             break; // Only use first diffuse texture
         }
     }
 
-    // Set useTexture uniform
-    glUniform1i(glGetUniformLocation(shaderProgram, "useTexture"), hasTextures ? 1 : 0);
+    object.vertexArray = VAO;
+    object.indexed = true;
+    if (object.count == 0)
+    {
+        object.first = 0;
+        object.count = static_cast<int>(indices.size());
+    }
+    RenderQueue::Get().submit(object);
+}
 
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+void Mesh::buildMeshlets()
+{
+    // Fewer triangles than a few meshlets would cost more to cull than to draw
+    size_t triangleCount = indices.size() / 3;
+    meshlets.clear();
+    if (triangleCount < 4 * MeshletMaxTriangles)
+        return;
+
+    // Triangles sorted along a Morton curve of their centroids end up next to their neighbours
+    std::vector<glm::vec3> centroids(triangleCount);
+    glm::vec3 low(std::numeric_limits<float>::max()), high(-std::numeric_limits<float>::max());
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        const glm::vec3 &a = vertices[indices[3 * t]].Position;
+        const glm::vec3 &b = vertices[indices[3 * t + 1]].Position;
+        const glm::vec3 &c = vertices[indices[3 * t + 2]].Position;
+        centroids[t] = (a + b + c) / 3.0f;
+        low = glm::min(low, centroids[t]);
+        high = glm::max(high, centroids[t]);
+    }
+    auto spread = [](uint32_t v)
+    {
+        v = (v | (v << 16)) & 0x030000FF;
+        v = (v | (v << 8)) & 0x0300F00F;
+        v = (v | (v << 4)) & 0x030C30C3;
+        return (v | (v << 2)) & 0x09249249;
+    };
+    glm::vec3 extent = glm::max(high - low, glm::vec3(1e-6f));
+    std::vector<std::pair<uint32_t, uint32_t>> order(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        glm::vec3 cell = (centroids[t] - low) / extent * 1023.0f;
+        uint32_t code = spread(static_cast<uint32_t>(cell.x)) | (spread(static_cast<uint32_t>(cell.y)) << 1) |
+                        (spread(static_cast<uint32_t>(cell.z)) << 2);
+        order[t] = {code, static_cast<uint32_t>(t)};
+    }
+    std::sort(order.begin(), order.end());
+
+    std::vector<unsigned int> reordered;
+    reordered.reserve(indices.size());
+    std::vector<uint32_t> members;
+    auto close = [&]()
+    {
+        Meshlet meshlet;
+        meshlet.firstIndex = static_cast<unsigned int>(reordered.size());
+        meshlet.indexCount = static_cast<unsigned int>(members.size() * 3);
+        glm::vec3 boxMin(std::numeric_limits<float>::max()), boxMax(-std::numeric_limits<float>::max());
+        for (uint32_t t : members)
+        {
+            for (int corner = 0; corner < 3; corner++)
+            {
+                reordered.push_back(indices[3 * t + corner]);
+                boxMin = glm::min(boxMin, vertices[indices[3 * t + corner]].Position);
+                boxMax = glm::max(boxMax, vertices[indices[3 * t + corner]].Position);
+            }
+        }
+        meshlet.center = 0.5f * (boxMin + boxMax);
+        meshlet.radius = 0.0f;
+        for (uint32_t t : members)
+        {
+            for (int corner = 0; corner < 3; corner++)
+                meshlet.radius = std::max(meshlet.radius, glm::length(vertices[indices[3 * t + corner]].Position - meshlet.center));
+        }
+        meshlets.push_back(meshlet);
+        members.clear();
+    };
 
-    // Reset texture binding after drawing
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    for (const auto &entry : order)
+    {
+        if (members.size() >= MeshletMaxTriangles)
+            close();
+        members.push_back(entry.second);
+    }
+    if (!members.empty())
+        close();
+    indices.swap(reordered);
 }
 
 // Model implementation
-Model::Model(const std::string &path)
-    : importer(new Assimp::Importer()), scene(nullptr),
-      numBones(0), globalInverseTransform(glm::mat4(1.0f)),
-      animationScene(nullptr), animationImporter(nullptr),
+Model::Model(const std::string &path, bool streamed)
+    : modelSize(1.0f), modelCenter(0.0f), resident(false), boundsKnown(false), proxyShape(ProxyShape::Box),
+      instanceVBO(0), instanceCount(0), instanceCapacity(0), numBones(0), globalInverseTransform(glm::mat4(1.0f)),
+      animationScene(nullptr),
       animationTime(0.0f), hasAnimation(false)
 {
-    loadModel(path);
+    if (!streamed || !AssetStreamer::Get().isRunning())
+    {
+        loadModel(path);
+        return;
+    }
+
+    // Import on a worker. The first GL step only takes the bounds and builds a proxy, so
+    // something of the right size is on screen a frame before the meshes are uploaded
+    streamHandle = std::make_shared<Model *>(this);
+    std::shared_ptr<Model *> handle = streamHandle;
+    auto imported = std::make_shared<std::shared_ptr<const ImportedScene>>();
+    AssetStreamer::Get().submit(
+        [path, imported]() -> size_t
+        {
+            *imported = ImportScene(path, ModelImportFlags);
+            return 0;
+        },
+        [handle, path, imported]()
+        {
+            const aiScene *scene = (*imported)->scene;
+            if (!*handle || !scene || !scene->mRootNode)
+            {
+                if (*handle)
+                    (*handle)->finishLoad(*imported, path);
+                return;
+            }
+            (*handle)->calculateBounds(scene);
+            (*handle)->buildProxy();
+
+            AssetStreamer::Get().submit(
+                [imported]() -> size_t
+                {
+                    size_t bytes = 0;
+                    const aiScene *scene = (*imported)->scene;
+                    for (unsigned int i = 0; i < scene->mNumMeshes; i++)
+                        bytes += scene->mMeshes[i]->mNumVertices * sizeof(Vertex) + scene->mMeshes[i]->mNumFaces * 3 * sizeof(unsigned int);
+                    return bytes;
+                },
+                [handle, path, imported]()
+                {
+                    if (*handle)
+                        (*handle)->finishLoad(*imported, path);
+                });
+        });
 }
 
 Model::~Model()
 {
-    delete importer;
-    if (animationImporter)
-        delete animationImporter;
+    if (streamHandle)
+        *streamHandle = nullptr;
+    if (instanceVBO != 0)
+        glDeleteBuffers(1, &instanceVBO);
 }
 
-void Model::Draw(unsigned int shaderProgram)
+void Model::Draw(const glm::mat4 &modelMatrix, const glm::vec3 &color, unsigned int occlusionQuery, float impostorFade)
 {
-    // Set bone matrices if animation is active
-    if (hasAnimation && animationScene && animationScene->HasAnimations())
+    DrawPacket object;
+    object.model = modelMatrix;
+    object.color = color;
+    object.occlusionQuery = occlusionQuery;
+    if (impostorFade > 0.0f)
     {
-        glUniform1i(glGetUniformLocation(shaderProgram, "useAnimation"), 1);
+        object.features |= SHADER_DITHER_FADE;
+        object.impostorFade = impostorFade;
+    }
+    if (!resident)
+    {
+        // The proxy is unskinned, whatever clip is already playing
+        if (proxy)
+            proxy->Draw(object);
+        return;
+    }
 
+    // Set bone matrices if animation is active; every mesh of this instance shares one copy
+    if (hasAnimation && animationScene && animationScene->HasAnimations())
+    {
         glm::mat4 boneMatrices[100];
         for (unsigned int i = 0; i < boneInfo.size() && i < 100; i++)
         {
             boneMatrices[i] = boneInfo[i].finalTransformation;
         }
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "gBones"), boneInfo.size(), GL_FALSE, glm::value_ptr(boneMatrices[0]));
+        object.bonesCount = static_cast<int>(std::min<size_t>(boneInfo.size(), 100));
+        object.bonesOffset = RenderQueue::Get().addBones(boneMatrices, object.bonesCount);
+        object.features |= SHADER_SKINNED;
     }
-    else
+
+    for (unsigned int i = 0; i < meshes.size(); i++)
+        meshes[i].Draw(object);
+}
+
+// ===== Instancing =====
+void Model::setInstances(const std::vector<glm::mat4> &modelMatrices)
+{
+    instanceCount = static_cast<int>(modelMatrices.size());
+    if (instanceCount == 0 || modelMatrices == instanceMatrices)
+        return;
+    instanceMatrices = modelMatrices;
+    GLsizeiptr bytes = modelMatrices.size() * sizeof(glm::mat4);
+
+    if (instanceVBO == 0)
+    {
+        glGenBuffers(1, &instanceVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, bytes, modelMatrices.data(), GL_DYNAMIC_DRAW);
+        instanceCapacity = instanceCount;
+        for (Mesh &mesh : meshes)
+            attachInstances(mesh);
+        if (proxy)
+            attachInstances(*proxy);
+
+        // This can run mid-frame, behind the state cache's back
+        GLState::Get().invalidate();
+        return;
+    }
+
+    // Called per frame with the visible instances. The buffer only grows, and is orphaned
+    // first so the write does not wait for last frame's draws to finish reading it.
+    GLState::Get().bindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    instanceCapacity = std::max(instanceCapacity, instanceCount);
+    glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, modelMatrices.data());
+}
+
+void Model::attachInstances(Mesh &mesh) const
+{
+    if (instanceVBO == 0 || mesh.VAO == 0)
+        return;
+
+    // A mat4 attribute takes four locations, one column each, advanced per instance
+    glBindVertexArray(mesh.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    for (int column = 0; column < 4; column++)
     {
-        glUniform1i(glGetUniformLocation(shaderProgram, "useAnimation"), 0);
+        GLuint location = 6 + column;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                              (void *)(column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location, 1);
     }
+    glBindVertexArray(0);
+}
 
+void Model::DrawInstanced(const glm::vec3 &color)
+{
+    if (instanceCount == 0)
+        return;
+
+    DrawPacket object;
+    object.color = color;
+    object.features = SHADER_INSTANCED;
+    object.instances = instanceCount;
+    if (!resident)
+    {
+        if (proxy)
+            proxy->Draw(object);
+        return;
+    }
     for (unsigned int i = 0; i < meshes.size(); i++)
-        meshes[i].Draw(shaderProgram);
+        meshes[i].Draw(object);
+}
+
+// ===== Meshlet culling =====
+static Model::MeshletStats meshletStats;
+static Model::MeshletStats lastMeshletStats;
+
+void Model::DrawMeshlets(const glm::mat4 &modelMatrix, const glm::vec3 &color)
+{
+    if (!resident)
+    {
+        Draw(modelMatrix, color);
+        return;
+    }
+
+    DrawPacket object;
+    object.model = modelMatrix;
+    object.color = color;
+    FrustumCuller &frustum = FrustumCuller::Get();
+    glm::mat3 rotation(modelMatrix);
+    float scale = std::max(glm::length(rotation[0]), std::max(glm::length(rotation[1]), glm::length(rotation[2])));
+
+    static std::vector<unsigned int> firstIndices;
+    static std::vector<int> counts;
+    for (Mesh &mesh : meshes)
+    {
+        if (mesh.meshlets.empty())
+        {
+            mesh.Draw(object);
+            continue;
+        }
+
+        firstIndices.clear();
+        counts.clear();
+        int visibleIndices = 0;
+        for (const Meshlet &meshlet : mesh.meshlets)
+        {
+            meshletStats.tested++;
+            glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(meshlet.center, 1.0f));
+            float radius = meshlet.radius * scale;
+            if (!frustum.intersectsSphere(center, radius))
+            {
+                meshletStats.frustumCulled++;
+                meshletStats.trianglesCulled += meshlet.indexCount / 3;
+                continue;
+            }
+
+            // Neighbouring survivors are contiguous in the index buffer and share one range
+            if (!counts.empty() && firstIndices.back() + counts.back() == meshlet.firstIndex)
+            {
+                counts.back() += meshlet.indexCount;
+            }
+            else
+            {
+                firstIndices.push_back(meshlet.firstIndex);
+                counts.push_back(static_cast<int>(meshlet.indexCount));
+            }
+            visibleIndices += meshlet.indexCount;
+        }
+        if (visibleIndices == 0)
+            continue;
+
+        DrawPacket meshObject = object;
+        meshObject.first = static_cast<int>(firstIndices[0]);
+        meshObject.count = visibleIndices;
+        if (counts.size() > 1)
+        {
+            meshObject.rangesOffset = RenderQueue::Get().addRanges(firstIndices.data(), counts.data(), counts.size());
+            meshObject.rangesCount = static_cast<int>(counts.size());
+        }
+        mesh.Draw(meshObject);
+    }
+}
+
+Model::MeshletStats &Model::FrameMeshletStats()
+{
+    return meshletStats;
+}
+
+const Model::MeshletStats &Model::LastFrameMeshletStats()
+{
+    return lastMeshletStats;
+}
+
+void Model::EndFrame()
+{
+    lastMeshletStats = meshletStats;
+    meshletStats = MeshletStats();
+}
+
+void Model::noteTextureUsage(const glm::mat4 &modelMatrix) const
+{
+    if (!resident)
+        return;
+
+    // Bounding sphere in world space; the textures are assumed to span the whole model once
+    TextureResidency &residency = TextureResidency::Get();
+    glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(modelCenter, 1.0f));
+    float radius = 0.5f * glm::length(modelSize) * glm::length(glm::vec3(modelMatrix[0]));
+    float screenSize = residency.projectedSize(center, radius);
+    for (const Mesh &mesh : meshes)
+    {
+        for (const Texture &texture : mesh.textures)
+            residency.noteUsage(texture.id, screenSize);
+    }
 }
 
 void Model::loadModel(const std::string &path)
 {
-    scene = importer->ReadFile(path.c_str(), aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace | aiProcess_GenNormals | aiProcess_LimitBoneWeights);
+    finishLoad(ImportScene(path, ModelImportFlags), path);
+}
+
+void Model::finishLoad(const std::shared_ptr<const ImportedScene> &imported, const std::string &path)
+{
+    modelScene = imported;
+    const aiScene *scene = imported->scene;
 
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
     {
-        std::cerr << "ERROR::ASSIMP:: " << importer->GetErrorString() << std::endl;
+        std::cerr << "ERROR::ASSIMP:: " << imported->importer.GetErrorString() << std::endl;
         return;
     }
     directory = path.substr(0, path.find_last_of('/'));
 
-    globalInverseTransform = aiMatrix4x4ToGlm(scene->mRootNode->mTransformation);
-    globalInverseTransform = glm::inverse(globalInverseTransform);
+    // A streamed model may already be playing a clip whose skeleton root takes precedence
+    if (!hasAnimation)
+    {
+        globalInverseTransform = aiMatrix4x4ToGlm(scene->mRootNode->mTransformation);
+        globalInverseTransform = glm::inverse(globalInverseTransform);
+    }
 
     calculateBounds(scene);
     processNode(scene->mRootNode, scene);
+    batchTextureArrayMeshes();
+    for (Mesh &mesh : meshes)
+    {
+        mesh.buildMeshlets();
+        mesh.setupMesh();
+        attachInstances(mesh);
+    }
+    resident = true;
+
+    if (proxy)
+    {
+        glDeleteVertexArrays(1, &proxy->VAO);
+        glDeleteBuffers(1, &proxy->VBO);
+        glDeleteBuffers(1, &proxy->EBO);
+        proxy.reset();
+    }
+}
+
+// ===== Shared import cache =====
+static std::mutex sceneCacheMutex;
+static std::map<std::string, std::shared_future<std::shared_ptr<const ImportedScene>>> sceneCache;
+
+std::shared_ptr<const ImportedScene> Model::ImportScene(const std::string &path, unsigned int flags)
+{
+    // Callers pass FindImagePath results; the virtual filesystem normalizes them
+    std::string key = VirtualFileSystem::Get().resolve(path);
+    std::string cacheKey = key + "|" + std::to_string(flags);
+
+    std::promise<std::shared_ptr<const ImportedScene>> promise;
+    std::shared_future<std::shared_ptr<const ImportedScene>> future;
+    bool importHere = false;
+    {
+        std::lock_guard<std::mutex> lock(sceneCacheMutex);
+        auto cached = sceneCache.find(cacheKey);
+        if (cached == sceneCache.end())
+        {
+            future = promise.get_future().share();
+            sceneCache.emplace(cacheKey, future);
+            importHere = true;
+        }
+        else
+        {
+            future = cached->second;
+        }
+    }
+
+    if (importHere)
+    {
+        // Read the model and its companion files through the virtual filesystem
+        std::shared_ptr<ImportedScene> imported = std::make_shared<ImportedScene>();
+        imported->importer.SetIOHandler(new AssetIOSystem());
+        imported->scene = imported->importer.ReadFile(key.c_str(), flags);
+        promise.set_value(imported);
+    }
+    return future.get();
+}
+
+std::shared_ptr<const ImportedScene> Model::FindScene(const std::string &path, unsigned int flags)
+{
+    std::string cacheKey = VirtualFileSystem::Get().resolve(path) + "|" + std::to_string(flags);
+
+    std::lock_guard<std::mutex> lock(sceneCacheMutex);
+    auto cached = sceneCache.find(cacheKey);
+    if (cached == sceneCache.end() ||
+        cached->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return nullptr;
+    return cached->second.get();
+}
+
+void Model::PrefetchAnimation(const std::string &animationPath)
+{
+    if (!AssetStreamer::Get().isRunning())
+        return;
+
+    AssetStreamer::Get().submit(
+        [animationPath]() -> size_t
+        {
+            ImportScene(animationPath, AnimationImportFlags);
+            return 0;
+        },
+        nullptr);
 }
 
 void Model::processNode(aiNode *node, const aiScene *scene)
@@ -285,7 +710,7 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene)
 
                 // Load diffuse texture (Base Color)
                 std::string textureFile = "stonewall_Base_Color.png";
-                texture.id = TextureFromFile(textureFile.c_str(), textureFolder);
+                texture.id = TextureFromFile(textureFile.c_str(), textureFolder, &texture.layer);
                 if (texture.id != 0)
                 {
                     texture.type = "texture_diffuse";
@@ -302,7 +727,7 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene)
                     "DefaultMaterial_Mixed_AO.png"};
                 for (const auto &texFile : textureFiles)
                 {
-                    texture.id = TextureFromFile(texFile.c_str(), textureFolder);
+                    texture.id = TextureFromFile(texFile.c_str(), textureFolder, &texture.layer);
                     if (texture.id != 0)
                     {
                         texture.type = "texture_diffuse";
@@ -398,7 +823,7 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene)
             if (!textureFile.empty())
             {
                 Texture texture;
-                texture.id = TextureFromFile(textureFile.c_str(), textureFolder);
+                texture.id = TextureFromFile(textureFile.c_str(), textureFolder, &texture.layer);
                 if (texture.id != 0)
                 {
                     texture.type = "texture_diffuse";
@@ -494,7 +919,7 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene)
 
                     for (const auto &alt : alternatives)
                     {
-                        texture.id = TextureFromFile(alt.c_str(), altTextureFolder);
+                        texture.id = TextureFromFile(alt.c_str(), altTextureFolder, &texture.layer);
                         if (texture.id != 0)
                         {
                             texture.type = "texture_diffuse";
@@ -522,7 +947,7 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene)
                     "DefaultMaterial_Mixed_AO.png"};
                 for (const auto &fallback : fallbacks)
                 {
-                    texture.id = TextureFromFile(fallback.c_str(), textureFolder);
+                    texture.id = TextureFromFile(fallback.c_str(), textureFolder, &texture.layer);
                     if (texture.id != 0)
                     {
                         texture.type = "texture_diffuse";
@@ -544,7 +969,7 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene)
         {
             std::string textureFolder = directory + "/textures default/";
             Texture texture;
-            texture.id = TextureFromFile("DefaultMaterial_Base_Color2.png", textureFolder);
+            texture.id = TextureFromFile("DefaultMaterial_Base_Color2.png", textureFolder, &texture.layer);
             if (texture.id != 0)
             {
                 texture.type = "texture_diffuse";
@@ -554,7 +979,68 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene)
         }
     }
 
-    return Mesh(vertices, indices, textures);
+    // Materials baked into an array carry their layer on every vertex, so submeshes can be merged
+    for (const Texture &texture : textures)
+    {
+        if (texture.type != "texture_diffuse")
+            continue;
+        if (texture.layer >= 0)
+        {
+            for (Vertex &vertex : vertices)
+                vertex.Layer = static_cast<float>(texture.layer);
+        }
+        break;
+    }
+
+    return Mesh(vertices, indices, textures, false);
+}
+
+// ===== Texture array batching =====
+void Model::batchTextureArrayMeshes()
+{
+    // Submeshes whose material is a layer of the same array differ only in their per-vertex
+    // layer, so each group becomes a single mesh and a single draw
+    std::map<unsigned int, std::vector<size_t>> groups;
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        const std::vector<Texture> &meshTextures = meshes[i].textures;
+        if (meshTextures.size() == 1 && meshTextures[0].layer >= 0)
+            groups[meshTextures[0].id].push_back(i);
+    }
+
+    std::vector<bool> merged(meshes.size(), false);
+    std::vector<Mesh> batches;
+    size_t mergedCount = 0;
+    for (const auto &group : groups)
+    {
+        if (group.second.size() < 2)
+            continue;
+
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        for (size_t index : group.second)
+        {
+            unsigned int base = static_cast<unsigned int>(vertices.size());
+            vertices.insert(vertices.end(), meshes[index].vertices.begin(), meshes[index].vertices.end());
+            for (unsigned int vertexIndex : meshes[index].indices)
+                indices.push_back(base + vertexIndex);
+            merged[index] = true;
+        }
+        mergedCount += group.second.size();
+        batches.push_back(Mesh(vertices, indices, meshes[group.second[0]].textures, false));
+    }
+    if (batches.empty())
+        return;
+
+    std::vector<Mesh> kept;
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        if (!merged[i])
+            kept.push_back(std::move(meshes[i]));
+    }
+    kept.insert(kept.end(), batches.begin(), batches.end());
+    meshes.swap(kept);
+    std::cout << "Merged " << mergedCount << " submeshes into " << batches.size() << " texture array draw(s)" << std::endl;
 }
 
 std::vector<Texture> Model::loadMaterialTextures(aiMaterial *mat, aiTextureType type, std::string typeName)
@@ -633,24 +1119,28 @@ std::vector<Texture> Model::loadMaterialTextures(aiMaterial *mat, aiTextureType
         std::string fullTexturePath = textureDir + textureFile;
 
         // Check if we've already loaded this texture (by full path)
-        for (unsigned int j = 0; j < textures_loaded.size(); j++)
         {
-            if (textures_loaded[j].path == fullTexturePath)
+            std::lock_guard<std::mutex> lock(texturesMutex);
+            for (unsigned int j = 0; j < textures_loaded.size(); j++)
             {
-                textures.push_back(textures_loaded[j]);
-                skip = true;
-                break;
+                if (textures_loaded[j].path == fullTexturePath)
+                {
+                    textures.push_back(textures_loaded[j]);
+                    skip = true;
+                    break;
+                }
             }
         }
         if (!skip)
         {
             Texture texture;
-            texture.id = TextureFromFile(textureFile.c_str(), textureDir);
+            texture.id = TextureFromFile(textureFile.c_str(), textureDir, &texture.layer);
             if (texture.id != 0)
             {
                 texture.type = typeName;
                 texture.path = fullTexturePath;
                 textures.push_back(texture);
+                std::lock_guard<std::mutex> lock(texturesMutex);
                 textures_loaded.push_back(texture);
             }
         }
@@ -658,7 +1148,7 @@ std::vector<Texture> Model::loadMaterialTextures(aiMaterial *mat, aiTextureType
     return textures;
 }
 
-unsigned int Model::TextureFromFile(const char *path, const std::string &directory)
+unsigned int Model::TextureFromFile(const char *path, const std::string &directory, int *layer)
 {
     std::string filename;
     if (directory.back() == '/')
@@ -666,27 +1156,63 @@ unsigned int Model::TextureFromFile(const char *path, const std::string &directo
     else
         filename = directory + '/' + std::string(path);
 
+    // Images baked into a texture array are sampled from their layer rather than loaded on their own
+    int arrayLayer = -1;
+    unsigned int arrayTexture = TextureArrays::Get().find(filename, arrayLayer);
+    if (layer)
+        *layer = arrayLayer;
+    if (arrayTexture != 0)
+        return arrayTexture;
+
     // Check if we've already loaded this texture (texture caching to avoid duplicate loads)
-    for (unsigned int i = 0; i < textures_loaded.size(); i++)
     {
-        // Compare full paths to see if this texture was already loaded
-        std::string loadedFullPath = textures_loaded[i].path;
-        if (loadedFullPath == filename && textures_loaded[i].id != 0)
+        std::lock_guard<std::mutex> lock(texturesMutex);
+        for (unsigned int i = 0; i < textures_loaded.size(); i++)
         {
-            return textures_loaded[i].id; // Return existing texture ID (reuse cached texture)
+            // Compare full paths to see if this texture was already loaded
+            const std::string &loadedFullPath = textures_loaded[i].path;
+            if (loadedFullPath == filename && textures_loaded[i].id != 0)
+            {
+                return textures_loaded[i].id; // Return existing texture ID (reuse cached texture)
+            }
         }
     }
 
+    // Streamed: the decode runs on a worker and the returned texture shows a placeholder until it lands
+    if (AssetStreamer::Get().isRunning())
+    {
+        unsigned int streamedID = AssetStreamer::Get().requestTexture(filename);
+        if (streamedID != 0)
+        {
+            Texture tex;
+            tex.id = streamedID;
+            tex.path = filename;
+            tex.type = "texture_diffuse";
+            std::lock_guard<std::mutex> lock(texturesMutex);
+            textures_loaded.push_back(tex);
+        }
+        else
+        {
+            std::cerr << "Failed to load texture: " << filename << std::endl;
+        }
+        return streamedID;
+    }
+
     // Create new OpenGL texture object
     unsigned int textureID = 0;
     glGenTextures(1, &textureID);
 
-    // Load image data from file using stb_image
+    // Load image data using stb_image, decoding in place from the mapped asset
     int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
+    unsigned char *data = nullptr;
+    AssetData asset = VirtualFileSystem::Get().open(filename);
+    if (asset.valid())
+        data = stbi_load_from_memory(asset.data(), static_cast<int>(asset.size()), &width, &height, &nrComponents, 0);
 
     if (data)
     {
+        FlipImageRows(data, width, height, nrComponents);
+
         // Determine OpenGL format based on number of color components
         GLenum format;
         if (nrComponents == 1)
@@ -715,6 +1241,7 @@ unsigned int Model::TextureFromFile(const char *path, const std::string &directo
         tex.id = textureID;
         tex.path = filename; // Store full path for cache lookup
         tex.type = "texture_diffuse";
+        std::lock_guard<std::mutex> lock(texturesMutex);
         textures_loaded.push_back(tex);
     }
     else
@@ -759,17 +1286,126 @@ void Model::calculateBounds(const aiScene *scene)
 
     modelSize = glm::vec3(maxX - minX, maxY - minY, maxZ - minZ);
     modelCenter = glm::vec3((minX + maxX) / 2.0f, (minY + maxY) / 2.0f, (minZ + maxZ) / 2.0f);
+    boundsKnown = true;
+}
+
+// ===== Proxy =====
+void Model::buildProxy()
+{
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    glm::vec3 halfSize = glm::max(modelSize * 0.5f, glm::vec3(0.01f));
+
+    if (proxyShape == ProxyShape::Box)
+    {
+        // Four vertices per face so every face gets a flat normal
+        for (int axis = 0; axis < 3; axis++)
+        {
+            for (int sign = -1; sign <= 1; sign += 2)
+            {
+                glm::vec3 normal(0.0f);
+                normal[axis] = static_cast<float>(sign);
+                glm::vec3 u(0.0f), v(0.0f);
+                u[(axis + 1) % 3] = 1.0f;
+                v[(axis + 2) % 3] = 1.0f;
+                if (sign < 0)
+                    std::swap(u, v);
+
+                unsigned int base = static_cast<unsigned int>(vertices.size());
+                const float corners[4][2] = {{-1.0f, -1.0f}, {1.0f, -1.0f}, {1.0f, 1.0f}, {-1.0f, 1.0f}};
+                for (const auto &corner : corners)
+                {
+                    Vertex vertex;
+                    vertex.Position = modelCenter + (normal + u * corner[0] + v * corner[1]) * halfSize;
+                    vertex.Normal = normal;
+                    vertex.TexCoords = glm::vec2(corner[0] * 0.5f + 0.5f, corner[1] * 0.5f + 0.5f);
+                    vertices.push_back(vertex);
+                }
+                indices.insert(indices.end(), {base, base + 1, base + 2, base, base + 2, base + 3});
+            }
+        }
+    }
+    else
+    {
+        // Two hemispheres joined by a cylinder; the equator ring is duplicated to form its sides
+        const int SEGMENTS = 16;
+        const int HEMISPHERE_RINGS = 4;
+        int axis = 1;
+        if (modelSize.x > modelSize[axis])
+            axis = 0;
+        if (modelSize.z > modelSize[axis])
+            axis = 2;
+        glm::vec3 w(0.0f), u(0.0f), v(0.0f);
+        w[axis] = 1.0f;
+        u[(axis + 1) % 3] = 1.0f;
+        v[(axis + 2) % 3] = 1.0f;
+        float radius = 0.5f * (halfSize[(axis + 1) % 3] + halfSize[(axis + 2) % 3]);
+        radius = std::min(radius, halfSize[axis]);
+        float halfLength = halfSize[axis] - radius;
+
+        const int RINGS = 2 * (HEMISPHERE_RINGS + 1);
+        for (int ring = 0; ring < RINGS; ring++)
+        {
+            bool upper = ring > HEMISPHERE_RINGS;
+            int step = upper ? ring - 1 : ring;
+            float latitude = glm::pi<float>() * (static_cast<float>(step) / (2 * HEMISPHERE_RINGS) - 0.5f);
+            for (int segment = 0; segment <= SEGMENTS; segment++)
+            {
+                float longitude = glm::two_pi<float>() * segment / SEGMENTS;
+                glm::vec3 normal = u * (std::cos(latitude) * std::cos(longitude)) +
+                                   v * (std::cos(latitude) * std::sin(longitude)) +
+                                   w * std::sin(latitude);
+                Vertex vertex;
+                vertex.Position = modelCenter + normal * radius + w * (upper ? halfLength : -halfLength);
+                vertex.Normal = normal;
+                vertex.TexCoords = glm::vec2(static_cast<float>(segment) / SEGMENTS, static_cast<float>(ring) / (RINGS - 1));
+                vertices.push_back(vertex);
+            }
+        }
+        for (int ring = 0; ring + 1 < RINGS; ring++)
+        {
+            for (int segment = 0; segment < SEGMENTS; segment++)
+            {
+                unsigned int a = ring * (SEGMENTS + 1) + segment;
+                unsigned int b = a + SEGMENTS + 1;
+                indices.insert(indices.end(), {a, a + 1, b + 1, a, b + 1, b});
+            }
+        }
+    }
+
+    proxy.reset(new Mesh(vertices, indices, std::vector<Texture>()));
+    attachInstances(*proxy);
 }
 
 // Animation functions
 void Model::LoadAnimation(const std::string& animationPath)
 {
-    std::string fixedPath = FindImagePath(animationPath);
-    if (animationImporter) delete animationImporter;
-    animationImporter = new Assimp::Importer();
+    // Callers pass paths from FindImagePath; the virtual filesystem normalizes them
+    std::string fixedPath = VirtualFileSystem::Get().resolve(animationPath);
+
+    // A streamed model keeps its current pose until the clip's import lands rather than stalling the frame
+    if (streamHandle && !FindScene(fixedPath, AnimationImportFlags))
+    {
+        pendingAnimation = fixedPath;
+        std::shared_ptr<Model *> handle = streamHandle;
+        AssetStreamer::Get().submit(
+            [fixedPath]() -> size_t
+            {
+                ImportScene(fixedPath, AnimationImportFlags);
+                return 0;
+            },
+            [handle, fixedPath]()
+            {
+                if (*handle && (*handle)->pendingAnimation == fixedPath)
+                    (*handle)->LoadAnimation(fixedPath);
+            });
+        return;
+    }
+    pendingAnimation.clear();
 
-    animationScene = animationImporter->ReadFile(fixedPath.c_str(),
-        aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_LimitBoneWeights);
+    // Clips are imported once and shared, so a state switch only rebuilds the bone table
+    animationAsset = ImportScene(fixedPath, AnimationImportFlags);
+    animationScene = animationAsset->scene;
 
     if (!animationScene || !animationScene->HasAnimations())
     {
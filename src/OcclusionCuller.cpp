@@ -0,0 +1,308 @@
+#include "OcclusionCuller.h"
+#include <GL/glew.h>
+#include <iostream>
+#include "GLState.h"
+#include "ShaderManager.h"
+
+static OcclusionCuller::Stats frameStats;
+static OcclusionCuller::Stats lastFrameStats;
+
+// Boxes the camera is this close to may be cut by the near plane and report no samples
+static const float NearMargin = 0.2f;
+
+OcclusionCuller &OcclusionCuller::Get()
+{
+    static OcclusionCuller instance;
+    return instance;
+}
+
+// ===== Frame =====
+void OcclusionCuller::beginFrame(const glm::vec3 &viewPos)
+{
+    if (!enabled)
+        return;
+    frame++;
+    this->viewPos = viewPos;
+
+    for (auto it = entries.begin(); it != entries.end();)
+    {
+        Entry &entry = it->second;
+        // Left the frustum or went away; an old result would be stale by the time it returns
+        if (entry.lastFrame + 1 < frame)
+        {
+            if (entry.query != 0)
+                freeQueries.push_back(entry.query);
+            it = entries.erase(it);
+            continue;
+        }
+        if (entry.pending)
+        {
+            GLuint available = 0;
+            glGetQueryObjectuiv(entry.query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available)
+            {
+                GLuint samples = 0;
+                glGetQueryObjectuiv(entry.query, GL_QUERY_RESULT, &samples);
+                entry.occluded = samples == 0;
+                entry.pending = false;
+            }
+        }
+        ++it;
+    }
+
+    for (int i = 0; i < SceneQueries; i++)
+    {
+        if (sceneFrames[i] == 0)
+            continue;
+        GLuint available = 0;
+        glGetQueryObjectuiv(sceneQueries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            continue;
+        GLuint samples = 0;
+        glGetQueryObjectuiv(sceneQueries[i], GL_QUERY_RESULT, &samples);
+        if (sceneFrames[i] > lastPixelsFrame)
+        {
+            lastPixelsFrame = sceneFrames[i];
+            lastPixelsShaded = samples;
+        }
+        sceneFrames[i] = 0;
+    }
+    frameStats.pixelsShaded = lastPixelsShaded;
+}
+
+bool OcclusionCuller::request(const void *key, const glm::vec3 &min, const glm::vec3 &max,
+                              unsigned int &conditionalQuery, unsigned long instances)
+{
+    conditionalQuery = 0;
+    if (!enabled)
+        return true;
+
+    Entry &entry = entries[key];
+    entry.min = min;
+    entry.max = max;
+    entry.lastFrame = frame;
+
+    // With the camera in or at the box, its proxy says nothing about what is behind the near plane
+    glm::vec3 nearMin = min - glm::vec3(NearMargin);
+    glm::vec3 nearMax = max + glm::vec3(NearMargin);
+    bool surrounds = viewPos.x >= nearMin.x && viewPos.y >= nearMin.y && viewPos.z >= nearMin.z &&
+                     viewPos.x <= nearMax.x && viewPos.y <= nearMax.y && viewPos.z <= nearMax.z;
+    if (surrounds)
+    {
+        entry.occluded = false;
+        entry.testThisFrame = false;
+        return true;
+    }
+
+    if (entry.pending)
+    {
+        // The query object can't be reused until it is read, so the object waits a frame for its test
+        conditionalQuery = entry.query;
+        frameStats.conditional++;
+        return true;
+    }
+
+    entry.testThisFrame = true;
+    if (entry.occluded)
+    {
+        frameStats.skipped += instances;
+        return false;
+    }
+    return true;
+}
+
+void OcclusionCuller::beginScene()
+{
+    if (!enabled || sceneFrames[sceneNext] != 0)
+        return;
+    if (sceneQueries[sceneNext] == 0)
+        glGenQueries(1, &sceneQueries[sceneNext]);
+    glBeginQuery(GL_SAMPLES_PASSED, sceneQueries[sceneNext]);
+    sceneFrames[sceneNext] = frame;
+}
+
+void OcclusionCuller::endScene()
+{
+    if (!enabled || sceneFrames[sceneNext] != frame)
+        return;
+    glEndQuery(GL_SAMPLES_PASSED);
+    sceneNext = (sceneNext + 1) % SceneQueries;
+}
+
+// ===== Queries =====
+unsigned int OcclusionCuller::allocateQuery()
+{
+    if (!freeQueries.empty())
+    {
+        unsigned int query = freeQueries.back();
+        freeQueries.pop_back();
+        return query;
+    }
+    unsigned int query = 0;
+    glGenQueries(1, &query);
+    return query;
+}
+
+bool OcclusionCuller::createProxy()
+{
+    if (proxyVAO != 0)
+        return true;
+    if (proxyFailed)
+        return false;
+
+    const char *proxyVertexShader = R"(
+        #version 330 core
+        layout (location = 0) in vec3 aPos;
+        uniform mat4 viewProjection;
+        uniform vec3 boxMin;
+        uniform vec3 boxMax;
+        void main()
+        {
+            gl_Position = viewProjection * vec4(mix(boxMin, boxMax, aPos), 1.0);
+        }
+    )";
+    const char *proxyFragmentShader = R"(
+        #version 330 core
+        out vec4 FragColor;
+        void main()
+        {
+            FragColor = vec4(1.0);
+        }
+    )";
+    unsigned int program = ShaderManager::Get().createProgram("occlusion_proxy", proxyVertexShader, proxyFragmentShader);
+    if (program == 0)
+    {
+        std::cerr << "Occlusion culling disabled: the proxy shader failed to build" << std::endl;
+        proxyFailed = true;
+        enabled = false;
+        return false;
+    }
+    proxyShader.attach(program);
+    viewProjectionSlot = proxyShader.slot("viewProjection");
+    boxMinSlot = proxyShader.slot("boxMin");
+    boxMaxSlot = proxyShader.slot("boxMax");
+
+    // Unit cube, scaled onto each box by the vertex shader
+    const float corners[] = {
+        0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f, 0.0f, 1.0f, 1.0f};
+    const unsigned int faces[] = {
+        0, 2, 1, 0, 3, 2, // Back
+        4, 5, 6, 4, 6, 7, // Front
+        0, 1, 5, 0, 5, 4, // Bottom
+        3, 6, 2, 3, 7, 6, // Top
+        0, 4, 7, 0, 7, 3, // Left
+        1, 2, 6, 1, 6, 5  // Right
+    };
+
+    glGenVertexArrays(1, &proxyVAO);
+    glGenBuffers(1, &proxyVBO);
+    glGenBuffers(1, &proxyEBO);
+    glBindVertexArray(proxyVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, proxyVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, proxyEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(faces), faces, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
+    glBindVertexArray(0);
+
+    // Created mid-frame, behind the state cache's back
+    GLState::Get().invalidate();
+    return true;
+}
+
+void OcclusionCuller::issueQueries(const glm::mat4 &viewProjection)
+{
+    if (!enabled || !createProxy())
+        return;
+
+    GLState &state = GLState::Get();
+    state.useProgram(proxyShader.id());
+    state.bindVertexArray(proxyVAO);
+    state.setDepthTest(true);
+    state.setDepthFunc(GL_LEQUAL);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+    proxyShader.set(viewProjectionSlot, viewProjection);
+
+    for (auto &item : entries)
+    {
+        Entry &entry = item.second;
+        if (!entry.testThisFrame || entry.lastFrame != frame)
+            continue;
+        if (entry.query == 0)
+            entry.query = allocateQuery();
+
+        proxyShader.set(boxMinSlot, entry.min);
+        proxyShader.set(boxMaxSlot, entry.max);
+        glBeginQuery(GL_SAMPLES_PASSED, entry.query);
+        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+        glEndQuery(GL_SAMPLES_PASSED);
+        entry.pending = true;
+        entry.testThisFrame = false;
+        frameStats.tested++;
+    }
+
+    glDepthMask(GL_TRUE);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    state.setDepthFunc(GL_LESS);
+}
+
+void OcclusionCuller::forget(const void *key)
+{
+    auto found = entries.find(key);
+    if (found == entries.end())
+        return;
+    if (found->second.query != 0)
+        freeQueries.push_back(found->second.query);
+    entries.erase(found);
+}
+
+void OcclusionCuller::shutdown()
+{
+    for (auto &item : entries)
+    {
+        if (item.second.query != 0)
+            freeQueries.push_back(item.second.query);
+    }
+    entries.clear();
+    if (!freeQueries.empty())
+        glDeleteQueries(static_cast<GLsizei>(freeQueries.size()), freeQueries.data());
+    freeQueries.clear();
+    for (int i = 0; i < SceneQueries; i++)
+    {
+        if (sceneQueries[i] != 0)
+            glDeleteQueries(1, &sceneQueries[i]);
+        sceneQueries[i] = 0;
+        sceneFrames[i] = 0;
+    }
+
+    if (proxyShader.id() != 0)
+        glDeleteProgram(proxyShader.id());
+    proxyShader.attach(0);
+    if (proxyVAO != 0)
+        glDeleteVertexArrays(1, &proxyVAO);
+    if (proxyVBO != 0)
+        glDeleteBuffers(1, &proxyVBO);
+    if (proxyEBO != 0)
+        glDeleteBuffers(1, &proxyEBO);
+    proxyVAO = proxyVBO = proxyEBO = 0;
+}
+
+// ===== Stats =====
+OcclusionCuller::Stats &OcclusionCuller::FrameStats()
+{
+    return frameStats;
+}
+
+const OcclusionCuller::Stats &OcclusionCuller::LastFrameStats()
+{
+    return lastFrameStats;
+}
+
+void OcclusionCuller::EndFrame()
+{
+    lastFrameStats = frameStats;
+    frameStats = Stats();
+}
@@ -1,5 +1,8 @@
 #include "Projectile.h"
 #include "Terrain.h"
+#include "FrustumCuller.h"
+#include "RenderQueue.h"
+#include "SoftwareOcclusion.h"
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
@@ -161,14 +164,28 @@ void Projectile::updateFragments(float deltaTime)
     }
 }
 
-void Projectile::drawFragments(unsigned int shaderProgram)
+void Projectile::drawFragments()
 {
-    unsigned int colorLoc = glGetUniformLocation(shaderProgram, "objectColor");
+    RenderQueue &queue = RenderQueue::Get();
+    DrawPacket fragment;
+    fragment.vertexArray = VAO;
+    fragment.count = vertexCount;
 
+    // The sphere mesh has the projectile radius (0.15f) and is scaled per fragment
+    fragmentBounds.clear();
     for (const auto &frag : fragments)
     {
-        if (frag.life <= 0.0f)
-            continue; // Skip dead fragments
+        glm::vec3 extent(0.15f * frag.size * frag.life);
+        fragmentBounds.add(frag.position - extent, frag.position + extent);
+    }
+    FrustumCuller::Get().test(fragmentBounds, fragmentVisible);
+    SoftwareOcclusion::Get().test(fragmentBounds, fragmentVisible);
+
+    for (size_t i = 0; i < fragments.size(); i++)
+    {
+        const Fragment &frag = fragments[i];
+        if (frag.life <= 0.0f || !fragmentVisible[i])
+            continue; // Skip dead and off-screen fragments
 
         glm::mat4 model = glm::mat4(1.0f);
         model = glm::translate(model, frag.position);
@@ -177,18 +194,16 @@ void Projectile::drawFragments(unsigned int shaderProgram)
         float scale = frag.size * frag.life;
         model = glm::scale(model, glm::vec3(scale));
 
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
+        fragment.model = model;
 
         // Set color - start with rock color, fade to darker as life decreases
         float lifeFactor = frag.life;
         float r = 0.35f * lifeFactor;
         float g = 0.3f * lifeFactor;
         float b = 0.25f * lifeFactor;
-        glUniform3f(colorLoc, r, g, b);
+        fragment.color = glm::vec3(r, g, b);
 
-        glBindVertexArray(VAO);
-        glDrawArrays(GL_TRIANGLES, 0, vertexCount);
-        glBindVertexArray(0);
+        queue.submit(fragment);
     }
 }
 
@@ -213,27 +228,26 @@ float Projectile::calculateDamage(float distanceFromImpact) const
     }
 }
 
-void Projectile::draw(unsigned int shaderProgram)
+void Projectile::draw()
 {
     if (isAnimating && hasShattered)
     {
         // Draw shatter fragments instead of main projectile
-        drawFragments(shaderProgram);
+        drawFragments();
     }
     else if (!isAnimating)
     {
         // Draw normal projectile
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, position);
-
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-
-        unsigned int colorLoc = glGetUniformLocation(shaderProgram, "objectColor");
-        glUniform3f(colorLoc, 0.35f, 0.3f, 0.25f); // Rock color
-
-        glBindVertexArray(VAO);
-        glDrawArrays(GL_TRIANGLES, 0, vertexCount); // sphere vertices
-        glBindVertexArray(0);
+        glm::vec3 extent(0.15f); // Projectile radius
+        if (!FrustumCuller::Get().isVisible(position - extent, position + extent))
+            return;
+
+        DrawPacket sphere;
+        sphere.model = glm::translate(glm::mat4(1.0f), position);
+        sphere.color = glm::vec3(0.35f, 0.3f, 0.25f); // Rock color
+        sphere.vertexArray = VAO;
+        sphere.count = vertexCount; // sphere vertices
+        RenderQueue::Get().submit(sphere);
     }
 }
 
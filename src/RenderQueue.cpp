@@ -0,0 +1,183 @@
+#include "RenderQueue.h"
+#include "GLState.h"
+#include "ShaderPermutations.h"
+#include "TextureArrays.h"
+#include <algorithm>
+#include <cstring>
+
+static RenderQueue::Stats lastFrameStats;
+
+// Key fields, from the top: 2 bits pass, then 62 bits laid out per pass
+static const int DepthBits = 22;
+static const uint64_t DepthMax = (1ull << DepthBits) - 1;
+
+RenderQueue &RenderQueue::Get()
+{
+    static RenderQueue instance;
+    return instance;
+}
+
+void RenderQueue::begin(const glm::vec3 &position, const glm::vec3 &direction, float far)
+{
+    viewPos = position;
+    viewDir = glm::normalize(direction);
+    farPlane = far > 0.0f ? far : 1.0f;
+    packets.clear();
+    bones.clear();
+    rangeCounts.clear();
+    rangeOffsets.clear();
+}
+
+int RenderQueue::addBones(const glm::mat4 *values, size_t count)
+{
+    int offset = static_cast<int>(bones.size());
+    bones.insert(bones.end(), values, values + count);
+    return offset;
+}
+
+int RenderQueue::addRanges(const unsigned int *firstIndices, const int *counts, size_t count)
+{
+    int offset = static_cast<int>(rangeCounts.size());
+    for (size_t i = 0; i < count; i++)
+    {
+        rangeCounts.push_back(counts[i]);
+        rangeOffsets.push_back(reinterpret_cast<const void *>(static_cast<size_t>(firstIndices[i]) * sizeof(unsigned int)));
+    }
+    return offset;
+}
+
+void RenderQueue::submit(const DrawPacket &packet)
+{
+    if (packet.count > 0 && packet.instances > 0)
+        packets.push_back(packet);
+}
+
+uint64_t RenderQueue::makeKey(const DrawPacket &packet) const
+{
+    // View depth of the object's origin, clamped to the far plane
+    glm::vec3 origin = glm::vec3(packet.model[3]);
+    float depth = glm::clamp(glm::dot(origin - viewPos, viewDir) / farPlane, 0.0f, 1.0f);
+    uint64_t quantised = static_cast<uint64_t>(depth * static_cast<float>(DepthMax));
+
+    // GL names are small, so their low bits tell apart everything a frame binds; a
+    // collision only costs ordering, since the packet carries the full names
+    uint64_t program = packet.features & 0xFF;
+    uint64_t material = (packet.texture != 0 ? packet.texture : packet.arrayTexture) & 0xFFFF;
+    uint64_t vertexArray = packet.vertexArray & 0xFFFF;
+    uint64_t pass = static_cast<uint64_t>(packet.pass) & 0x3;
+
+    if (packet.pass == RenderPass::Transparent)
+        return pass << 62 | (DepthMax - quantised) << 40 | program << 32 | material << 16 | vertexArray;
+    return pass << 62 | program << 54 | material << 38 | vertexArray << 22 | quantised;
+}
+
+unsigned long RenderQueue::countChanges(const std::vector<SortEntry> &entries) const
+{
+    unsigned long changes = 0;
+    const DrawPacket *previous = nullptr;
+    for (const SortEntry &entry : entries)
+    {
+        const DrawPacket &packet = packets[entry.index];
+        if (!previous || packet.features != previous->features)
+            changes++;
+        if (!previous || packet.texture != previous->texture || packet.arrayTexture != previous->arrayTexture)
+            changes++;
+        if (!previous || packet.vertexArray != previous->vertexArray)
+            changes++;
+        previous = &packet;
+    }
+    return changes;
+}
+
+void RenderQueue::flush()
+{
+    order.clear();
+    order.reserve(packets.size());
+    for (unsigned int i = 0; i < packets.size(); i++)
+        order.push_back({makeKey(packets[i]), i});
+
+    lastFrameStats.packets = packets.size();
+    lastFrameStats.triangles = 0;
+    for (const DrawPacket &packet : packets)
+        lastFrameStats.triangles += static_cast<unsigned long>(packet.count / 3) * packet.instances;
+    lastFrameStats.unsortedChanges = countChanges(order);
+    // Ties keep submission order, so parts drawn over each other stay in place
+    std::sort(order.begin(), order.end(), [](const SortEntry &a, const SortEntry &b)
+              { return a.key != b.key ? a.key < b.key : a.index < b.index; });
+    lastFrameStats.sortedChanges = countChanges(order);
+
+    GLState &state = GLState::Get();
+    bool blending = false;
+    const DrawPacket *previous = nullptr;
+    for (const SortEntry &entry : order)
+    {
+        const DrawPacket &packet = packets[entry.index];
+        if (packet.pass == RenderPass::Transparent && !blending)
+        {
+            blending = true;
+            state.setBlend(true);
+            state.setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glDepthMask(GL_FALSE);
+        }
+        execute(packet, previous);
+        previous = &packet;
+    }
+    if (blending)
+    {
+        glDepthMask(GL_TRUE);
+        state.setBlend(false);
+    }
+
+    packets.clear();
+    bones.clear();
+    rangeCounts.clear();
+    rangeOffsets.clear();
+}
+
+void RenderQueue::execute(const DrawPacket &packet, const DrawPacket *previous)
+{
+    GLState &state = GLState::Get();
+    if (packet.texture != 0)
+        state.bindTexture(0, GL_TEXTURE_2D, packet.texture);
+    if (packet.arrayTexture != 0)
+        state.bindTexture(TextureArrays::TextureUnit, GL_TEXTURE_2D_ARRAY, packet.arrayTexture);
+
+    // Consecutive parts of one object share these, so the normal matrix is not rebuilt for each
+    ShaderPermutations &shaders = ShaderPermutations::Get();
+    if (!previous || std::memcmp(&packet.model, &previous->model, sizeof(glm::mat4)) != 0)
+        shaders.setModel(packet.model);
+    if (!previous || packet.color != previous->color)
+        shaders.setColor(packet.color);
+    if ((packet.features & SHADER_DITHER_FADE) && (!previous || packet.impostorFade != previous->impostorFade))
+        shaders.setImpostorFade(packet.impostorFade);
+    if ((packet.features & SHADER_SKINNED) && packet.bonesOffset >= 0 &&
+        (!previous || packet.bonesOffset != previous->bonesOffset))
+        shaders.setBones(bones.data() + packet.bonesOffset, static_cast<size_t>(packet.bonesCount));
+    if (!shaders.use(packet.features))
+        return;
+
+    state.bindVertexArray(packet.vertexArray);
+    const void *indices = reinterpret_cast<const void *>(static_cast<size_t>(packet.first) * sizeof(unsigned int));
+    bool instanced = (packet.features & SHADER_INSTANCED) != 0;
+    // Without waiting: the GPU skips the draw if the query found nothing, and draws it while the result is unknown
+    if (packet.occlusionQuery != 0)
+        glBeginConditionalRender(packet.occlusionQuery, GL_QUERY_NO_WAIT);
+    if (packet.rangesCount > 0 && packet.indexed && !instanced)
+        glMultiDrawElements(GL_TRIANGLES, rangeCounts.data() + packet.rangesOffset, GL_UNSIGNED_INT,
+                            rangeOffsets.data() + packet.rangesOffset, packet.rangesCount);
+    else if (instanced && packet.indexed)
+        glDrawElementsInstanced(GL_TRIANGLES, packet.count, GL_UNSIGNED_INT, indices, packet.instances);
+    else if (instanced)
+        glDrawArraysInstanced(GL_TRIANGLES, packet.first, packet.count, packet.instances);
+    else if (packet.indexed)
+        glDrawElements(GL_TRIANGLES, packet.count, GL_UNSIGNED_INT, indices);
+    else
+        glDrawArrays(GL_TRIANGLES, packet.first, packet.count);
+    if (packet.occlusionQuery != 0)
+        glEndConditionalRender();
+}
+
+const RenderQueue::Stats &RenderQueue::LastFrameStats()
+{
+    return lastFrameStats;
+}
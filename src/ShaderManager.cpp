@@ -0,0 +1,290 @@
+#include "ShaderManager.h"
+#include <GL/glew.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "AssetPack.h"
+#include "VirtualFileSystem.h"
+
+// File layout: ShaderBinaryHeader, then the driver's program binary
+static const char SHADER_BINARY_MAGIC[4] = {'S', 'C', 'S', 'B'};
+static const uint32_t SHADER_BINARY_VERSION = 1;
+static const char *SHADER_CACHE_DIR = "cache/shaders";
+
+struct ShaderBinaryHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t binaryFormat;
+    uint32_t binaryLength;
+    uint64_t driverHash;
+    uint64_t sourceHash;
+};
+
+ShaderManager &ShaderManager::Get()
+{
+    static ShaderManager instance;
+    return instance;
+}
+
+ShaderManager::ShaderManager()
+    : initialized(false), binariesSupported(false), parallelCompile(false), driverHash(0)
+{
+}
+
+void ShaderManager::init()
+{
+    initialized = true;
+
+    // A binary only loads on the driver build that produced it, so the driver is part of the key
+    std::string driver;
+    for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+    {
+        const GLubyte *value = glGetString(name);
+        driver += value ? reinterpret_cast<const char *>(value) : "";
+        driver += '\n';
+    }
+    driverHash = AssetPack::HashBytes(driver.data(), driver.size());
+
+    // Core in 4.1; a 3.3 context needs ARB_get_program_binary, and a driver may still offer no formats
+    GLint formats = 0;
+    if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary)
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    binariesSupported = formats > 0;
+    const char *cache = std::getenv("SIMPLECATAPULT_SHADER_CACHE");
+    if (cache && std::strcmp(cache, "0") == 0)
+        binariesSupported = false;
+
+    parallelCompile = GLEW_KHR_parallel_shader_compile;
+    if (parallelCompile)
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+
+    std::cout << "Shader cache: " << (binariesSupported ? "program binaries" : "disabled")
+              << (parallelCompile ? ", parallel compile" : "") << std::endl;
+}
+
+// ===== Building =====
+static unsigned int compileStage(GLenum stage, const std::string &source)
+{
+    const char *code = source.c_str();
+    unsigned int shader = glCreateShader(stage);
+    glShaderSource(shader, 1, &code, NULL);
+    glCompileShader(shader);
+    return shader;
+}
+
+// Compile and link status are only queried here, so the driver can work in between
+static bool checkShader(unsigned int shader, const std::string &name, const char *stage)
+{
+    int success = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (success)
+        return true;
+
+    int length = 0;
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+    std::string log(std::max(length, 1), '\0');
+    glGetShaderInfoLog(shader, length, NULL, &log[0]);
+    std::cerr << "Shader '" << name << "': " << stage << " shader compilation failed:\n"
+              << log.c_str() << std::endl;
+    return false;
+}
+
+ShaderManager::Handle ShaderManager::begin(const std::string &name, const std::string &vertexSource,
+                                           const std::string &fragmentSource)
+{
+    if (!initialized)
+        init();
+
+    Pending request;
+    request.name = name;
+    request.startTime = std::chrono::steady_clock::now();
+    request.sourceHash = AssetPack::HashBytes(vertexSource.data(), vertexSource.size());
+    request.sourceHash = AssetPack::HashBytes("\0", 1, request.sourceHash);
+    request.sourceHash = AssetPack::HashBytes(fragmentSource.data(), fragmentSource.size(), request.sourceHash);
+
+    if (binariesSupported && loadBinary(request))
+    {
+        request.fromCache = true;
+    }
+    else
+    {
+        request.vertexShader = compileStage(GL_VERTEX_SHADER, vertexSource);
+        request.fragmentShader = compileStage(GL_FRAGMENT_SHADER, fragmentSource);
+        request.program = glCreateProgram();
+        glAttachShader(request.program, request.vertexShader);
+        glAttachShader(request.program, request.fragmentShader);
+        if (binariesSupported)
+            glProgramParameteri(request.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(request.program);
+    }
+
+    pending.push_back(request);
+    return static_cast<Handle>(pending.size()) - 1;
+}
+
+ShaderManager::Handle ShaderManager::beginFromFiles(const std::string &vertexPath, const std::string &fragmentPath)
+{
+    std::string vertexSource = VirtualFileSystem::Get().readText(vertexPath);
+    std::string fragmentSource = VirtualFileSystem::Get().readText(fragmentPath);
+    if (vertexSource.empty())
+        std::cerr << "Error: Shader file not found: '" << vertexPath << "'." << std::endl;
+    if (fragmentSource.empty())
+        std::cerr << "Error: Shader file not found: '" << fragmentPath << "'." << std::endl;
+
+    std::string name = std::filesystem::path(vertexPath).stem().string() + "+" +
+                       std::filesystem::path(fragmentPath).stem().string();
+    return begin(name, vertexSource, fragmentSource);
+}
+
+bool ShaderManager::isReady(Handle handle) const
+{
+    if (handle < 0 || handle >= static_cast<Handle>(pending.size()))
+        return false;
+    const Pending &request = pending[handle];
+    if (request.finished || request.fromCache || !parallelCompile)
+        return true;
+
+    int complete = 0;
+    glGetProgramiv(request.program, GL_COMPLETION_STATUS_KHR, &complete);
+    return complete != 0;
+}
+
+unsigned int ShaderManager::finish(Handle handle)
+{
+    if (handle < 0 || handle >= static_cast<Handle>(pending.size()))
+        return 0;
+    Pending &request = pending[handle];
+    if (request.finished)
+        return request.program;
+    request.finished = true;
+
+    bool linked = true;
+    if (!request.fromCache)
+    {
+        linked = checkShader(request.vertexShader, request.name, "vertex") &
+                 checkShader(request.fragmentShader, request.name, "fragment");
+
+        int success = 0;
+        glGetProgramiv(request.program, GL_LINK_STATUS, &success);
+        if (!success && linked)
+        {
+            int length = 0;
+            glGetProgramiv(request.program, GL_INFO_LOG_LENGTH, &length);
+            std::string log(std::max(length, 1), '\0');
+            glGetProgramInfoLog(request.program, length, NULL, &log[0]);
+            std::cerr << "Shader '" << request.name << "': program linking failed:\n"
+                      << log.c_str() << std::endl;
+        }
+        linked = linked && success;
+
+        glDeleteShader(request.vertexShader);
+        glDeleteShader(request.fragmentShader);
+        request.vertexShader = 0;
+        request.fragmentShader = 0;
+    }
+
+    if (!linked)
+    {
+        glDeleteProgram(request.program);
+        request.program = 0;
+        return 0;
+    }
+    if (!request.fromCache && binariesSupported)
+        saveBinary(request);
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - request.startTime).count();
+    std::cout << "Shader '" << request.name << "' " << (request.fromCache ? "loaded from cache" : "compiled")
+              << " in " << ms << " ms" << std::endl;
+    return request.program;
+}
+
+// ===== Binary Cache =====
+std::string ShaderManager::binaryPath(const Pending &request) const
+{
+    std::ostringstream path;
+    path << SHADER_CACHE_DIR << "/" << request.name << "_" << std::hex << request.sourceHash << ".bin";
+    return path.str();
+}
+
+bool ShaderManager::loadBinary(Pending &request)
+{
+    std::string path = binaryPath(request);
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return false;
+
+    ShaderBinaryHeader header;
+    if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, SHADER_BINARY_MAGIC, 4) != 0 || header.version != SHADER_BINARY_VERSION ||
+        header.sourceHash != request.sourceHash || header.driverHash != driverHash || header.binaryLength == 0)
+    {
+        return false;
+    }
+    std::vector<char> binary(header.binaryLength);
+    if (!in.read(binary.data(), binary.size()))
+        return false;
+    in.close();
+
+    request.program = glCreateProgram();
+    glProgramBinary(request.program, header.binaryFormat, binary.data(), header.binaryLength);
+    int success = 0;
+    glGetProgramiv(request.program, GL_LINK_STATUS, &success);
+    if (success)
+        return true;
+
+    // Drivers may reject binaries from an older build even when the version string matches
+    std::cerr << "Shader '" << request.name << "': cached binary rejected by the driver, recompiling" << std::endl;
+    glDeleteProgram(request.program);
+    request.program = 0;
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+    return false;
+}
+
+void ShaderManager::saveBinary(const Pending &request)
+{
+    int length = 0;
+    glGetProgramiv(request.program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(request.program, length, &length, &format, binary.data());
+    if (length <= 0)
+        return;
+
+    ShaderBinaryHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, SHADER_BINARY_MAGIC, 4);
+    header.version = SHADER_BINARY_VERSION;
+    header.binaryFormat = format;
+    header.binaryLength = static_cast<uint32_t>(length);
+    header.driverHash = driverHash;
+    header.sourceHash = request.sourceHash;
+
+    std::error_code ec;
+    std::filesystem::create_directories(SHADER_CACHE_DIR, ec);
+
+    // Write to a temporary name so an interrupted run never leaves a truncated binary behind
+    std::string path = binaryPath(request);
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            std::cerr << "Cannot write shader cache: " << path << std::endl;
+            return;
+        }
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(binary.data(), length);
+        if (!out)
+            return;
+    }
+    std::filesystem::rename(tempPath, path, ec);
+}
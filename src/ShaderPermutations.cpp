@@ -0,0 +1,216 @@
+#include "ShaderPermutations.h"
+#include <GL/glew.h>
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include "GLState.h"
+#include "TextureArrays.h"
+#include "VirtualFileSystem.h"
+
+static const unsigned int MAX_BONES = 100;
+
+ShaderPermutations &ShaderPermutations::Get()
+{
+    static ShaderPermutations instance;
+    return instance;
+}
+
+ShaderPermutations::ShaderPermutations()
+    : active(nullptr), frame(0), model(1.0f), normalMatrix(1.0f), color(1.0f), impostorFade(0.0f),
+      modelVersion(1), colorVersion(1), impostorFadeVersion(1), bonesVersion(1)
+{
+}
+
+void ShaderPermutations::load(const std::string &vertexPath, const std::string &fragmentPath)
+{
+    vertexSource = VirtualFileSystem::Get().readText(vertexPath);
+    fragmentSource = VirtualFileSystem::Get().readText(fragmentPath);
+    if (vertexSource.empty())
+        std::cerr << "Error: Shader file not found: '" << vertexPath << "'." << std::endl;
+    if (fragmentSource.empty())
+        std::cerr << "Error: Shader file not found: '" << fragmentPath << "'." << std::endl;
+    name = std::filesystem::path(vertexPath).stem().string() + "+" + std::filesystem::path(fragmentPath).stem().string();
+}
+
+// ===== Building =====
+// The defines go right after #version, which has to stay the first line
+std::string ShaderPermutations::withDefines(const std::string &source, unsigned int key) const
+{
+    std::string defines;
+    if (key & SHADER_SKINNED)
+        defines += "#define SKINNED\n";
+    if (key & (SHADER_TEXTURED | SHADER_TEXTURE_ARRAY))
+        defines += "#define TEXTURED\n";
+    if (key & SHADER_TEXTURE_ARRAY)
+        defines += "#define TEXTURE_ARRAY\n";
+    if (key & SHADER_INSTANCED)
+        defines += "#define INSTANCED\n";
+    if (key & SHADER_DITHER_FADE)
+        defines += "#define DITHER_FADE\n";
+
+    size_t versionLine = source.find("#version");
+    if (versionLine == std::string::npos)
+        return defines + source;
+    size_t lineEnd = source.find('\n', versionLine);
+    if (lineEnd == std::string::npos)
+        return source + "\n" + defines;
+    return source.substr(0, lineEnd + 1) + defines + source.substr(lineEnd + 1);
+}
+
+void ShaderPermutations::start(unsigned int key, Variant &variant)
+{
+    variant.pendingBuild = ShaderManager::Get().begin(name + ".k" + std::to_string(key), withDefines(vertexSource, key),
+                                                      withDefines(fragmentSource, key));
+}
+
+void ShaderPermutations::finish(Variant &variant)
+{
+    variant.program.attach(ShaderManager::Get().finish(variant.pendingBuild));
+    variant.pendingBuild = -1;
+    if (variant.program.id() == 0)
+        return;
+
+    variant.modelSlot = variant.program.slot("model");
+    variant.normalMatrixSlot = variant.program.slot("normalMatrix");
+    variant.colorSlot = variant.program.slot("objectColor");
+    variant.impostorFadeSlot = variant.program.slot("impostorFade");
+    variant.bonesSlot = variant.program.slot("gBones");
+
+    // Sampler units never change, so they are set once here rather than per draw
+    GLState::Get().useProgram(variant.program.id());
+    variant.program.set("texture_diffuse1", 0);
+    TextureArrays::Get().bind(variant.program);
+    if (active && active->program.id() != 0)
+        GLState::Get().useProgram(active->program.id());
+}
+
+void ShaderPermutations::prepare(const std::vector<unsigned int> &keys)
+{
+    for (unsigned int key : keys)
+    {
+        Variant &variant = variants[key];
+        if (variant.program.id() == 0 && variant.pendingBuild < 0)
+            start(key, variant);
+    }
+}
+
+void ShaderPermutations::finishPending()
+{
+    for (auto &item : variants)
+    {
+        if (item.second.pendingBuild >= 0)
+            finish(item.second);
+    }
+}
+
+// ===== Drawing =====
+void ShaderPermutations::beginFrame(std::function<void(ShaderProgram &program)> setup)
+{
+    frameSetup = std::move(setup);
+    frame++;
+    // Other code may have bound its own program since the last frame
+    active = nullptr;
+}
+
+ShaderProgram *ShaderPermutations::use(unsigned int key)
+{
+    Variant &variant = variants[key];
+    if (variant.program.id() == 0)
+    {
+        if (variant.pendingBuild < 0)
+            start(key, variant);
+        finish(variant);
+        if (variant.program.id() == 0)
+            return nullptr;
+    }
+
+    GLState::Get().useProgram(variant.program.id());
+    active = &variant;
+    if (variant.frame != frame)
+    {
+        variant.frame = frame;
+        if (frameSetup)
+            frameSetup(variant.program);
+    }
+    if (variant.modelVersion != modelVersion)
+        uploadModel(variant);
+    if (variant.colorVersion != colorVersion)
+        uploadColor(variant);
+    if ((key & SHADER_DITHER_FADE) && variant.impostorFadeVersion != impostorFadeVersion)
+        uploadImpostorFade(variant);
+    if ((key & SHADER_SKINNED) && variant.bonesVersion != bonesVersion)
+        uploadBones(variant);
+    return &variant.program;
+}
+
+void ShaderPermutations::uploadModel(Variant &variant)
+{
+    variant.program.set(variant.modelSlot, model);
+    variant.program.set(variant.normalMatrixSlot, normalMatrix);
+    variant.modelVersion = modelVersion;
+}
+
+void ShaderPermutations::uploadColor(Variant &variant)
+{
+    variant.program.set(variant.colorSlot, color);
+    variant.colorVersion = colorVersion;
+}
+
+void ShaderPermutations::uploadImpostorFade(Variant &variant)
+{
+    variant.program.set(variant.impostorFadeSlot, impostorFade);
+    variant.impostorFadeVersion = impostorFadeVersion;
+}
+
+void ShaderPermutations::uploadBones(Variant &variant)
+{
+    if (!bones.empty())
+        variant.program.set(variant.bonesSlot, bones.data(), static_cast<int>(bones.size()));
+    variant.bonesVersion = bonesVersion;
+}
+
+void ShaderPermutations::setModel(const glm::mat4 &value)
+{
+    model = value;
+    // Computed once per object here instead of once per vertex in the shader
+    normalMatrix = glm::transpose(glm::inverse(glm::mat3(value)));
+    modelVersion++;
+    if (active)
+        uploadModel(*active);
+}
+
+void ShaderPermutations::setColor(const glm::vec3 &value)
+{
+    color = value;
+    colorVersion++;
+    if (active)
+        uploadColor(*active);
+}
+
+void ShaderPermutations::setImpostorFade(float value)
+{
+    impostorFade = value;
+    impostorFadeVersion++;
+    if (active)
+        uploadImpostorFade(*active);
+}
+
+void ShaderPermutations::setBones(const glm::mat4 *values, size_t count)
+{
+    bones.assign(values, values + std::min<size_t>(count, MAX_BONES));
+    bonesVersion++;
+    if (active)
+        uploadBones(*active);
+}
+
+void ShaderPermutations::shutdown()
+{
+    finishPending();
+    for (auto &item : variants)
+    {
+        if (item.second.program.id() != 0)
+            glDeleteProgram(item.second.program.id());
+    }
+    variants.clear();
+    active = nullptr;
+}
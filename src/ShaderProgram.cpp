@@ -0,0 +1,164 @@
+#include "ShaderProgram.h"
+#include <GL/glew.h>
+#include <algorithm>
+#include <cstring>
+#include <glm/gtc/type_ptr.hpp>
+
+static ShaderProgram::Stats frameStats;
+static ShaderProgram::Stats lastFrameStats;
+
+// Bytes of one element of a uniform type, as the shadow stores it
+static size_t typeBytes(GLenum type)
+{
+    switch (type)
+    {
+    case GL_FLOAT_VEC2:
+    case GL_INT_VEC2:
+    case GL_BOOL_VEC2:
+        return 8;
+    case GL_FLOAT_VEC3:
+    case GL_INT_VEC3:
+    case GL_BOOL_VEC3:
+        return 12;
+    case GL_FLOAT_VEC4:
+    case GL_INT_VEC4:
+    case GL_BOOL_VEC4:
+    case GL_FLOAT_MAT2:
+        return 16;
+    case GL_FLOAT_MAT3:
+        return 36;
+    case GL_FLOAT_MAT4:
+        return 64;
+    default:
+        return 4; // Scalars, bools and samplers
+    }
+}
+
+void ShaderProgram::attach(unsigned int id)
+{
+    program = id;
+    uniforms.clear();
+    slots.clear();
+    shadow.clear();
+    if (program == 0)
+        return;
+
+    GLint count = 0;
+    GLint maxLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<char> nameBuffer(std::max(maxLength, 1));
+    for (GLint i = 0; i < count; i++)
+    {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(program, static_cast<GLuint>(i), static_cast<GLsizei>(nameBuffer.size()), &length, &size, &type,
+                           nameBuffer.data());
+        std::string name(nameBuffer.data(), length);
+        int location = glGetUniformLocation(program, name.c_str());
+        if (location < 0)
+            continue; // Members of uniform blocks
+
+        // Arrays are reported as "name[0]"; callers use the bare name
+        size_t bracket = name.find('[');
+        if (bracket != std::string::npos)
+            name.erase(bracket);
+
+        Uniform uniform;
+        uniform.location = location;
+        uniform.offset = shadow.size();
+        uniform.bytes = typeBytes(type) * static_cast<size_t>(std::max(size, 1));
+        uniform.knownBytes = 0;
+        shadow.resize(shadow.size() + uniform.bytes);
+        slots[name] = static_cast<int>(uniforms.size());
+        uniforms.push_back(uniform);
+    }
+}
+
+int ShaderProgram::slot(const std::string &name) const
+{
+    auto found = slots.find(name);
+    return found == slots.end() ? -1 : found->second;
+}
+
+bool ShaderProgram::changed(int slot, const void *data, size_t bytes)
+{
+    if (slot < 0 || slot >= static_cast<int>(uniforms.size()))
+        return false;
+
+    Uniform &uniform = uniforms[slot];
+    bytes = std::min(bytes, uniform.bytes);
+    unsigned char *held = shadow.data() + uniform.offset;
+    if (bytes <= uniform.knownBytes && std::memcmp(held, data, bytes) == 0)
+    {
+        frameStats.skipped++;
+        return false;
+    }
+
+    // A partial array upload leaves the tail as it was, in the program and in the shadow alike
+    std::memcpy(held, data, bytes);
+    uniform.knownBytes = std::max(uniform.knownBytes, bytes);
+    frameStats.issued++;
+    return true;
+}
+
+// ===== Setters =====
+void ShaderProgram::set(int slot, int value)
+{
+    if (changed(slot, &value, sizeof(value)))
+        glUniform1i(uniforms[slot].location, value);
+}
+
+void ShaderProgram::set(int slot, float value)
+{
+    if (changed(slot, &value, sizeof(value)))
+        glUniform1f(uniforms[slot].location, value);
+}
+
+void ShaderProgram::set(int slot, const glm::vec3 &value)
+{
+    if (changed(slot, glm::value_ptr(value), sizeof(value)))
+        glUniform3fv(uniforms[slot].location, 1, glm::value_ptr(value));
+}
+
+void ShaderProgram::set(int slot, const glm::mat3 &value)
+{
+    if (changed(slot, glm::value_ptr(value), sizeof(value)))
+        glUniformMatrix3fv(uniforms[slot].location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void ShaderProgram::set(int slot, const glm::mat4 &value)
+{
+    if (changed(slot, glm::value_ptr(value), sizeof(value)))
+        glUniformMatrix4fv(uniforms[slot].location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void ShaderProgram::set(int slot, const glm::vec3 *values, int count)
+{
+    if (count > 0 && changed(slot, glm::value_ptr(values[0]), sizeof(glm::vec3) * count))
+        glUniform3fv(uniforms[slot].location, count, glm::value_ptr(values[0]));
+}
+
+void ShaderProgram::set(int slot, const glm::mat4 *values, int count)
+{
+    if (count > 0 && changed(slot, glm::value_ptr(values[0]), sizeof(glm::mat4) * count))
+        glUniformMatrix4fv(uniforms[slot].location, count, GL_FALSE, glm::value_ptr(values[0]));
+}
+
+// ===== Stats =====
+ShaderProgram::Stats &ShaderProgram::FrameStats()
+{
+    return frameStats;
+}
+
+const ShaderProgram::Stats &ShaderProgram::LastFrameStats()
+{
+    return lastFrameStats;
+}
+
+void ShaderProgram::EndFrame()
+{
+    lastFrameStats = frameStats;
+    frameStats = Stats();
+}
@@ -1,14 +1,19 @@
 #include "Skybox.h"
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <vector>
 #include <cmath>
 #include <algorithm>
-#include <glm/gtc/type_ptr.hpp>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 
 // STB_IMAGE_IMPLEMENTATION is now in stb_image_impl.cpp
 #include "../third_party/stb_image.h"
+#include "ImageRows.h"
+#include "GLState.h"
+#include "ShaderManager.h"
+#include "VirtualFileSystem.h"
 
 // Skybox cube vertices
 float skyboxVertices[] = {
@@ -55,22 +60,56 @@ float skyboxVertices[] = {
     -1.0f, -1.0f, 1.0f,
     1.0f, -1.0f, 1.0f};
 
-Skybox::Skybox(const std::string &hdrPath)
-    : cubemapTexture(0), skyboxVAO(0), skyboxVBO(0), shaderProgram(0),
-      hdrData(nullptr), hdrWidth(0), hdrHeight(0), hdrChannels(0),
+Skybox::Skybox()
+    : cubemapTexture(0), cubemapSize(0), skyboxVAO(0), skyboxVBO(0),
       rotationAngle(0.0f), rotationSpeed(0.02f) // Slow rotation for cloud movement effect
 {
-    loadHDRTexture(hdrPath);
-    convertEquirectangularToCubemap();
-    setupSkyboxCube();
-    shaderProgram = compileSkyboxShader();
+}
 
-    // Clean up HDR data after conversion
-    if (hdrData)
+Skybox::Skybox(const std::string &hdrPath)
+    : Skybox()
+{
+    load(hdrPath);
+    createResources();
+}
+
+void Skybox::load(const std::string &hdrPath)
+{
+    // A cached conversion skips the HDR decode and the six-face render entirely
+    cubemapCachePath = getCachePath(hdrPath);
+    if (cubemapCachePath.empty() || !mapCachedCubemap(cubemapCachePath))
+        loadHDRTexture(hdrPath);
+
+    // SH irradiance and prefiltered reflections, cached next to the cubemap
+    if (!cubemapCachePath.empty())
+        environment.preload(cubemapCachePath.substr(0, cubemapCachePath.size() - 5) + ".env");
+}
+
+void Skybox::createResources()
+{
+    if (cachedCubemap)
     {
-        stbi_image_free(hdrData);
-        hdrData = nullptr;
+        uploadCachedCubemap();
     }
+    else
+    {
+        convertEquirectangularToCubemap();
+        if (!cubemapCachePath.empty())
+            saveCachedCubemap(cubemapCachePath);
+    }
+
+    std::string environmentCachePath;
+    if (!cubemapCachePath.empty())
+        environmentCachePath = cubemapCachePath.substr(0, cubemapCachePath.size() - 5) + ".env";
+    environment.build(cubemapTexture, cubemapSize, environmentCachePath);
+
+    if (skyboxVAO == 0)
+        setupSkyboxCube();
+    skyboxShader.attach(compileSkyboxShader());
+
+    // Clean up HDR data after conversion
+    hdrImage.pixels.clear();
+    hdrImage.pixels.shrink_to_fit();
 }
 
 Skybox::~Skybox()
@@ -81,59 +120,78 @@ Skybox::~Skybox()
         glDeleteVertexArrays(1, &skyboxVAO);
     if (skyboxVBO != 0)
         glDeleteBuffers(1, &skyboxVBO);
-    if (shaderProgram != 0)
-        glDeleteProgram(shaderProgram);
-    if (hdrData)
-        stbi_image_free(hdrData);
+    if (skyboxShader.id() != 0)
+        glDeleteProgram(skyboxShader.id());
+    if (gradientShader.id() != 0)
+        glDeleteProgram(gradientShader.id());
 }
 
-void Skybox::loadHDRTexture(const std::string &path)
+// Calculate cubemap size based on input resolution, but cap at reasonable maximum
+// For 2K HDR (2048x1024), use 512; for 4K (4096x2048), use 1024; for 8K (8192x4096), use 2048
+static int cubemapSizeFor(int sourceWidth)
 {
-    // Try multiple paths (depending on where executable is run from)
-    std::vector<std::string> pathsToTry = {
-        path,            // Original path
-        "../" + path,    // One level up (if run from build/)
-        "../../" + path, // Two levels up
-        "images/" + (path.find("images/") != std::string::npos ? path.substr(path.find("images/") + 7) : path)};
+    int size = std::min(2048, std::max(512, sourceWidth / 4));
+    // Round to nearest power of 2 for better GPU performance
+    int powerOf2 = 512;
+    while (powerOf2 < size && powerOf2 < 2048)
+        powerOf2 *= 2;
+    return powerOf2;
+}
 
-    stbi_set_flip_vertically_on_load(true);
+// Widest equirect the conversion is fed. Enough for the largest cubemap face
+// while keeping the decoded image around 48 MB of half floats.
+static const int MAX_EQUIRECT_WIDTH = 4096;
 
-    for (const auto &tryPath : pathsToTry)
+void Skybox::loadHDRTexture(const std::string &path)
+{
+    AssetData asset = VirtualFileSystem::Get().open(path);
+    if (!asset.valid())
     {
-        hdrData = stbi_loadf(tryPath.c_str(), &hdrWidth, &hdrHeight, &hdrChannels, 0);
-        if (hdrData)
-        {
-            std::cout << "Loaded HDR from: " << tryPath << std::endl;
-            std::cout << "HDR dimensions: " << hdrWidth << "x" << hdrHeight << " channels: " << hdrChannels << std::endl;
-            return;
-        }
+        std::cerr << "Failed to load HDR image: " << path << std::endl;
+        return;
     }
 
-    std::cerr << "Failed to load HDR image. Tried paths:" << std::endl;
-    for (const auto &tryPath : pathsToTry)
+    // Stream scanlines straight out of the mapped file instead of decoding the full 16k image
+    if (HdrDecoder::Decode(asset.data(), asset.size(), MAX_EQUIRECT_WIDTH, hdrImage))
     {
-        std::cerr << "  - " << tryPath << std::endl;
+        std::cout << "Loaded HDR from: " << VirtualFileSystem::Get().resolve(path) << std::endl;
+        return;
     }
+
+    // Fallback for files the streaming decoder rejects: full stb decode, converted to half floats
+    int width, height, channels;
+    float *data = stbi_loadf_from_memory(asset.data(), static_cast<int>(asset.size()), &width, &height, &channels, 3);
+    if (!data)
+    {
+        std::cerr << "Failed to load HDR image: " << path << std::endl;
+        return;
+    }
+    // Bottom row first, as HdrDecoder writes it
+    FlipImageRows(data, width, height, 3);
+
+    hdrImage.width = hdrImage.sourceWidth = width;
+    hdrImage.height = hdrImage.sourceHeight = height;
+    hdrImage.pixels.resize(static_cast<size_t>(width) * height * 3);
+    for (size_t i = 0; i < hdrImage.pixels.size(); i++)
+        hdrImage.pixels[i] = HdrDecoder::FloatToHalf(data[i]);
+    stbi_image_free(data);
+
+    std::cout << "Loaded HDR from: " << VirtualFileSystem::Get().resolve(path) << " (stb fallback)" << std::endl;
+    std::cout << "HDR dimensions: " << width << "x" << height << std::endl;
 }
 
 void Skybox::convertEquirectangularToCubemap()
 {
-    if (!hdrData || hdrWidth == 0 || hdrHeight == 0)
+    if (hdrImage.pixels.empty() || hdrImage.width == 0 || hdrImage.height == 0)
     {
         std::cerr << "Cannot convert: HDR data not loaded" << std::endl;
         return;
     }
 
-    // Calculate cubemap size based on input resolution, but cap at reasonable maximum
-    // For 2K HDR (2048x1024), use 512; for 4K (4096x2048), use 1024; for 8K (8192x4096), use 2048
-    int cubemapSize = std::min(2048, std::max(512, hdrWidth / 4));
-    // Round to nearest power of 2 for better GPU performance
-    int powerOf2 = 512;
-    while (powerOf2 < cubemapSize && powerOf2 < 2048)
-        powerOf2 *= 2;
-    cubemapSize = powerOf2;
+    // Sized from the source file, not the filtered equirect
+    cubemapSize = cubemapSizeFor(hdrImage.sourceWidth);
 
-    std::cout << "Converting HDR (" << hdrWidth << "x" << hdrHeight << ") to cubemap ("
+    std::cout << "Converting HDR (" << hdrImage.width << "x" << hdrImage.height << ") to cubemap ("
               << cubemapSize << "x" << cubemapSize << " per face)" << std::endl;
 
     // Create framebuffer for rendering to cubemap
@@ -146,18 +204,19 @@ void Skybox::convertEquirectangularToCubemap()
     glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, cubemapSize, cubemapSize);
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, captureRBO);
 
-    // Generate cubemap texture
+    // Generate cubemap texture. R11F_G11F_B10F packs a texel into 4 bytes instead of 6-8 for RGB16F
+    // and is color-renderable, so the faces can be rendered into directly.
     glGenTextures(1, &cubemapTexture);
     glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
     for (unsigned int i = 0; i < 6; ++i)
     {
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F,
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_R11F_G11F_B10F,
                      cubemapSize, cubemapSize, 0, GL_RGB, GL_FLOAT, nullptr);
     }
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
     // Create equirectangular to cubemap conversion shader
@@ -193,28 +252,16 @@ void main() {
 )";
 
     // Compile conversion shader
-    unsigned int equirectProgram = 0;
-    unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &equirectVertexShader, NULL);
-    glCompileShader(vertexShader);
-
-    unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &equirectFragmentShader, NULL);
-    glCompileShader(fragmentShader);
-
-    equirectProgram = glCreateProgram();
-    glAttachShader(equirectProgram, vertexShader);
-    glAttachShader(equirectProgram, fragmentShader);
-    glLinkProgram(equirectProgram);
-
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    unsigned int equirectProgram = ShaderManager::Get().createProgram("skybox_equirect", equirectVertexShader,
+                                                                      equirectFragmentShader);
 
     // Create equirectangular HDR texture
     unsigned int hdrTexture;
     glGenTextures(1, &hdrTexture);
     glBindTexture(GL_TEXTURE_2D, hdrTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, hdrWidth, hdrHeight, 0, GL_RGB, GL_FLOAT, hdrData);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, hdrImage.width, hdrImage.height, 0, GL_RGB, GL_HALF_FLOAT, hdrImage.pixels.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -241,8 +288,9 @@ void main() {
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
 
     // Convert HDR equirectangular to cubemap
+    ShaderProgram equirect(equirectProgram);
     glUseProgram(equirectProgram);
-    glUniform1i(glGetUniformLocation(equirectProgram, "equirectangularMap"), 0);
+    equirect.set("equirectangularMap", 0);
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, hdrTexture);
 
@@ -254,8 +302,8 @@ void main() {
     glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
     for (unsigned int i = 0; i < 6; ++i)
     {
-        glUniformMatrix4fv(glGetUniformLocation(equirectProgram, "projection"), 1, GL_FALSE, glm::value_ptr(captureProjection));
-        glUniformMatrix4fv(glGetUniformLocation(equirectProgram, "view"), 1, GL_FALSE, glm::value_ptr(captureViews[i]));
+        equirect.set("projection", captureProjection);
+        equirect.set("view", captureViews[i]);
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, cubemapTexture, 0);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         glBindVertexArray(cubeVAO);
@@ -264,6 +312,10 @@ void main() {
     glBindVertexArray(0);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
+    // Mips for minified sampling and for the cache
+    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+
     // Restore viewport (if it was set, otherwise framebuffer_size_callback will set it)
     if (viewport[2] > 0 && viewport[3] > 0)
     {
@@ -281,93 +333,202 @@ void main() {
     std::cout << "Converted HDR equirectangular to cubemap" << std::endl;
 }
 
-void Skybox::setupSkyboxCube()
+// ===== Cubemap Cache =====
+// File layout: CubemapCacheHeader, then every mip level (largest first), six
+// faces per level in GL face order, packed GL_UNSIGNED_INT_10F_11F_11F_REV texels.
+// The source HDR's fingerprint is part of the file name, so the header does not repeat it.
+static const char CUBEMAP_CACHE_MAGIC[4] = {'S', 'C', 'C', 'B'};
+static const uint32_t CUBEMAP_CACHE_VERSION = 2;
+static const char *CUBEMAP_CACHE_DIR = "cache";
+
+struct CubemapCacheHeader
 {
-    glGenVertexArrays(1, &skyboxVAO);
-    glGenBuffers(1, &skyboxVBO);
-    glBindVertexArray(skyboxVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), skyboxVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
-    glBindVertexArray(0);
+    char magic[4];
+    uint32_t version;
+    uint32_t faceSize;
+    uint32_t mipCount;
+    uint32_t internalFormat;
+    uint32_t reserved;
+};
+
+static uint32_t mipCountFor(int size)
+{
+    uint32_t count = 1;
+    while ((size >> count) > 0)
+        count++;
+    return count;
 }
 
-static std::string loadShaderSource(const std::string &path)
+static size_t cubemapCacheSize(int faceSize, uint32_t mipCount)
 {
-    std::ifstream file(path);
-    if (!file.is_open())
-        file.open("../" + path);
-
-    if (!file.is_open())
+    size_t bytes = sizeof(CubemapCacheHeader);
+    for (uint32_t mip = 0; mip < mipCount; mip++)
     {
-        std::cerr << "Error: Shader file not found at '" << path << "' or '../" << path << "'." << std::endl;
+        size_t edge = static_cast<size_t>(std::max(1, faceSize >> mip));
+        bytes += 6 * edge * edge * sizeof(uint32_t);
+    }
+    return bytes;
+}
+
+std::string Skybox::getCachePath(const std::string &hdrPath)
+{
+    // Only the header is needed to know the face size, the mapping touches a single page
+    AssetData asset = VirtualFileSystem::Get().open(hdrPath);
+    int width = 0, height = 0;
+    if (!asset.valid() || !HdrDecoder::ReadDimensions(asset.data(), asset.size(), width, height))
         return "";
+
+    uint64_t fingerprint = VirtualFileSystem::Get().fingerprint(hdrPath);
+    int size = cubemapSizeFor(width);
+
+    char name[96];
+    std::snprintf(name, sizeof(name), "skybox_%016llx_%d_v%u.cube",
+                  static_cast<unsigned long long>(fingerprint), size, CUBEMAP_CACHE_VERSION);
+    return std::string(CUBEMAP_CACHE_DIR) + "/" + name;
+}
+
+bool Skybox::mapCachedCubemap(const std::string &cachePath)
+{
+    std::unique_ptr<MappedFile> mapping(new MappedFile());
+    MappedFile &file = *mapping;
+    if (!file.open(cachePath))
+        return false;
+
+    CubemapCacheHeader header;
+    if (file.size() < sizeof(header))
+        return false;
+    std::memcpy(&header, file.data(), sizeof(header));
+
+    if (std::memcmp(header.magic, CUBEMAP_CACHE_MAGIC, 4) != 0 || header.version != CUBEMAP_CACHE_VERSION ||
+        header.internalFormat != GL_R11F_G11F_B10F || header.faceSize == 0 ||
+        header.mipCount != mipCountFor(static_cast<int>(header.faceSize)) ||
+        file.size() != cubemapCacheSize(static_cast<int>(header.faceSize), header.mipCount))
+    {
+        std::cerr << "Ignoring stale skybox cache: " << cachePath << std::endl;
+        return false;
     }
 
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    return buffer.str();
+    // Touch every page here so the GL upload does not stall on disk reads
+    volatile unsigned char sink = 0;
+    for (size_t offset = 0; offset < file.size(); offset += 4096)
+        sink = sink + file.data()[offset];
+
+    cachedCubemap = std::move(mapping);
+    return true;
 }
 
-unsigned int Skybox::compileSkyboxShader()
+void Skybox::uploadCachedCubemap()
 {
-    std::string vertexCode = loadShaderSource("../shaders/skybox_vertex.glsl");
-    std::string fragmentCode = loadShaderSource("../shaders/skybox_fragment.glsl");
+    const MappedFile &file = *cachedCubemap;
+    CubemapCacheHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+
+    cubemapSize = static_cast<int>(header.faceSize);
+    glGenTextures(1, &cubemapTexture);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
-    if (vertexCode.empty() || fragmentCode.empty())
+    const unsigned char *texels = file.data() + sizeof(header);
+    for (uint32_t mip = 0; mip < header.mipCount; mip++)
     {
-        std::cerr << "Failed to load skybox shaders" << std::endl;
-        return 0;
+        int edge = std::max(1, cubemapSize >> mip);
+        size_t faceBytes = static_cast<size_t>(edge) * edge * sizeof(uint32_t);
+        for (unsigned int i = 0; i < 6; ++i)
+        {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, mip, GL_R11F_G11F_B10F,
+                         edge, edge, 0, GL_RGB, GL_UNSIGNED_INT_10F_11F_11F_REV, texels);
+            texels += faceBytes;
+        }
     }
 
-    const char *vShaderCode = vertexCode.c_str();
-    const char *fShaderCode = fragmentCode.c_str();
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, header.mipCount - 1);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
 
-    unsigned int vertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex, 1, &vShaderCode, NULL);
-    glCompileShader(vertex);
+    std::cout << "Loaded skybox cubemap from cache: " << cubemapCachePath << " (" << cubemapSize << "x" << cubemapSize
+              << ", " << file.size() / (1024 * 1024) << " MB)" << std::endl;
+    cachedCubemap.reset();
+}
 
-    // Check compilation
-    int success;
-    char infoLog[512];
-    glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
-    if (!success)
+void Skybox::saveCachedCubemap(const std::string &cachePath)
+{
+    if (cubemapTexture == 0 || cubemapSize == 0)
+        return;
+
+    std::error_code ec;
+    std::filesystem::create_directories(CUBEMAP_CACHE_DIR, ec);
+
+    CubemapCacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, CUBEMAP_CACHE_MAGIC, 4);
+    header.version = CUBEMAP_CACHE_VERSION;
+    header.faceSize = static_cast<uint32_t>(cubemapSize);
+    header.mipCount = mipCountFor(cubemapSize);
+    header.internalFormat = GL_R11F_G11F_B10F;
+
+    // Write to a temporary name so an interrupted run never leaves a truncated cache behind
+    std::string tempPath = cachePath + ".tmp";
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    if (!out)
     {
-        glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-        std::cerr << "Skybox vertex shader compilation failed:\n"
-                  << infoLog << std::endl;
+        std::cerr << "Cannot write skybox cache: " << cachePath << std::endl;
+        return;
     }
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
 
-    unsigned int fragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment, 1, &fShaderCode, NULL);
-    glCompileShader(fragment);
-
-    glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
-    if (!success)
+    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    std::vector<uint32_t> texels(static_cast<size_t>(cubemapSize) * cubemapSize);
+    for (uint32_t mip = 0; mip < header.mipCount; mip++)
     {
-        glGetShaderInfoLog(fragment, 512, NULL, infoLog);
-        std::cerr << "Skybox fragment shader compilation failed:\n"
-                  << infoLog << std::endl;
+        int edge = std::max(1, cubemapSize >> mip);
+        size_t faceBytes = static_cast<size_t>(edge) * edge * sizeof(uint32_t);
+        for (unsigned int i = 0; i < 6; ++i)
+        {
+            glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, mip, GL_RGB, GL_UNSIGNED_INT_10F_11F_11F_REV, texels.data());
+            out.write(reinterpret_cast<const char *>(texels.data()), faceBytes);
+        }
     }
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
 
-    unsigned int program = glCreateProgram();
-    glAttachShader(program, vertex);
-    glAttachShader(program, fragment);
-    glLinkProgram(program);
+    out.close();
+    if (!out)
+    {
+        std::cerr << "Cannot write skybox cache: " << cachePath << std::endl;
+        std::filesystem::remove(tempPath, ec);
+        return;
+    }
 
-    glGetProgramiv(program, GL_LINK_STATUS, &success);
-    if (!success)
+    std::filesystem::rename(tempPath, cachePath, ec);
+    if (ec)
     {
-        glGetProgramInfoLog(program, 512, NULL, infoLog);
-        std::cerr << "Skybox shader linking failed:\n"
-                  << infoLog << std::endl;
+        std::cerr << "Cannot write skybox cache: " << cachePath << " (" << ec.message() << ")" << std::endl;
+        std::filesystem::remove(tempPath, ec);
+        return;
     }
+    std::cout << "Saved skybox cubemap cache: " << cachePath << std::endl;
+}
 
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
+void Skybox::setupSkyboxCube()
+{
+    glGenVertexArrays(1, &skyboxVAO);
+    glGenBuffers(1, &skyboxVBO);
+    glBindVertexArray(skyboxVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), skyboxVertices, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
+    glBindVertexArray(0);
+}
 
-    return program;
+unsigned int Skybox::compileSkyboxShader()
+{
+    return ShaderManager::Get().createProgramFromFiles("../shaders/skybox_vertex.glsl", "../shaders/skybox_fragment.glsl");
 }
 
 void Skybox::Update(float deltaTime)
@@ -378,37 +539,95 @@ void Skybox::Update(float deltaTime)
         rotationAngle -= 2.0f * 3.14159265359f;
 }
 
-void Skybox::Draw(const glm::mat4 &view, const glm::mat4 &projection, float deltaTime)
+glm::mat3 Skybox::getEnvironmentRotation() const
 {
-    if (shaderProgram == 0 || cubemapTexture == 0)
-        return;
+    // Draw spins the cube by rotationAngle, so world directions are rotated back before sampling it
+    glm::mat4 rotation = glm::rotate(glm::mat4(1.0f), -rotationAngle, glm::vec3(0.0f, 1.0f, 0.0f));
+    return glm::mat3(rotation);
+}
 
+void Skybox::Draw(const glm::mat4 &view, const glm::mat4 &projection, float deltaTime)
+{
     // Update rotation
     if (deltaTime > 0.0f)
         Update(deltaTime);
 
+    if (!isReady())
+    {
+        drawGradient(view, projection);
+        return;
+    }
+
     // Change depth function so depth test passes at 1.0
-    glDepthFunc(GL_LEQUAL);
-    glUseProgram(shaderProgram);
+    GLState &state = GLState::Get();
+    state.setDepthFunc(GL_LEQUAL);
+    state.useProgram(skyboxShader.id());
 
     // Remove translation from view matrix and apply rotation around Y axis
     glm::mat4 viewNoTranslation = glm::mat4(glm::mat3(view));
     glm::mat4 rotation = glm::rotate(glm::mat4(1.0f), rotationAngle, glm::vec3(0.0f, 1.0f, 0.0f));
     viewNoTranslation = viewNoTranslation * rotation;
 
-    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(viewNoTranslation));
-    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+    skyboxShader.set("view", viewNoTranslation);
+    skyboxShader.set("projection", projection);
 
     // Bind cubemap texture
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-    glUniform1i(glGetUniformLocation(shaderProgram, "skybox"), 0);
+    state.bindTexture(0, GL_TEXTURE_CUBE_MAP, cubemapTexture);
+    skyboxShader.set("skybox", 0);
 
     // Draw skybox
-    glBindVertexArray(skyboxVAO);
+    state.bindVertexArray(skyboxVAO);
     glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
 
     // Reset depth function
-    glDepthFunc(GL_LESS);
+    state.setDepthFunc(GL_LESS);
+}
+
+// ===== Placeholder sky =====
+void Skybox::drawGradient(const glm::mat4 &view, const glm::mat4 &projection)
+{
+    if (gradientShader.id() == 0)
+    {
+        const char *gradientVertexShader = R"(
+#version 330 core
+layout (location = 0) in vec3 aPos;
+out vec3 WorldPos;
+uniform mat4 projection;
+uniform mat4 view;
+void main() {
+    WorldPos = aPos;
+    gl_Position = (projection * mat4(mat3(view)) * vec4(aPos, 1.0)).xyww;
+}
+)";
+
+        const char *gradientFragmentShader = R"(
+#version 330 core
+out vec4 FragColor;
+in vec3 WorldPos;
+void main() {
+    float height = normalize(WorldPos).y;
+    vec3 ground = vec3(0.32, 0.30, 0.27);
+    vec3 horizon = vec3(0.78, 0.84, 0.90);
+    vec3 zenith = vec3(0.30, 0.50, 0.80);
+    vec3 color = height < 0.0 ? mix(horizon, ground, clamp(-height * 4.0, 0.0, 1.0))
+                              : mix(horizon, zenith, sqrt(height));
+    FragColor = vec4(color, 1.0);
+}
+)";
+
+        gradientShader.attach(ShaderManager::Get().createProgram("skybox_gradient", gradientVertexShader, gradientFragmentShader));
+    }
+    if (skyboxVAO == 0)
+        setupSkyboxCube();
+
+    GLState &state = GLState::Get();
+    state.setDepthFunc(GL_LEQUAL);
+    state.useProgram(gradientShader.id());
+    gradientShader.set("view", view);
+    gradientShader.set("projection", projection);
+
+    state.bindVertexArray(skyboxVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 36);
+
+    state.setDepthFunc(GL_LESS);
 }
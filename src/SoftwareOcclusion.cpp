@@ -0,0 +1,385 @@
+#include "SoftwareOcclusion.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define SOFTWARE_OCCLUSION_SSE 1
+#endif
+
+static SoftwareOcclusion::Stats frameStats;
+static SoftwareOcclusion::Stats lastFrameStats;
+
+static const int TilesX = SoftwareOcclusion::Width / SoftwareOcclusion::TileSize;
+static const int TilesY = SoftwareOcclusion::Height / SoftwareOcclusion::TileSize;
+
+// Rock models don't fill their bounding boxes; a shrunk box stays inside the rock
+static const float OccluderShrink = 0.8f;
+
+// Corner indices of a box's twelve triangles; corner bit 0 is +x, bit 1 +y, bit 2 +z
+static const int BoxTriangles[12][3] = {
+    {0, 2, 3}, {0, 3, 1}, {4, 5, 7}, {4, 7, 6}, {0, 1, 5}, {0, 5, 4},
+    {2, 6, 7}, {2, 7, 3}, {0, 4, 6}, {0, 6, 2}, {1, 3, 7}, {1, 7, 5}};
+
+static float elapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+SoftwareOcclusion &SoftwareOcclusion::Get()
+{
+    static SoftwareOcclusion instance;
+    return instance;
+}
+
+SoftwareOcclusion::~SoftwareOcclusion()
+{
+    shutdown();
+}
+
+// ===== Workers =====
+void SoftwareOcclusion::start(unsigned int threadCount)
+{
+    if (running)
+        return;
+
+    // The buffer is small; more bands than this only add wake-ups
+    if (threadCount == 0)
+    {
+        unsigned int cores = std::thread::hardware_concurrency();
+        threadCount = std::min(cores > 1 ? cores - 1 : 1u, 3u);
+    }
+    bandCount = std::min(static_cast<int>(threadCount) + 1, TilesY);
+
+    depth.assign(Width * Height, 1.0f);
+    tileMax.assign(TilesX * TilesY, 1.0f);
+    stopping = false;
+    for (int band = 1; band < bandCount; band++)
+        workers.emplace_back(&SoftwareOcclusion::workerLoop, this, band);
+    running = true;
+
+    std::cout << "Software occlusion started: " << Width << "x" << Height << " depth buffer in " << bandCount
+              << " bands" << std::endl;
+}
+
+void SoftwareOcclusion::shutdown()
+{
+    if (!running)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    workReady.notify_all();
+    for (auto &worker : workers)
+        worker.join();
+    workers.clear();
+    running = false;
+    rendered = false;
+}
+
+void SoftwareOcclusion::workerLoop(int band)
+{
+    unsigned long seen = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            workReady.wait(lock, [&]() { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+        }
+
+        renderBand(band);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--bandsRemaining == 0)
+            workDone.notify_one();
+    }
+}
+
+// ===== Occluders =====
+void SoftwareOcclusion::clearOccluders()
+{
+    occluderCorners.clear();
+}
+
+void SoftwareOcclusion::addOccluder(const glm::mat4 &model, const glm::vec3 &localCenter, const glm::vec3 &localSize)
+{
+    glm::vec3 half = 0.5f * OccluderShrink * localSize;
+    for (int corner = 0; corner < 8; corner++)
+    {
+        glm::vec3 offset((corner & 1) ? half.x : -half.x, (corner & 2) ? half.y : -half.y, (corner & 4) ? half.z : -half.z);
+        occluderCorners.push_back(glm::vec3(model * glm::vec4(localCenter + offset, 1.0f)));
+    }
+}
+
+void SoftwareOcclusion::setupTriangles()
+{
+    triangles.clear();
+    std::vector<glm::vec4> clip(8);
+    for (size_t box = 0; box + 8 <= occluderCorners.size(); box += 8)
+    {
+        for (int corner = 0; corner < 8; corner++)
+            clip[corner] = viewProjection * glm::vec4(occluderCorners[box + corner], 1.0f);
+
+        for (const auto &indices : BoxTriangles)
+        {
+            // Clip against the near plane (z >= -w); a triangle becomes up to a quad
+            glm::vec4 polygon[4];
+            int count = 0;
+            for (int i = 0; i < 3; i++)
+            {
+                const glm::vec4 &a = clip[indices[i]];
+                const glm::vec4 &b = clip[indices[(i + 1) % 3]];
+                float da = a.z + a.w;
+                float db = b.z + b.w;
+                if (da >= 0.0f)
+                    polygon[count++] = a;
+                if ((da >= 0.0f) != (db >= 0.0f))
+                    polygon[count++] = a + (b - a) * (da / (da - db));
+            }
+            if (count < 3)
+                continue;
+
+            glm::vec3 screen[4];
+            for (int i = 0; i < count; i++)
+            {
+                float w = std::max(polygon[i].w, 1e-6f);
+                screen[i] = glm::vec3((polygon[i].x / w * 0.5f + 0.5f) * Width, (polygon[i].y / w * 0.5f + 0.5f) * Height,
+                                      polygon[i].z / w);
+            }
+            for (int i = 2; i < count; i++)
+                triangles.push_back({{screen[0], screen[i - 1], screen[i]}});
+        }
+    }
+    frameStats.occluderTriangles += triangles.size();
+}
+
+// ===== Rasterization =====
+void SoftwareOcclusion::render(const glm::mat4 &viewProjection)
+{
+    if (!running)
+        return;
+
+    auto start = std::chrono::steady_clock::now();
+    this->viewProjection = viewProjection;
+    setupTriangles();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        generation++;
+        bandsRemaining = bandCount - 1;
+    }
+    workReady.notify_all();
+    renderBand(0);
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        workDone.wait(lock, [this]() { return bandsRemaining == 0; });
+    }
+
+    rendered = true;
+    frameStats.rasterMs += elapsedMs(start);
+}
+
+void SoftwareOcclusion::renderBand(int band)
+{
+    // Bands are whole tile rows, so each reduces its own tiles
+    int tileBegin = band * TilesY / bandCount;
+    int tileEnd = (band + 1) * TilesY / bandCount;
+    int rowBegin = tileBegin * TileSize;
+    int rowEnd = tileEnd * TileSize;
+    std::fill(depth.begin() + rowBegin * Width, depth.begin() + rowEnd * Width, 1.0f);
+
+    for (const Triangle &triangle : triangles)
+    {
+        glm::vec3 v0 = triangle.v[0], v1 = triangle.v[1], v2 = triangle.v[2];
+        float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+        if (std::fabs(area) < 1e-6f)
+            continue;
+        // Both windings cover; counter-clockwise makes every edge function positive inside
+        if (area < 0.0f)
+        {
+            std::swap(v1, v2);
+            area = -area;
+        }
+
+        // Clamped as floats: vertices far off screen would overflow an int
+        int minX = static_cast<int>(std::max(0.0f, std::floor(std::min(v0.x, std::min(v1.x, v2.x)))));
+        int maxX = static_cast<int>(std::min(Width - 1.0f, std::ceil(std::max(v0.x, std::max(v1.x, v2.x)))));
+        int minY = static_cast<int>(std::max(static_cast<float>(rowBegin), std::floor(std::min(v0.y, std::min(v1.y, v2.y)))));
+        int maxY = static_cast<int>(std::min(rowEnd - 1.0f, std::ceil(std::max(v0.y, std::max(v1.y, v2.y)))));
+        if (minX > maxX || minY > maxY)
+            continue;
+
+        // Edge a->b: A*x + B*y + C, positive on the triangle's side
+        const glm::vec3 *edges[3][2] = {{&v0, &v1}, {&v1, &v2}, {&v2, &v0}};
+        float edgeA[3], edgeB[3], edgeC[3];
+        for (int e = 0; e < 3; e++)
+        {
+            const glm::vec3 &a = *edges[e][0];
+            const glm::vec3 &b = *edges[e][1];
+            edgeA[e] = a.y - b.y;
+            edgeB[e] = b.x - a.x;
+            edgeC[e] = a.x * b.y - a.y * b.x;
+        }
+        // Depth is linear in screen space
+        float dzdx = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+        float dzdy = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+        float depthC = v0.z - dzdx * v0.x - dzdy * v0.y;
+
+        minX &= ~3; // Aligned groups of four pixels; Width is a multiple of four
+        for (int y = minY; y <= maxY; y++)
+        {
+            float py = y + 0.5f;
+            float *row = &depth[y * Width];
+            int x = minX;
+#ifdef SOFTWARE_OCCLUSION_SSE
+            const __m128 laneOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+            const __m128 zero = _mm_setzero_ps();
+            for (; x <= maxX; x += 4)
+            {
+                __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffsets);
+                __m128 inside = _mm_cmpeq_ps(zero, zero);
+                for (int e = 0; e < 3; e++)
+                {
+                    __m128 value = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edgeA[e]), px), _mm_set1_ps(edgeB[e] * py + edgeC[e]));
+                    inside = _mm_and_ps(inside, _mm_cmpge_ps(value, zero));
+                }
+                if (_mm_movemask_ps(inside) == 0)
+                    continue;
+                __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(dzdx), px), _mm_set1_ps(dzdy * py + depthC));
+                __m128 current = _mm_loadu_ps(row + x);
+                __m128 nearer = _mm_min_ps(current, z);
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, current)));
+            }
+#endif
+            for (; x <= maxX; x++)
+            {
+                float px = x + 0.5f;
+                if (edgeA[0] * px + edgeB[0] * py + edgeC[0] < 0.0f || edgeA[1] * px + edgeB[1] * py + edgeC[1] < 0.0f ||
+                    edgeA[2] * px + edgeB[2] * py + edgeC[2] < 0.0f)
+                    continue;
+                row[x] = std::min(row[x], dzdx * px + dzdy * py + depthC);
+            }
+        }
+    }
+
+    // Farthest depth of each tile, so an occludee behind it is hidden without looking at pixels
+    for (int ty = tileBegin; ty < tileEnd; ty++)
+    {
+        for (int tx = 0; tx < TilesX; tx++)
+        {
+            float farthest = 0.0f;
+            for (int y = ty * TileSize; y < (ty + 1) * TileSize; y++)
+            {
+                const float *row = &depth[y * Width + tx * TileSize];
+#ifdef SOFTWARE_OCCLUSION_SSE
+                __m128 rowMax = _mm_max_ps(_mm_loadu_ps(row), _mm_loadu_ps(row + 4));
+                rowMax = _mm_max_ps(rowMax, _mm_shuffle_ps(rowMax, rowMax, _MM_SHUFFLE(1, 0, 3, 2)));
+                rowMax = _mm_max_ps(rowMax, _mm_shuffle_ps(rowMax, rowMax, _MM_SHUFFLE(2, 3, 0, 1)));
+                farthest = std::max(farthest, _mm_cvtss_f32(rowMax));
+#else
+                for (int x = 0; x < TileSize; x++)
+                    farthest = std::max(farthest, row[x]);
+#endif
+            }
+            tileMax[ty * TilesX + tx] = farthest;
+        }
+    }
+}
+
+// ===== Occludees =====
+bool SoftwareOcclusion::isVisible(const glm::vec3 &min, const glm::vec3 &max)
+{
+    if (!running || !rendered)
+        return true;
+
+    // Screen rectangle and nearest depth of the box; a corner at or behind the near plane
+    // means the camera is too close to say anything
+    float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, nearest = 1.0f;
+    for (int corner = 0; corner < 8; corner++)
+    {
+        glm::vec3 point((corner & 1) ? max.x : min.x, (corner & 2) ? max.y : min.y, (corner & 4) ? max.z : min.z);
+        glm::vec4 clip = viewProjection * glm::vec4(point, 1.0f);
+        if (clip.z < -clip.w || clip.w <= 1e-6f)
+            return true;
+        float x = (clip.x / clip.w * 0.5f + 0.5f) * Width;
+        float y = (clip.y / clip.w * 0.5f + 0.5f) * Height;
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        nearest = std::min(nearest, clip.z / clip.w);
+    }
+
+    frameStats.tested++;
+    int x0 = static_cast<int>(std::max(0.0f, std::floor(minX)));
+    int x1 = static_cast<int>(std::min(Width - 1.0f, std::ceil(maxX)));
+    int y0 = static_cast<int>(std::max(0.0f, std::floor(minY)));
+    int y1 = static_cast<int>(std::min(Height - 1.0f, std::ceil(maxY)));
+    if (x0 > x1 || y0 > y1)
+        return true; // Off screen; the frustum test has the final word
+
+    for (int ty = y0 / TileSize; ty <= y1 / TileSize; ty++)
+    {
+        for (int tx = x0 / TileSize; tx <= x1 / TileSize; tx++)
+        {
+            if (nearest > tileMax[ty * TilesX + tx])
+                continue;
+            // Some pixel of the tile is not in front; check the ones under the box
+            int rowBegin = std::max(y0, ty * TileSize), rowEnd = std::min(y1, (ty + 1) * TileSize - 1);
+            int columnBegin = std::max(x0, tx * TileSize), columnEnd = std::min(x1, (tx + 1) * TileSize - 1);
+            for (int y = rowBegin; y <= rowEnd; y++)
+            {
+                const float *row = &depth[y * Width];
+                for (int x = columnBegin; x <= columnEnd; x++)
+                {
+                    if (row[x] >= nearest)
+                        return true;
+                }
+            }
+        }
+    }
+    frameStats.rejected++;
+    return false;
+}
+
+void SoftwareOcclusion::test(const CullBounds &bounds, std::vector<uint8_t> &visible)
+{
+    if (!running || !rendered)
+        return;
+
+    auto start = std::chrono::steady_clock::now();
+    glm::vec3 min, max;
+    for (size_t i = 0; i < bounds.size() && i < visible.size(); i++)
+    {
+        if (!visible[i])
+            continue;
+        bounds.box(i, min, max);
+        if (!isVisible(min, max))
+            visible[i] = 0;
+    }
+    frameStats.testMs += elapsedMs(start);
+}
+
+// ===== Stats =====
+SoftwareOcclusion::Stats &SoftwareOcclusion::FrameStats()
+{
+    return frameStats;
+}
+
+const SoftwareOcclusion::Stats &SoftwareOcclusion::LastFrameStats()
+{
+    return lastFrameStats;
+}
+
+void SoftwareOcclusion::EndFrame()
+{
+    lastFrameStats = frameStats;
+    frameStats = Stats();
+}
@@ -0,0 +1,247 @@
+#include "StaticBVH.h"
+#include <algorithm>
+#include <limits>
+
+// SAH bins per axis, and the item count at or below which a node always becomes a leaf
+static const int SahBins = 12;
+static const uint32_t MinLeafItems = 2;
+
+// In double: unbounded placeholders (see CullBounds::addUnbounded) overflow a float area
+static double surfaceArea(const glm::vec3 &min, const glm::vec3 &max)
+{
+    double x = std::max(static_cast<double>(max.x) - min.x, 0.0);
+    double y = std::max(static_cast<double>(max.y) - min.y, 0.0);
+    double z = std::max(static_cast<double>(max.z) - min.z, 0.0);
+    return 2.0 * (x * y + y * z + z * x);
+}
+
+void StaticBVH::clear()
+{
+    nodes.clear();
+    items.clear();
+    itemBoxes.clear();
+}
+
+void StaticBVH::build(const std::vector<Box> &boxes)
+{
+    clear();
+    if (boxes.empty())
+        return;
+
+    itemBoxes = boxes;
+    std::vector<glm::vec3> centroids(boxes.size());
+    items.resize(boxes.size());
+    for (uint32_t i = 0; i < boxes.size(); i++)
+    {
+        centroids[i] = 0.5f * (boxes[i].min + boxes[i].max);
+        items[i] = i;
+    }
+    nodes.reserve(2 * boxes.size());
+    buildNode(0, static_cast<uint32_t>(boxes.size()), centroids, 0);
+}
+
+uint32_t StaticBVH::buildNode(uint32_t begin, uint32_t end, const std::vector<glm::vec3> &centroids, int depth)
+{
+    uint32_t index = static_cast<uint32_t>(nodes.size());
+    nodes.push_back(Node());
+
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+    glm::vec3 centroidMin = boundsMin;
+    glm::vec3 centroidMax = boundsMax;
+    for (uint32_t i = begin; i < end; i++)
+    {
+        const Box &box = itemBoxes[items[i]];
+        boundsMin = glm::min(boundsMin, box.min);
+        boundsMax = glm::max(boundsMax, box.max);
+        centroidMin = glm::min(centroidMin, centroids[items[i]]);
+        centroidMax = glm::max(centroidMax, centroids[items[i]]);
+    }
+    nodes[index].min = boundsMin;
+    nodes[index].max = boundsMax;
+
+    // Binned SAH over all three axes: the split with the smallest expected cost of
+    // visiting both children, against the cost of testing every item here
+    uint32_t count = end - begin;
+    int bestAxis = -1;
+    int bestSplit = 0;
+    double bestCost = static_cast<double>(count);
+    double parentArea = surfaceArea(boundsMin, boundsMax);
+    for (int axis = 0; axis < 3 && count > MinLeafItems && depth < MaxDepth - 2 && parentArea > 0.0; axis++)
+    {
+        float extent = centroidMax[axis] - centroidMin[axis];
+        if (extent <= 0.0f)
+            continue;
+
+        uint32_t binCount[SahBins] = {};
+        glm::vec3 binMin[SahBins], binMax[SahBins];
+        for (int b = 0; b < SahBins; b++)
+        {
+            binMin[b] = glm::vec3(std::numeric_limits<float>::max());
+            binMax[b] = glm::vec3(-std::numeric_limits<float>::max());
+        }
+        float scale = SahBins / extent;
+        for (uint32_t i = begin; i < end; i++)
+        {
+            int b = std::min(SahBins - 1, static_cast<int>((centroids[items[i]][axis] - centroidMin[axis]) * scale));
+            const Box &box = itemBoxes[items[i]];
+            binCount[b]++;
+            binMin[b] = glm::min(binMin[b], box.min);
+            binMax[b] = glm::max(binMax[b], box.max);
+        }
+
+        // Sweep from the right to get each split's right-hand area, then from the left
+        double rightArea[SahBins];
+        uint32_t rightCount[SahBins];
+        glm::vec3 sweepMin(std::numeric_limits<float>::max()), sweepMax(-std::numeric_limits<float>::max());
+        uint32_t sweepCount = 0;
+        for (int b = SahBins - 1; b > 0; b--)
+        {
+            sweepMin = glm::min(sweepMin, binMin[b]);
+            sweepMax = glm::max(sweepMax, binMax[b]);
+            sweepCount += binCount[b];
+            rightArea[b] = surfaceArea(sweepMin, sweepMax);
+            rightCount[b] = sweepCount;
+        }
+        sweepMin = glm::vec3(std::numeric_limits<float>::max());
+        sweepMax = glm::vec3(-std::numeric_limits<float>::max());
+        sweepCount = 0;
+        for (int b = 1; b < SahBins; b++)
+        {
+            sweepMin = glm::min(sweepMin, binMin[b - 1]);
+            sweepMax = glm::max(sweepMax, binMax[b - 1]);
+            sweepCount += binCount[b - 1];
+            if (sweepCount == 0 || rightCount[b] == 0)
+                continue;
+            double cost = 1.0 + (surfaceArea(sweepMin, sweepMax) * sweepCount + rightArea[b] * rightCount[b]) / parentArea;
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = b;
+            }
+        }
+    }
+
+    if (bestAxis < 0)
+    {
+        nodes[index].rightOrFirst = begin;
+        nodes[index].count = count;
+        return index;
+    }
+
+    float scale = SahBins / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+    uint32_t *middle = std::partition(items.data() + begin, items.data() + end, [&](uint32_t item)
+                                      { return std::min(SahBins - 1, static_cast<int>((centroids[item][bestAxis] - centroidMin[bestAxis]) * scale)) < bestSplit; });
+    uint32_t split = static_cast<uint32_t>(middle - items.data());
+
+    // The left child is always the next node; only the right one's index is stored
+    buildNode(begin, split, centroids, depth + 1);
+    uint32_t right = buildNode(split, end, centroids, depth + 1);
+    nodes[index].rightOrFirst = right;
+    nodes[index].count = 0;
+    return index;
+}
+
+void StaticBVH::queryFrustum(const FrustumCuller &frustum, std::vector<uint8_t> &visible) const
+{
+    visible.assign(itemBoxes.size(), 0);
+    if (nodes.empty())
+        return;
+
+    // Second stack entry: 1 when an ancestor was wholly inside, so no more tests are needed
+    uint32_t stack[MaxDepth];
+    bool accepted[MaxDepth];
+    int top = 0;
+    stack[top] = 0;
+    accepted[top++] = false;
+    while (top > 0)
+    {
+        --top;
+        const Node &node = nodes[stack[top]];
+        bool inside = accepted[top];
+        if (!inside)
+        {
+            FrustumCuller::Containment containment = frustum.classify(node.min, node.max);
+            if (containment == FrustumCuller::Containment::Outside)
+                continue;
+            inside = containment == FrustumCuller::Containment::Inside;
+        }
+        if (node.count == 0)
+        {
+            stack[top] = node.rightOrFirst;
+            accepted[top++] = inside;
+            stack[top] = static_cast<uint32_t>(&node - nodes.data()) + 1;
+            accepted[top++] = inside;
+            continue;
+        }
+        for (uint32_t i = node.rightOrFirst; i < node.rightOrFirst + node.count; i++)
+        {
+            const Box &box = itemBoxes[items[i]];
+            if (inside || frustum.classify(box.min, box.max) != FrustumCuller::Containment::Outside)
+                visible[items[i]] = 1;
+        }
+    }
+}
+
+// Entry distance of the ray into the box, or a negative value when it misses within maxDistance
+static float rayBox(const glm::vec3 &origin, const glm::vec3 &inverseDirection, float maxDistance, const glm::vec3 &min,
+                    const glm::vec3 &max)
+{
+    glm::vec3 t0 = (min - origin) * inverseDirection;
+    glm::vec3 t1 = (max - origin) * inverseDirection;
+    glm::vec3 nearT = glm::min(t0, t1);
+    glm::vec3 farT = glm::max(t0, t1);
+    float entry = std::max(std::max(nearT.x, nearT.y), std::max(nearT.z, 0.0f));
+    float exit = std::min(std::min(farT.x, farT.y), std::min(farT.z, maxDistance));
+    return entry <= exit ? entry : -1.0f;
+}
+
+bool StaticBVH::raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, uint32_t &item,
+                        float &distance) const
+{
+    if (nodes.empty())
+        return false;
+
+    // Division by a zero component gives an infinite slab, which the min/max above handle
+    glm::vec3 inverseDirection = glm::vec3(1.0f) / direction;
+    float nearest = maxDistance;
+    bool hit = false;
+
+    uint32_t stack[MaxDepth];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        const Node &node = nodes[stack[--top]];
+        if (rayBox(origin, inverseDirection, nearest, node.min, node.max) < 0.0f)
+            continue;
+        if (node.count == 0)
+        {
+            // Nearer child on top of the stack, so hits found there shorten the far one's test
+            uint32_t left = static_cast<uint32_t>(&node - nodes.data()) + 1;
+            uint32_t right = node.rightOrFirst;
+            float leftEntry = rayBox(origin, inverseDirection, nearest, nodes[left].min, nodes[left].max);
+            float rightEntry = rayBox(origin, inverseDirection, nearest, nodes[right].min, nodes[right].max);
+            bool leftFirst = leftEntry >= 0.0f && (rightEntry < 0.0f || leftEntry <= rightEntry);
+            stack[top++] = leftFirst ? right : left;
+            stack[top++] = leftFirst ? left : right;
+            continue;
+        }
+        for (uint32_t i = node.rightOrFirst; i < node.rightOrFirst + node.count; i++)
+        {
+            const Box &box = itemBoxes[items[i]];
+            float entry = rayBox(origin, inverseDirection, nearest, box.min, box.max);
+            if (entry >= 0.0f && (!hit || entry < nearest))
+            {
+                hit = true;
+                nearest = entry;
+                item = items[i];
+            }
+        }
+    }
+
+    if (hit)
+        distance = nearest;
+    return hit;
+}
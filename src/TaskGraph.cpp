@@ -0,0 +1,273 @@
+#include "TaskGraph.h"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+TaskGraph::TaskGraph()
+    : remaining(0), started(false), cancelled(false), laneCount(1), totalMs(0.0f)
+{
+}
+
+TaskGraph::~TaskGraph()
+{
+    // A graph dropped mid-poll is cancelled rather than finished: its MainThread tasks may
+    // touch state, such as the GL context, that is already gone
+    cancel();
+}
+
+TaskGraph::TaskId TaskGraph::add(const std::string &name, TaskAffinity affinity, std::function<void()> work,
+                                 const std::vector<TaskId> &dependencies)
+{
+    TaskId id = static_cast<TaskId>(tasks.size());
+    Task task;
+    task.name = name;
+    task.affinity = affinity;
+    task.work = std::move(work);
+    for (TaskId dependency : dependencies)
+    {
+        // Ids are handed out in order, so the graph cannot contain a cycle
+        if (dependency < 0 || dependency >= id)
+        {
+            std::cerr << "TaskGraph: '" << name << "' depends on unknown task " << dependency << std::endl;
+            continue;
+        }
+        task.dependencies.push_back(dependency);
+        tasks[dependency].dependents.push_back(id);
+    }
+    task.unmetDependencies = static_cast<int>(task.dependencies.size());
+    tasks.push_back(std::move(task));
+    return id;
+}
+
+void TaskGraph::run(unsigned int workerCount)
+{
+    start(workerCount);
+
+    // The calling thread owns the GL context and only runs MainThread tasks
+    while (true)
+    {
+        TaskId id;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            mainReady.wait(lock, [this]() { return remaining == 0 || cancelled || !mainQueue.empty(); });
+            if (mainQueue.empty())
+                break;
+            id = mainQueue.front();
+            mainQueue.pop_front();
+        }
+        execute(id, 0);
+    }
+    joinWorkers();
+}
+
+void TaskGraph::start(unsigned int workerCount)
+{
+    if (started)
+        return;
+    started = true;
+
+    if (workerCount == 0)
+    {
+        unsigned int cores = std::thread::hardware_concurrency();
+        workerCount = cores > 1 ? cores - 1 : 1;
+    }
+    laneCount = workerCount + 1;
+    startTime = std::chrono::steady_clock::now();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        remaining = tasks.size();
+        for (TaskId id = 0; id < static_cast<TaskId>(tasks.size()); id++)
+        {
+            if (tasks[id].unmetDependencies == 0)
+                enqueue(id);
+        }
+    }
+
+    for (unsigned int i = 0; i < workerCount; i++)
+        workers.emplace_back(&TaskGraph::workerLoop, this, static_cast<int>(i) + 1);
+}
+
+void TaskGraph::poll(float budgetMs)
+{
+    auto pollStart = std::chrono::steady_clock::now();
+    while (true)
+    {
+        TaskId id;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (mainQueue.empty())
+                break;
+            id = mainQueue.front();
+            mainQueue.pop_front();
+        }
+        execute(id, 0);
+
+        if (std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - pollStart).count() >= budgetMs)
+            break;
+    }
+
+    if (isFinished())
+        joinWorkers();
+}
+
+void TaskGraph::cancel()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        cancelled = true;
+        workerQueue.clear();
+        mainQueue.clear();
+    }
+    workerReady.notify_all();
+    mainReady.notify_all();
+    joinWorkers();
+}
+
+bool TaskGraph::isFinished() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return started && remaining == 0;
+}
+
+float TaskGraph::elapsedMs() const
+{
+    return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void TaskGraph::enqueue(TaskId id)
+{
+    if (cancelled)
+        return;
+    if (tasks[id].affinity == TaskAffinity::MainThread)
+    {
+        mainQueue.push_back(id);
+        mainReady.notify_one();
+    }
+    else
+    {
+        workerQueue.push_back(id);
+        workerReady.notify_one();
+    }
+}
+
+void TaskGraph::execute(TaskId id, int lane)
+{
+    Task &task = tasks[id];
+    task.lane = lane;
+    task.startMs = elapsedMs();
+    if (task.work)
+        task.work();
+    task.endMs = elapsedMs();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (TaskId dependent : task.dependents)
+    {
+        if (--tasks[dependent].unmetDependencies == 0)
+            enqueue(dependent);
+    }
+    if (--remaining == 0)
+    {
+        totalMs = task.endMs;
+        workerReady.notify_all();
+        mainReady.notify_all();
+    }
+}
+
+void TaskGraph::workerLoop(int lane)
+{
+    while (true)
+    {
+        TaskId id;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            workerReady.wait(lock, [this]() { return remaining == 0 || cancelled || !workerQueue.empty(); });
+            if (cancelled || workerQueue.empty())
+                return;
+            id = workerQueue.front();
+            workerQueue.pop_front();
+        }
+        execute(id, lane);
+    }
+}
+
+void TaskGraph::joinWorkers()
+{
+    for (auto &worker : workers)
+        worker.join();
+    workers.clear();
+}
+
+void TaskGraph::printReport() const
+{
+    if (tasks.empty())
+        return;
+
+    const int BAR_WIDTH = 40;
+    float scale = totalMs > 0.0f ? BAR_WIDTH / totalMs : 0.0f;
+
+    std::vector<TaskId> order(tasks.size());
+    for (TaskId id = 0; id < static_cast<TaskId>(tasks.size()); id++)
+        order[id] = id;
+    std::sort(order.begin(), order.end(), [this](TaskId a, TaskId b)
+              { return tasks[a].startMs < tasks[b].startMs; });
+
+    std::cout << "===== Startup timeline (" << totalMs << " ms, " << laneCount << " threads) =====" << std::endl;
+    char line[256];
+    float serialMs = 0.0f;
+    std::vector<float> laneBusy(laneCount, 0.0f);
+    for (TaskId id : order)
+    {
+        const Task &task = tasks[id];
+        float duration = task.endMs - task.startMs;
+        serialMs += duration;
+        if (task.lane >= 0)
+            laneBusy[task.lane] += duration;
+
+        std::string bar(BAR_WIDTH, ' ');
+        int first = std::min(BAR_WIDTH - 1, static_cast<int>(task.startMs * scale));
+        int last = std::max(first + 1, std::min(BAR_WIDTH, static_cast<int>(task.endMs * scale + 0.5f)));
+        for (int i = first; i < last; i++)
+            bar[i] = '#';
+
+        std::string lane = task.lane == 0 ? "main" : "w" + std::to_string(task.lane);
+        std::snprintf(line, sizeof(line), "  %-26s %-5s %8.1f %8.1f ms |%s|", task.name.c_str(), lane.c_str(),
+                      task.startMs, duration, bar.c_str());
+        std::cout << line << std::endl;
+    }
+
+    // Walk back from the last task to finish, always through the dependency that finished last
+    TaskId current = order.front();
+    for (TaskId id = 0; id < static_cast<TaskId>(tasks.size()); id++)
+    {
+        if (tasks[id].endMs > tasks[current].endMs)
+            current = id;
+    }
+    std::vector<TaskId> path;
+    while (current >= 0)
+    {
+        path.push_back(current);
+        TaskId latest = -1;
+        for (TaskId dependency : tasks[current].dependencies)
+        {
+            if (latest < 0 || tasks[dependency].endMs > tasks[latest].endMs)
+                latest = dependency;
+        }
+        current = latest;
+    }
+
+    std::cout << "  Critical path:";
+    float pathMs = 0.0f;
+    for (auto it = path.rbegin(); it != path.rend(); ++it)
+    {
+        const Task &task = tasks[*it];
+        pathMs += task.endMs - task.startMs;
+        std::cout << (it == path.rbegin() ? " " : " -> ") << task.name << " (" << task.endMs - task.startMs << " ms)";
+    }
+    std::cout << std::endl;
+
+    // Time on the path not spent in a path task was spent waiting for a free thread
+    std::snprintf(line, sizeof(line), "  Path work %.1f ms, queueing %.1f ms; serial work %.1f ms, speedup %.2fx, main thread busy %.1f ms",
+                  pathMs, std::max(0.0f, totalMs - pathMs), serialMs, totalMs > 0.0f ? serialMs / totalMs : 1.0f, laneBusy[0]);
+    std::cout << line << std::endl;
+}
@@ -4,14 +4,58 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
 #include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <cstdlib>
+#include <limits>
 #include <ctime>
 #include "../third_party/stb_image.h"
+#include "ImageRows.h"
 #include "PathUtils.h"
+#include "OcclusionCuller.h"
+#include "RenderQueue.h"
+#include "SoftwareOcclusion.h"
+#include "ShaderPermutations.h"
+#include "AssetStreamer.h"
+#include "TextureResidency.h"
+#include "TextureUploader.h"
+#include "VegetationScatter.h"
+
+static const char *TREE_MODEL_PATH = "Terrain/Tree/Tree1.obj";
+static const char *ROCK_WALL_MODEL_PATH = "RockWall/stonewallL.exported.obj";
+
+// Tree scatter: chunk side, least distance between trees, and clearance around the walls
+static const float TREE_CHUNK_SIZE = 10.0f;
+static const float TREE_SPACING = 4.0f;
+static const float TREE_WALL_CLEARANCE = 1.0f;
+// Trees within this distance of the camera are drawn with meshlet culling instead of instanced
+static const float MESHLET_DRAW_DISTANCE = 20.0f;
+// Trees beyond this distance fade into impostors over the band after it, then drop their mesh
+static const float IMPOSTOR_DISTANCE = 30.0f;
+static const float IMPOSTOR_FADE_BAND = 5.0f;
+
+static const glm::vec3 BARK_COLOR(0.4f, 0.25f, 0.15f);
+
+// Stands of trees with glades between them: two slow waves, shifted by the seed
+static float forestDensity(float x, float z, uint32_t seed)
+{
+    float phase = static_cast<float>(seed % 1024) * 0.37f;
+    float stands = std::sin(x * 0.21f + phase) * std::cos(z * 0.17f - phase) + 0.5f * std::sin((x + z) * 0.09f + 2.0f * phase);
+    return std::min(std::max(0.55f + 0.45f * stands, 0.0f), 1.0f);
+}
+
+std::vector<std::string> Terrain::GetModelPaths()
+{
+    return {FindImagePath(TREE_MODEL_PATH), FindImagePath(ROCK_WALL_MODEL_PATH)};
+}
 
-Terrain::Terrain(float size, int divisions, glm::vec3 offset)
+Terrain::Terrain(float size, int divisions, glm::vec3 offset, bool streamed)
 {
     terrainSize = size;
+    streamModels = streamed;
+    rockWallsPlaced = false;
+    staticBoundsKnown = false;
     terrainOffset = offset;
     VAO = 0;
     VBO = 0;
@@ -85,14 +129,17 @@ Terrain::Terrain(float size, int divisions, glm::vec3 offset)
 
     // Load texture from the Poly Haven texture folder
     loadTerrainTexture();
+    grass = std::make_unique<GrassField>(glm::vec2(offset.x - halfSize, offset.z - halfSize),
+                                         glm::vec2(offset.x + halfSize, offset.z + halfSize), offset.y);
 
-    // Load and place trees
+    // Load the trees and walls; the trees are scattered around the walls once those are placed
     loadTrees();
-    placeTrees(30); // Place trees in structured lines
-
-    // Load and place rock walls
     loadRockWalls();
-    placeRockWalls();
+    if (!streamModels || rockWallModels.empty() || rockWallModels[0]->hasBounds())
+    {
+        placeRockWalls();
+        scatterTrees();
+    }
 
     std::cout << "Flat terrain created with " << divisions << "x" << divisions << " divisions" << std::endl;
 }
@@ -116,6 +163,7 @@ Terrain::~Terrain()
     }
 
     // Clean up tree models
+    treeImpostors.clear();
     for (auto *model : treeModels)
     {
         delete model;
@@ -137,6 +185,15 @@ void Terrain::loadTerrainTexture()
     // Load the diffuse texture from Poly Haven texture folder
     std::string texturePath = FindImagePath("Terrain/brown_mud_leaves_01_1k/textures/brown_mud_leaves_01_diff_1k.png");
 
+    // Decoded on the streaming workers; the terrain is drawn with a placeholder until it lands
+    if (AssetStreamer::Get().isRunning())
+    {
+        terrainTexture = AssetStreamer::Get().requestTexture(texturePath);
+        if (terrainTexture == 0)
+            std::cerr << "Failed to load terrain texture: " << texturePath << std::endl;
+        return;
+    }
+
     glGenTextures(1, &terrainTexture);
     glBindTexture(GL_TEXTURE_2D, terrainTexture);
 
@@ -146,11 +203,15 @@ void Terrain::loadTerrainTexture()
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    // Load image using stb_image
+    // Load image using stb_image, straight from the mapped asset
     int width, height, nrComponents;
-    unsigned char *data = stbi_load(texturePath.c_str(), &width, &height, &nrComponents, 0);
+    unsigned char *data = nullptr;
+    AssetData asset = VirtualFileSystem::Get().open(texturePath);
+    if (asset.valid())
+        data = stbi_load_from_memory(asset.data(), static_cast<int>(asset.size()), &width, &height, &nrComponents, 0);
     if (data)
     {
+        FlipImageRows(data, width, height, nrComponents);
         GLenum format;
         if (nrComponents == 1)
             format = GL_RED;
@@ -175,88 +236,284 @@ void Terrain::loadTerrainTexture()
     glBindTexture(GL_TEXTURE_2D, 0);
 }
 
-void Terrain::draw(unsigned int shaderProgram)
+void Terrain::draw()
 {
+    // Wall placement depends on the wall model's size, which a streamed model only knows once imported
+    if (!rockWallsPlaced && streamModels && !rockWallModels.empty() && rockWallModels[0]->hasBounds())
+    {
+        placeRockWalls();
+        scatterTrees();
+    }
+
     // Set model matrix with offset (terrain can be shifted from origin)
-    unsigned int modelLoc = glGetUniformLocation(shaderProgram, "model");
-    glm::mat4 model = glm::mat4(1.0f);
-    model = glm::translate(model, terrainOffset);
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+    DrawPacket plane;
+    plane.model = glm::translate(glm::mat4(1.0f), terrainOffset);
+    plane.color = glm::vec3(0.4f, 0.3f, 0.2f); // Brown/mud color as fallback
 
     // Bind and use terrain texture
     if (terrainTexture != 0)
     {
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, terrainTexture);
-        glUniform1i(glGetUniformLocation(shaderProgram, "texture_diffuse1"), 0);
-        glUniform1i(glGetUniformLocation(shaderProgram, "useTexture"), 1);
+        plane.texture = terrainTexture;
+        plane.features = SHADER_TEXTURED;
+
+        // The texture repeats every terrainSize / 10 units; the tile under the camera is the closest one
+        TextureResidency &residency = TextureResidency::Get();
+        glm::vec3 eye = residency.getViewPos();
+        glm::vec3 nearest(eye.x, getHeight(eye.x, eye.z), eye.z);
+        residency.noteUsage(terrainTexture, residency.projectedSize(nearest, terrainSize / 20.0f));
     }
-    else
+
+    // Draw the terrain plane; its vertices already carry the offset in x and z
+    plane.vertexArray = VAO;
+    plane.count = static_cast<int>(vertexCount);
+    glm::vec3 planeCenter(terrainOffset.x, 0.0f, terrainOffset.z);
+    if (FrustumCuller::Get().isVisible(plane.model, planeCenter, glm::vec3(terrainSize, 0.0f, terrainSize)))
+        RenderQueue::Get().submit(plane);
+
+    // Trees and walls never move, so their hierarchy is only rebuilt until every model knows its bounds
+    if (!staticBoundsKnown)
+        buildStaticScene();
+    staticScene.queryFrustum(FrustumCuller::Get(), staticVisible);
+    FrustumCuller::Stats &cullStats = FrustumCuller::FrameStats();
+    cullStats.submitted += staticVisible.size();
+    for (uint8_t flag : staticVisible)
+        cullStats.visible += flag;
+    // Trees behind the walls in the CPU depth buffer; walls are the occluders, so never tested
+    SoftwareOcclusion::Get().test(treeOccludees, staticVisible);
+
+    // Chunks off screen are passed over without looking at their trees. Chunks hidden in their
+    // last occlusion test are left out. Trees go out in instanced batches, which conditional
+    // rendering can't split, so a chunk whose test is still running is drawn.
+    const FrustumCuller &frustum = FrustumCuller::Get();
+    OcclusionCuller &occlusion = OcclusionCuller::Get();
+    for (TreeChunk &chunk : treeChunks)
     {
-        glUniform1i(glGetUniformLocation(shaderProgram, "useTexture"), 0);
+        chunk.visibleTrees = 0;
+        if (chunk.treeCount == 0 || frustum.classify(chunk.min, chunk.max) == FrustumCuller::Containment::Outside)
+            continue;
+        for (uint32_t i = chunk.firstTree; i < chunk.firstTree + chunk.treeCount; i++)
+            chunk.visibleTrees += staticVisible[i];
+        unsigned int pendingQuery = 0;
+        if (chunk.visibleTrees > 0 && occlusion.isEnabled() &&
+            !occlusion.request(&chunk, chunk.min, chunk.max, pendingQuery, chunk.visibleTrees))
+        {
+            std::fill(staticVisible.begin() + chunk.firstTree, staticVisible.begin() + chunk.firstTree + chunk.treeCount, 0);
+            chunk.visibleTrees = 0;
+        }
     }
 
-    // Draw the terrain plane
-    glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLES, 0, vertexCount);
-    glBindVertexArray(0);
+    // Trees close to the camera fill much of the screen, while many of their meshlets are off
+    // it, so they are drawn one by one with meshlet culling and left out of the batch.
+    // Far trees become billboards once their model's impostor is baked. Inside the fade band
+    // the impostor dithers in while the mesh, drawn on its own, dithers out on the complementary
+    // pixels, so the two cross-fade; past it only the impostor is drawn.
+    const glm::vec3 &viewPos = RenderQueue::Get().getViewPos();
+    for (auto &impostor : treeImpostors)
+        impostor->clearInstances();
+    for (TreeChunk &chunk : treeChunks)
+    {
+        if (chunk.visibleTrees == 0)
+            continue;
+        size_t modelIndex = std::find(treeModels.begin(), treeModels.end(), chunk.model) - treeModels.begin();
+        Impostor *impostor = modelIndex < treeImpostors.size() && treeImpostors[modelIndex]->isBaked()
+                                 ? treeImpostors[modelIndex].get()
+                                 : nullptr;
+        for (uint32_t i = chunk.firstTree; i < chunk.firstTree + chunk.treeCount; i++)
+        {
+            const TreeInstance &tree = trees[i];
+            if (!staticVisible[i])
+                continue;
+            float distance = glm::length(tree.position - viewPos);
+            if (distance <= MESHLET_DRAW_DISTANCE)
+            {
+                tree.model->noteTextureUsage(tree.modelMatrix);
+                tree.model->DrawMeshlets(tree.modelMatrix, BARK_COLOR);
+                staticVisible[i] = 0;
+                chunk.visibleTrees--;
+            }
+            else if (impostor && distance > IMPOSTOR_DISTANCE)
+            {
+                float fade = std::min((distance - IMPOSTOR_DISTANCE) / IMPOSTOR_FADE_BAND, 1.0f);
+                impostor->addInstance(tree.modelMatrix, fade);
+                if (fade < 1.0f)
+                {
+                    tree.model->noteTextureUsage(tree.modelMatrix);
+                    tree.model->Draw(tree.modelMatrix, BARK_COLOR, 0, fade);
+                }
+                staticVisible[i] = 0;
+                chunk.visibleTrees--;
+            }
+        }
+    }
 
-    // Draw trees
-    // Set brown color for bark
-    unsigned int colorLoc = glGetUniformLocation(shaderProgram, "objectColor");
-    glUniform3f(colorLoc, 0.4f, 0.25f, 0.15f); // Brown color for bark/wood
+    // Draw trees and rock walls: one instanced draw per model and mesh, whatever the
+    // instance count. Set brown color for bark.
+    drawTrees(BARK_COLOR);
+    drawInstances(rockWalls, rockWallModels, trees.size(), glm::vec3(0.5f, 0.5f, 0.5f));
+}
 
-    for (const auto &tree : trees)
+void Terrain::drawImpostors(const std::function<void(ShaderProgram &program)> &frameSetup)
+{
+    // A bake while textures still stream would keep their placeholders for good
+    bool settled = AssetStreamer::Get().isIdle() && TextureUploader::Get().isIdle();
+    for (size_t i = 0; i < treeImpostors.size(); i++)
     {
-        if (tree.model)
-        {
-            // Calculate model matrix for tree
-            glm::mat4 modelMatrix = glm::mat4(1.0f);
+        Impostor &impostor = *treeImpostors[i];
+        if (!impostor.isBaked() && !impostor.hasFailed() && settled && treeModels[i]->isResident())
+            impostor.bake(*treeModels[i], BARK_COLOR);
+        impostor.draw(frameSetup);
+    }
+}
+
+void Terrain::drawGrass(const std::function<void(ShaderProgram &program)> &frameSetup, float time)
+{
+    grass->draw(frameSetup, RenderQueue::Get().getViewPos(), time);
+}
+
+size_t Terrain::getImpostorCount() const
+{
+    size_t count = 0;
+    for (const auto &impostor : treeImpostors)
+        count += impostor->instanceCount();
+    return count;
+}
 
-            // Translate to tree position
-            float treeY = getHeight(tree.position.x, tree.position.z);
-            modelMatrix = glm::translate(modelMatrix, glm::vec3(tree.position.x, treeY, tree.position.z));
+glm::mat4 Terrain::instanceMatrix(const glm::vec3 &position, float rotation, float scale) const
+{
+    glm::mat4 modelMatrix = glm::mat4(1.0f);
 
-            // Rotate around Y axis
-            modelMatrix = glm::rotate(modelMatrix, tree.rotation, glm::vec3(0.0f, 1.0f, 0.0f));
+    // Translate to the instance position, standing on the terrain
+    float y = getHeight(position.x, position.z);
+    modelMatrix = glm::translate(modelMatrix, glm::vec3(position.x, y, position.z));
 
-            // Scale the tree
-            modelMatrix = glm::scale(modelMatrix, glm::vec3(tree.scale));
+    // Rotate around Y axis
+    modelMatrix = glm::rotate(modelMatrix, rotation, glm::vec3(0.0f, 1.0f, 0.0f));
 
-            // Set model matrix uniform
-            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(modelMatrix));
+    // Scale the instance
+    return glm::scale(modelMatrix, glm::vec3(scale));
+}
 
-            // Draw the tree model
-            tree.model->Draw(shaderProgram);
+template <typename Instance>
+void Terrain::placeInstances(std::vector<Instance> &instances)
+{
+    for (Instance &instance : instances)
+        instance.modelMatrix = instanceMatrix(instance.position, instance.rotation, instance.scale);
+    buildStaticScene();
+}
+
+void Terrain::buildStaticScene()
+{
+    // A model still streaming has no bounds; its instances never get culled until it has
+    const glm::vec3 unbounded(1e30f);
+    std::vector<StaticBVH::Box> boxes;
+    boxes.reserve(trees.size() + rockWalls.size());
+    staticBoundsKnown = true;
+
+    for (const auto &tree : trees)
+    {
+        // Collision circle of checkTreeCollision, as a box
+        float treeRadius = 0.8f * tree.scale;
+        StaticBVH::Box box = {tree.position - glm::vec3(treeRadius, 0.0f, treeRadius),
+                              tree.position + glm::vec3(treeRadius, 0.0f, treeRadius)};
+        glm::vec3 renderMin, renderMax;
+        if (tree.model && tree.model->hasBounds())
+        {
+            TransformBox(tree.modelMatrix, tree.model->getCenter(), tree.model->getSize(), renderMin, renderMax);
+            box.min = glm::min(box.min, renderMin);
+            box.max = glm::max(box.max, renderMax);
+        }
+        else
+        {
+            box = {-unbounded, unbounded};
+            staticBoundsKnown = false;
         }
+        boxes.push_back(box);
     }
 
-    // Draw rock walls
-    glUniform3f(colorLoc, 0.5f, 0.5f, 0.5f); 
+    treeOccludees.clear();
+    for (const StaticBVH::Box &box : boxes)
+        treeOccludees.add(box.min, box.max);
 
+    // Walls collide with their model box in the xz plane, which their render bounds contain.
+    // The same boxes are the software rasterizer's occluders.
+    SoftwareOcclusion &softwareOcclusion = SoftwareOcclusion::Get();
+    softwareOcclusion.clearOccluders();
     for (const auto &wall : rockWalls)
     {
-        if (wall.model)
+        StaticBVH::Box box = {-unbounded, unbounded};
+        if (wall.model && wall.model->hasBounds())
         {
-            // Calculate model matrix for rock wall
-            glm::mat4 modelMatrix = glm::mat4(1.0f);
-
-            // Translate to wall position
-            float wallY = getHeight(wall.position.x, wall.position.z);
-            modelMatrix = glm::translate(modelMatrix, glm::vec3(wall.position.x, wallY, wall.position.z));
+            TransformBox(wall.modelMatrix, wall.model->getCenter(), wall.model->getSize(), box.min, box.max);
+            softwareOcclusion.addOccluder(wall.modelMatrix, wall.model->getCenter(), wall.model->getSize());
+        }
+        else
+        {
+            staticBoundsKnown = false;
+        }
+        boxes.push_back(box);
+    }
 
-            // Rotate around Y axis
-            modelMatrix = glm::rotate(modelMatrix, wall.rotation, glm::vec3(0.0f, 1.0f, 0.0f));
+    staticScene.build(boxes);
 
-            // Scale the wall
-            modelMatrix = glm::scale(modelMatrix, glm::vec3(wall.scale));
+    // Chunk bounds, over the boxes of their trees
+    for (TreeChunk &chunk : treeChunks)
+    {
+        chunk.min = glm::vec3(std::numeric_limits<float>::max());
+        chunk.max = glm::vec3(-std::numeric_limits<float>::max());
+        for (uint32_t i = chunk.firstTree; i < chunk.firstTree + chunk.treeCount; i++)
+        {
+            chunk.min = glm::min(chunk.min, boxes[i].min);
+            chunk.max = glm::max(chunk.max, boxes[i].max);
+        }
+    }
+}
 
-            // Set model matrix uniform
-            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(modelMatrix));
+void Terrain::drawTrees(const glm::vec3 &color)
+{
+    // A chunk with every tree still in the batch hands over the transforms built with it
+    std::vector<glm::mat4> visibleMatrices;
+    for (Model *model : treeModels)
+    {
+        visibleMatrices.clear();
+        for (const TreeChunk &chunk : treeChunks)
+        {
+            if (chunk.model != model || chunk.visibleTrees == 0)
+                continue;
+            bool whole = chunk.visibleTrees == chunk.treeCount;
+            if (whole)
+                visibleMatrices.insert(visibleMatrices.end(), chunk.matrices.begin(), chunk.matrices.end());
+            for (uint32_t i = chunk.firstTree; i < chunk.firstTree + chunk.treeCount; i++)
+            {
+                if (!staticVisible[i])
+                    continue;
+                if (!whole)
+                    visibleMatrices.push_back(trees[i].modelMatrix);
+                model->noteTextureUsage(trees[i].modelMatrix);
+            }
+        }
+        model->setInstances(visibleMatrices);
+        model->DrawInstanced(color);
+    }
+}
 
-            // Draw the rock wall model
-            wall.model->Draw(shaderProgram);
+template <typename Instance>
+void Terrain::drawInstances(const std::vector<Instance> &instances, const std::vector<Model *> &models, size_t firstItem,
+                            const glm::vec3 &color)
+{
+    // Texture residency is reported per visible instance, from its own screen size
+    std::vector<glm::mat4> visibleMatrices;
+    for (Model *model : models)
+    {
+        visibleMatrices.clear();
+        for (size_t i = 0; i < instances.size(); i++)
+        {
+            if (instances[i].model != model || !staticVisible[firstItem + i])
+                continue;
+            visibleMatrices.push_back(instances[i].modelMatrix);
+            model->noteTextureUsage(instances[i].modelMatrix);
         }
+        model->setInstances(visibleMatrices);
+        model->DrawInstanced(color);
     }
 }
 
@@ -272,11 +529,25 @@ glm::vec3 Terrain::getNormal(float x, float z) const
     return glm::vec3(0.0f, 1.0f, 0.0f);
 }
 
+// Vertical column around a circle in the xz plane, as the query box for the static scene
+static void collisionColumn(float x, float z, float radius, glm::vec3 &min, glm::vec3 &max)
+{
+    min = glm::vec3(x - radius, -1e30f, z - radius);
+    max = glm::vec3(x + radius, 1e30f, z + radius);
+}
+
 bool Terrain::checkTreeCollision(float x, float z, float radius) const
 {
-    // Check if position (x, z) with given radius collides with any tree
-    for (const auto &tree : trees)
+    // Check if position (x, z) with given radius collides with any tree whose box the
+    // column around it overlaps; items below trees.size() are trees
+    glm::vec3 columnMin, columnMax;
+    collisionColumn(x, z, radius, columnMin, columnMax);
+    bool collides = false;
+    auto visitTree = [&](uint32_t item)
     {
+        if (item >= trees.size())
+            return true;
+        const TreeInstance &tree = trees[item];
         if (tree.model)
         {
             // Calculate distance from position to tree center
@@ -290,20 +561,31 @@ bool Terrain::checkTreeCollision(float x, float z, float radius) const
             // Check if circles overlap
             if (distance < (radius + treeRadius))
             {
-                return true; // Collision detected
+                collides = true; // Collision detected
+                return false;
             }
         }
-    }
-    return false; // No collision
+        return true;
+    };
+    staticScene.queryBox(columnMin, columnMax, visitTree);
+    return collides;
 }
 
 // Check collision with rock walls using rectangular bounding boxes
 bool Terrain::checkWallCollision(float x, float z, float radius) const
 {
-    for (const auto &wall : rockWalls)
+    // Only walls whose render box the column overlaps can be hit: it contains the model box
+    // in the xz plane, and the radius buffer below is smaller than radius
+    glm::vec3 columnMin, columnMax;
+    collisionColumn(x, z, radius, columnMin, columnMax);
+    bool collides = false;
+    auto visitWall = [&](uint32_t item)
     {
+        if (item < trees.size())
+            return true;
+        const RockWallInstance &wall = rockWalls[item - trees.size()];
         if (!wall.model)
-            continue;
+            return true;
 
         // Get wall model size and scale
         glm::vec3 wallSize = wall.model->getSize();
@@ -344,11 +626,14 @@ bool Terrain::checkWallCollision(float x, float z, float radius) const
         if (localPoint.x >= minX && localPoint.x <= maxX &&
             localPoint.z >= minZ && localPoint.z <= maxZ)
         {
-            return true; // Collision detected
+            collides = true; // Collision detected
+            return false;
         }
-    }
+        return true;
+    };
+    staticScene.queryBox(columnMin, columnMax, visitWall);
 
-    return false; // No collision
+    return collides;
 }
 
 // Resolve wall collision and return adjusted position
@@ -356,8 +641,21 @@ glm::vec3 Terrain::resolveWallCollision(float x, float z, float radius, const gl
 {
     glm::vec3 adjustedPos(x, 0.0f, z);
 
-    for (const auto &wall : rockWalls)
+    // Candidate walls as in checkWallCollision, in placement order so the last wall hit still wins
+    glm::vec3 columnMin, columnMax;
+    collisionColumn(x, z, radius, columnMin, columnMax);
+    std::vector<uint32_t> candidates;
+    staticScene.queryBox(columnMin, columnMax, [&](uint32_t item)
+                         {
+                             if (item >= trees.size())
+                                 candidates.push_back(static_cast<uint32_t>(item - trees.size()));
+                             return true;
+                         });
+    std::sort(candidates.begin(), candidates.end());
+
+    for (uint32_t candidate : candidates)
     {
+        const RockWallInstance &wall = rockWalls[candidate];
         if (!wall.model)
             continue;
 
@@ -458,12 +756,13 @@ glm::vec3 Terrain::resolveWallCollision(float x, float z, float radius, const gl
 void Terrain::loadTrees()
 {
     // Load Tree model
-    std::string treePath = FindImagePath("Terrain/Tree/Tree1.obj");
+    std::string treePath = FindImagePath(TREE_MODEL_PATH);
 
     try
     {
-        Model* treeModel = new Model(treePath);
+        Model* treeModel = new Model(treePath, streamModels);
         treeModels.push_back(treeModel);
+        treeImpostors.emplace_back(new Impostor());
         std::cout << "Loaded 1 tree model: Tree4.obj" << std::endl;
     }
     catch (const std::exception& e)
@@ -477,7 +776,15 @@ void Terrain::loadTrees()
     }
 }
 
-void Terrain::placeTrees(int numTrees)
+void Terrain::setTreeClearings(const std::vector<TreeClearing> &clearings)
+{
+    treeClearings = clearings;
+    // Chunks exist once a scatter has run, empty ones included
+    if (!treeChunks.empty())
+        scatterTrees();
+}
+
+void Terrain::scatterTrees()
 {
     if (treeModels.empty())
     {
@@ -485,139 +792,105 @@ void Terrain::placeTrees(int numTrees)
         return;
     }
 
-    trees.clear();
-
-    // ===== TREE LINE CONFIGURATION =====
-    // Configure how trees are placed in structured lines
-
-    // Global settings
-    float defaultTreeScale = 0.03f; // Base scale for all trees
-
-    // Line configuration structure
-    struct TreeLineConfig
+    VegetationScatter::Settings settings;
+    float halfSize = terrainSize / 2.0f;
+    settings.min = glm::vec2(terrainOffset.x - halfSize, terrainOffset.z - halfSize);
+    settings.max = glm::vec2(terrainOffset.x + halfSize, terrainOffset.z + halfSize);
+    settings.chunkSize = TREE_CHUNK_SIZE;
+    settings.spacing = TREE_SPACING;
+    settings.minScale = 0.026f;
+    settings.maxScale = 0.034f;
+    if (const char *spacing = std::getenv("SIMPLECATAPULT_TREE_SPACING"))
     {
-        bool enabled;                 // Enable/disable this line
-        float startX;                 // Starting X position
-        float startZ;                 // Starting Z position
-        float direction;              // 0 = along X axis, PI/2 = along Z axis (in radians)
-        float spacing;                // Distance between individual trees
-        float groupSpacing;           // Extra space between different tree groups
-        std::vector<int> treePattern; // Which tree models to use (0-5) and how many of each
-    };
-
-    // Define 4 lines of trees
-    std::vector<TreeLineConfig> treeLines = {
-        {
-            true,     
-            23.0f,    
-            -13.0f,   
-            1.5708f,  
-            3.0f,     
-            5.0f,     
-            {0, 0, 0, 
-             0, 0, 0,
-             0, 0, 0}
-        },
-
-       
-        {
-            true,     
-            8.0f,     
-            -13.0f,   
-            1.5708f,  
-            3.0f,     
-            5.0f,     
-            {0, 0, 0,
-             0, 0, 0,
-             0, 0, 0}
-        },
-
-        {
-            true,     
-            -5.0f,    
-            -13.0f,   
-            1.5708f,  
-            3.0f,     
-            5.0f,     
-            {0, 0, 0,
-             0, 0, 0,
-             0, 0, 0}
-        },
+        float value = static_cast<float>(std::atof(spacing));
+        if (value > 0.0f)
+            settings.spacing = value;
+    }
+    if (const char *seed = std::getenv("SIMPLECATAPULT_TREE_SEED"))
+        settings.seed = static_cast<uint32_t>(std::atol(seed));
 
-        {
-            true,     
-            -25.0f,   
-            -13.0f,   
-            1.5708f,  
-            3.0f,     
-            5.0f,     
-            {0, 0, 0,
-             0, 0, 0,
-             0, 0, 0}
-        }};
-    // ===== END OF TREE LINE CONFIGURATION =====
-
-    // Place trees according to line configurations
-    for (const auto &line : treeLines)
-    {
-        if (!line.enabled)
+    // Nothing grows on the walls or close enough for its canopy to reach into them
+    VegetationScatter scatter;
+    for (const auto &wall : rockWalls)
+    {
+        if (!wall.model || !wall.model->hasBounds())
             continue;
+        glm::vec3 min, max;
+        TransformBox(wall.modelMatrix, wall.model->getCenter(), wall.model->getSize(), min, max);
+        scatter.addExclusion(glm::vec2(min.x - TREE_WALL_CLEARANCE, min.z - TREE_WALL_CLEARANCE),
+                             glm::vec2(max.x + TREE_WALL_CLEARANCE, max.z + TREE_WALL_CLEARANCE));
+    }
+    // Nor where the catapult starts or the zombies stand and walk
+    for (const TreeClearing &clearing : treeClearings)
+        scatter.addClearing(clearing.a, clearing.b, clearing.radius);
 
-        float currentX = line.startX;
-        float currentZ = line.startZ;
-
-        // Calculate direction vector
-        float dirX = cosf(line.direction);
-        float dirZ = sinf(line.direction);
-
-        int previousTreeType = -1;
-
-        for (size_t i = 0; i < line.treePattern.size(); i++)
+    uint32_t seed = settings.seed;
+    auto density = [seed](float x, float z)
+    {
+        return forestDensity(x, z, seed);
+    };
+    auto placement = [this](const VegetationScatter::Point &point)
+    {
+        return instanceMatrix(glm::vec3(point.position.x, 0.0f, point.position.y), point.rotation, point.scale);
+    };
+    auto start = std::chrono::steady_clock::now();
+    std::vector<VegetationScatter::Chunk> chunks = scatter.generate(settings, density, placement);
+    float totalMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // Each chunk's trees stay together, so a chunk is a range of trees. The old chunks' occlusion
+    // entries go first, or new chunks at the same addresses would inherit their results.
+    for (const TreeChunk &chunk : treeChunks)
+        OcclusionCuller::Get().forget(&chunk);
+    trees.clear();
+    treeChunks.clear();
+    treeChunks.reserve(chunks.size());
+    for (size_t c = 0; c < chunks.size(); c++)
+    {
+        VegetationScatter::Chunk &chunk = chunks[c];
+        TreeChunk treeChunk;
+        treeChunk.min = glm::vec3(0.0f);
+        treeChunk.max = glm::vec3(0.0f);
+        treeChunk.model = treeModels[c % treeModels.size()];
+        treeChunk.firstTree = static_cast<uint32_t>(trees.size());
+        treeChunk.treeCount = static_cast<uint32_t>(chunk.points.size());
+        treeChunk.visibleTrees = 0;
+        for (size_t i = 0; i < chunk.points.size(); i++)
         {
-            int treeIndex = line.treePattern[i];
-
-            // Add extra spacing when changing tree types
-            if (previousTreeType != -1 && previousTreeType != treeIndex)
-            {
-                currentX += dirX * line.groupSpacing;
-                currentZ += dirZ * line.groupSpacing;
-            }
-            previousTreeType = treeIndex;
-
-            // Clamp tree index to valid range (0-5)
-            if (treeIndex < 0 || treeIndex >= (int)treeModels.size())
-                treeIndex = 0;
-
-            // Get terrain height at this position
-            float y = getHeight(currentX, currentZ);
-
-            // Create tree instance
+            const VegetationScatter::Point &point = chunk.points[i];
             TreeInstance tree;
-            tree.model = treeModels[treeIndex];
-            tree.position = glm::vec3(currentX, y, currentZ);
-            tree.rotation = 0.0f; // No random rotation for structured lines
-            tree.scale = defaultTreeScale;
+            tree.model = treeChunk.model;
+            tree.position = glm::vec3(point.position.x, getHeight(point.position.x, point.position.y), point.position.y);
+            tree.rotation = point.rotation;
+            tree.scale = point.scale;
+            tree.modelMatrix = chunk.matrices[i];
             trees.push_back(tree);
-
-            // Move to next position
-            currentX += dirX * line.spacing;
-            currentZ += dirZ * line.spacing;
         }
+        treeChunk.matrices = std::move(chunk.matrices);
+        treeChunks.push_back(std::move(treeChunk));
     }
+    buildStaticScene();
 
-    std::cout << "Placed " << trees.size() << " trees in structured lines" << std::endl;
+    std::cout << "Scattered " << trees.size() << " trees over " << chunks.size() << " chunks in " << totalMs
+              << " ms (spacing " << settings.spacing << ", seed " << settings.seed << ")" << std::endl;
+    for (const VegetationScatter::Chunk &chunk : chunks)
+    {
+        std::cout << "  Tree chunk (" << chunk.cellX << ", " << chunk.cellZ << "): " << chunk.points.size()
+                  << " trees in " << chunk.generationMs << " ms" << std::endl;
+    }
 }
 
 void Terrain::loadRockWalls()
 {
     // Load the rock wall model
-    std::string wallPath = FindImagePath("RockWall/stonewallL.exported.obj");
+    std::string wallPath = FindImagePath(ROCK_WALL_MODEL_PATH);
 
     try
     {
-        Model *wallModel = new Model(wallPath);
+        Model *wallModel = new Model(wallPath, streamModels);
         rockWallModels.push_back(wallModel);
         std::cout << "Loaded rock wall model: " << wallPath << std::endl;
+        if (!wallModel->hasBounds())
+            return;
 
         // Print rock wall dimensions
         glm::vec3 wallSize = wallModel->getSize();
@@ -658,6 +931,7 @@ void Terrain::placeRockWalls()
         std::cerr << "Cannot place rock walls: No rock wall models loaded!" << std::endl;
         return;
     }
+    rockWallsPlaced = true;
 
     float halfSize = terrainSize / 2.0f;
     float wallOffset = 5.0f;   
@@ -782,5 +1056,6 @@ void Terrain::placeRockWalls()
         std::cout << "Placed " << middleWallCount << " middle wall segment(s) to form combined big wall" << std::endl;
     }
 
+    placeInstances(rockWalls);
     std::cout << "Placed " << rockWalls.size() << " rock wall segments around terrain edges (aligned to one side)" << std::endl;
 }
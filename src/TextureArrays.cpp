@@ -0,0 +1,144 @@
+#include "TextureArrays.h"
+#include <GL/glew.h>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include "AssetStreamer.h"
+#include "TextureResidency.h"
+#include "TextureUploader.h"
+#include "VirtualFileSystem.h"
+
+TextureArrays &TextureArrays::Get()
+{
+    static TextureArrays instance;
+    return instance;
+}
+
+// Header and layer table of a baked array, or false when the blob is not one
+static bool readHeader(const AssetData &asset, TextureArrayHeader &header)
+{
+    if (!asset.valid() || asset.size() < sizeof(TextureArrayHeader))
+        return false;
+    std::memcpy(&header, asset.data(), sizeof(header));
+    if (std::memcmp(header.magic, TEXTURE_ARRAY_MAGIC, 4) != 0 || header.version != TEXTURE_ARRAY_VERSION ||
+        header.width == 0 || header.height == 0 || header.layerCount == 0)
+        return false;
+
+    uint64_t tableEnd = sizeof(TextureArrayHeader) + static_cast<uint64_t>(header.layerCount) * sizeof(TextureArrayLayer) +
+                        header.stringTableSize;
+    uint64_t dataSize = static_cast<uint64_t>(header.width) * header.height * 4 * header.layerCount;
+    return tableEnd <= header.dataOffset && header.dataOffset + dataSize <= asset.size();
+}
+
+void TextureArrays::mountBakedArrays()
+{
+    mounted = true;
+    for (const TextureArrayDefinition &definition : GetTextureArrayDefinitions())
+    {
+        std::string key = definition.key;
+        if (!VirtualFileSystem::Get().exists(key))
+            continue;
+
+        // Only the directory is read here; the texels are decoded on a worker
+        AssetData asset = VirtualFileSystem::Get().open(key);
+        TextureArrayHeader header;
+        if (!readHeader(asset, header))
+        {
+            std::cerr << "Invalid texture array: " << key << std::endl;
+            continue;
+        }
+
+        unsigned int texture = 0;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        std::vector<unsigned char> grey(static_cast<size_t>(header.layerCount) * 4, 128);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, 1, 1, header.layerCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey.data());
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        arrays.push_back(texture);
+
+        const TextureArrayLayer *table = reinterpret_cast<const TextureArrayLayer *>(asset.data() + sizeof(TextureArrayHeader));
+        const char *strings = reinterpret_cast<const char *>(table + header.layerCount);
+        for (uint32_t i = 0; i < header.layerCount; i++)
+        {
+            if (static_cast<uint64_t>(table[i].pathOffset) + table[i].pathLength > header.stringTableSize)
+                continue;
+            std::string path(strings + table[i].pathOffset, table[i].pathLength);
+            layers[VirtualFileSystem::Get().resolve(path)] = {texture, static_cast<int>(i)};
+        }
+
+        // Each level holds every layer back to back. The chain goes to TextureResidency like a
+        // streamed 2D texture's: the uploader brings it in a layer's strips at a time within
+        // its frame budget, coarse levels first, and the residency budget can drop fine ones.
+        auto levels = std::make_shared<std::vector<TextureUploader::MipLevel>>();
+        AssetStreamer::Get().submit(
+            [key, levels]() -> size_t
+            {
+                AssetData asset = VirtualFileSystem::Get().open(key);
+                TextureArrayHeader header;
+                if (!readHeader(asset, header))
+                    return 0;
+
+                size_t layerBytes = static_cast<size_t>(header.width) * header.height * 4;
+                for (uint32_t i = 0; i < header.layerCount; i++)
+                {
+                    std::vector<TextureUploader::MipLevel> chain = TextureUploader::BuildMipChain(
+                        asset.data() + header.dataOffset + layerBytes * i, header.width, header.height, 4);
+                    if (levels->empty())
+                        levels->resize(chain.size());
+                    for (size_t level = 0; level < chain.size(); level++)
+                    {
+                        (*levels)[level].width = chain[level].width;
+                        (*levels)[level].height = chain[level].height;
+                        (*levels)[level].layers = static_cast<int>(header.layerCount);
+                        (*levels)[level].pixels.insert((*levels)[level].pixels.end(), chain[level].pixels.begin(), chain[level].pixels.end());
+                    }
+                }
+                return 0; // The texture uploader spends its own byte budget
+            },
+            [key, levels, texture, header]()
+            {
+                if (levels->empty())
+                {
+                    std::cerr << "Failed to load texture array: " << key << std::endl;
+                    return;
+                }
+                TextureResidency::Get().registerTexture(texture, 4, std::move(*levels), GL_TEXTURE_2D_ARRAY);
+
+                std::cout << "Decoded texture array: " << key << " (" << header.layerCount << " layers, "
+                          << header.width << "x" << header.height << "), streaming in" << std::endl;
+            });
+    }
+}
+
+unsigned int TextureArrays::find(const std::string &path, int &layer)
+{
+    if (!mounted)
+        mountBakedArrays();
+
+    layer = -1;
+    if (layers.empty())
+        return 0;
+
+    auto found = layers.find(VirtualFileSystem::Get().resolve(path));
+    if (found == layers.end())
+        return 0;
+    layer = found->second.layer;
+    return found->second.texture;
+}
+
+void TextureArrays::bind(ShaderProgram &program) const
+{
+    program.set(program.slot("texture_array"), TextureUnit);
+}
+
+void TextureArrays::shutdown()
+{
+    for (unsigned int texture : arrays)
+        glDeleteTextures(1, &texture);
+    arrays.clear();
+    layers.clear();
+    mounted = false;
+}
@@ -0,0 +1,214 @@
+#include "TextureResidency.h"
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+
+// Levels at or below this edge are never dropped, matching the uploader's coarse pass
+static const int FLOOR_EDGE = 64;
+// Textures not drawn for this many frames fall back to their floor level
+static const unsigned long UNUSED_FRAMES = 300;
+// A texture has to need two levels less before it drops one unasked, so a texture whose
+// instances sit on a mip boundary does not flip between uploads and drops
+static const int DROP_HYSTERESIS = 2;
+
+TextureResidency &TextureResidency::Get()
+{
+    static TextureResidency instance;
+    return instance;
+}
+
+TextureResidency::TextureResidency()
+    : budgetBytes(256 * 1024 * 1024), residentBytes(0), frame(0), viewPos(0.0f), pixelsPerUnit(0.0f)
+{
+    TextureUploader::Get().setLevelCallback([this](unsigned int texture, int level)
+                                            { onLevelResident(texture, level); });
+}
+
+// Drivers pad RGB to four bytes a texel, so that is what the budget counts
+size_t TextureResidency::levelBytes(const Entry &entry, int level)
+{
+    const TextureUploader::MipLevel &mip = (*entry.levels)[level];
+    return static_cast<size_t>(mip.width) * mip.height * mip.layers * 4;
+}
+
+size_t TextureResidency::bytesFrom(const Entry &entry, int level)
+{
+    size_t bytes = 0;
+    for (int i = level; i < static_cast<int>(entry.levels->size()); i++)
+        bytes += levelBytes(entry, i);
+    return bytes;
+}
+
+void TextureResidency::registerTexture(unsigned int texture, int components, std::vector<TextureUploader::MipLevel> levels,
+                                       GLenum target)
+{
+    if (texture == 0 || levels.empty())
+        return;
+
+    Entry entry;
+    entry.components = components;
+    entry.target = target;
+    entry.residentLevel = static_cast<int>(levels.size());
+    entry.floorLevel = static_cast<int>(levels.size()) - 1;
+    for (int i = 0; i < static_cast<int>(levels.size()); i++)
+    {
+        if (std::max(levels[i].width, levels[i].height) <= FLOOR_EDGE)
+        {
+            entry.floorLevel = i;
+            break;
+        }
+    }
+    entry.frameLevel = entry.floorLevel;
+    entry.lastUsedFrame = frame;
+    entry.levels = std::make_shared<const std::vector<TextureUploader::MipLevel>>(std::move(levels));
+    textures[texture] = std::move(entry);
+}
+
+// ===== Usage =====
+void TextureResidency::setView(const glm::vec3 &position, float unitPixels)
+{
+    viewPos = position;
+    pixelsPerUnit = unitPixels;
+}
+
+float TextureResidency::projectedSize(const glm::vec3 &center, float radius) const
+{
+    float distance = std::max(glm::length(center - viewPos), 0.1f);
+    return 2.0f * radius * pixelsPerUnit / distance;
+}
+
+void TextureResidency::noteUsage(unsigned int texture, float screenSizePx)
+{
+    auto found = textures.find(texture);
+    if (found == textures.end())
+        return;
+    Entry &entry = found->second;
+
+    // One texel per pixel across the surface: log2 of the texel-to-pixel ratio picks the level
+    const TextureUploader::MipLevel &top = entry.levels->front();
+    float texels = static_cast<float>(std::max(top.width, top.height));
+    int level = static_cast<int>(std::floor(std::log2(texels / std::max(screenSizePx, 1.0f))));
+    level = std::max(0, std::min(level, entry.floorLevel));
+
+    if (entry.lastUsedFrame != frame || !entry.reported)
+        entry.frameLevel = level;
+    else
+        entry.frameLevel = std::min(entry.frameLevel, level);
+    entry.reported = true;
+    entry.lastUsedFrame = frame;
+}
+
+// ===== Residency =====
+void TextureResidency::onLevelResident(unsigned int texture, int level)
+{
+    auto found = textures.find(texture);
+    if (found == textures.end())
+        return;
+    Entry &entry = found->second;
+    entry.residentLevel = level;
+    if (level <= entry.uploadTarget)
+        entry.uploadTarget = -1;
+}
+
+void TextureResidency::drop(unsigned int texture, Entry &entry, int level)
+{
+    if (entry.uploadTarget >= 0)
+    {
+        TextureUploader::Get().cancel(texture);
+        entry.uploadTarget = -1;
+    }
+    if (level <= entry.residentLevel)
+        return;
+
+    // Levels below the base level are outside the completeness check, so they can be
+    // respecified as empty to give their memory back. A cancelled upload may have
+    // allocated any of them, hence the sweep from 0.
+    GLenum format = TextureUploader::FormatFor(entry.components);
+    glBindTexture(entry.target, texture);
+    glTexParameteri(entry.target, GL_TEXTURE_BASE_LEVEL, level);
+    for (int i = 0; i < level; i++)
+    {
+        if (entry.target == GL_TEXTURE_2D_ARRAY)
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, i, format, 0, 0, 0, 0, format, GL_UNSIGNED_BYTE, nullptr);
+        else
+            glTexImage2D(GL_TEXTURE_2D, i, format, 0, 0, 0, format, GL_UNSIGNED_BYTE, nullptr);
+    }
+    glBindTexture(entry.target, 0);
+    entry.residentLevel = level;
+}
+
+void TextureResidency::update()
+{
+    // Reports made during the previous frame are complete now
+    frame++;
+
+    struct Plan
+    {
+        unsigned int texture;
+        Entry *entry;
+        int level;
+        bool forced;
+    };
+    std::vector<Plan> plans;
+    plans.reserve(textures.size());
+    size_t wantedBytes = 0;
+    for (auto &item : textures)
+    {
+        Entry &entry = item.second;
+        if (entry.reported && entry.lastUsedFrame + 1 == frame)
+            entry.neededLevel = entry.frameLevel;
+        else if (entry.reported && frame - entry.lastUsedFrame > UNUSED_FRAMES)
+            entry.neededLevel = entry.floorLevel;
+        else if (!entry.reported)
+            entry.neededLevel = 0;
+
+        plans.push_back({item.first, &entry, entry.neededLevel, false});
+        wantedBytes += bytesFrom(entry, entry.neededLevel);
+    }
+
+    // Over budget: the least recently drawn textures lose their finest levels first
+    if (wantedBytes > budgetBytes)
+    {
+        std::sort(plans.begin(), plans.end(), [](const Plan &a, const Plan &b)
+                  { return a.entry->lastUsedFrame < b.entry->lastUsedFrame; });
+        for (Plan &plan : plans)
+        {
+            while (wantedBytes > budgetBytes && plan.level < plan.entry->floorLevel)
+            {
+                wantedBytes -= levelBytes(*plan.entry, plan.level);
+                plan.level++;
+                plan.forced = true;
+            }
+            if (wantedBytes <= budgetBytes)
+                break;
+        }
+    }
+
+    residentBytes = 0;
+    for (Plan &plan : plans)
+    {
+        Entry &entry = *plan.entry;
+        bool unused = frame - entry.lastUsedFrame > UNUSED_FRAMES;
+        if (plan.level > entry.residentLevel &&
+            (plan.forced || unused || plan.level - entry.residentLevel >= DROP_HYSTERESIS))
+        {
+            drop(plan.texture, entry, plan.level);
+        }
+        else if (plan.level < entry.residentLevel && entry.uploadTarget < 0)
+        {
+            TextureUploader::Get().enqueue(plan.texture, entry.components, entry.levels,
+                                           entry.residentLevel - 1, plan.level, entry.target);
+            entry.uploadTarget = plan.level;
+        }
+
+        if (entry.residentLevel < static_cast<int>(entry.levels->size()))
+            residentBytes += bytesFrom(entry, entry.residentLevel);
+    }
+}
+
+void TextureResidency::shutdown()
+{
+    // The GL textures belong to their loaders; only the CPU chains are released here
+    textures.clear();
+    residentBytes = 0;
+}
@@ -0,0 +1,271 @@
+#include "TextureUploader.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+// Ring of four 4 MB staging buffers: enough to keep the copy engine busy for a
+// couple of frames without holding much memory.
+static const size_t RING_SLOTS = 4;
+static const size_t SLOT_BYTES = 4 * 1024 * 1024;
+
+// Levels at or below this edge are uploaded for every queued texture before
+// any texture's larger levels, so nothing sits on its placeholder for long.
+static const int COARSE_EDGE = 64;
+
+TextureUploader &TextureUploader::Get()
+{
+    static TextureUploader instance;
+    return instance;
+}
+
+TextureUploader::TextureUploader()
+    : nextSlot(0), pendingBytes(0)
+{
+}
+
+// ===== Mip chain =====
+std::vector<TextureUploader::MipLevel> TextureUploader::BuildMipChain(const unsigned char *pixels, int width, int height, int components)
+{
+    std::vector<MipLevel> levels;
+    MipLevel base;
+    base.width = width;
+    base.height = height;
+    base.pixels.assign(pixels, pixels + static_cast<size_t>(width) * height * components);
+    levels.push_back(std::move(base));
+
+    while (levels.back().width > 1 || levels.back().height > 1)
+    {
+        const MipLevel &src = levels.back();
+        MipLevel dst;
+        dst.width = std::max(1, src.width / 2);
+        dst.height = std::max(1, src.height / 2);
+        dst.pixels.resize(static_cast<size_t>(dst.width) * dst.height * components);
+
+        for (int y = 0; y < dst.height; y++)
+        {
+            int y0 = std::min(src.height - 1, y * 2);
+            int y1 = std::min(src.height - 1, y * 2 + 1);
+            for (int x = 0; x < dst.width; x++)
+            {
+                int x0 = std::min(src.width - 1, x * 2);
+                int x1 = std::min(src.width - 1, x * 2 + 1);
+                for (int c = 0; c < components; c++)
+                {
+                    int sum = src.pixels[(static_cast<size_t>(y0) * src.width + x0) * components + c] +
+                              src.pixels[(static_cast<size_t>(y0) * src.width + x1) * components + c] +
+                              src.pixels[(static_cast<size_t>(y1) * src.width + x0) * components + c] +
+                              src.pixels[(static_cast<size_t>(y1) * src.width + x1) * components + c];
+                    dst.pixels[(static_cast<size_t>(y) * dst.width + x) * components + c] = static_cast<unsigned char>((sum + 2) / 4);
+                }
+            }
+        }
+        levels.push_back(std::move(dst));
+    }
+    return levels;
+}
+
+// ===== Queue =====
+GLenum TextureUploader::FormatFor(int components)
+{
+    return components == 1 ? GL_RED : (components == 4 ? GL_RGBA : GL_RGB);
+}
+
+void TextureUploader::enqueue(unsigned int texture, int components, std::shared_ptr<const std::vector<MipLevel>> levels,
+                              int coarsest, int finest, GLenum target)
+{
+    if (texture == 0 || !levels || levels->empty())
+        return;
+    coarsest = std::min(coarsest, static_cast<int>(levels->size()) - 1);
+    finest = std::max(finest, 0);
+    if (coarsest < finest)
+        return;
+
+    PendingTexture upload;
+    upload.texture = texture;
+    upload.target = target;
+    upload.components = components;
+    upload.format = FormatFor(components);
+    upload.level = coarsest;
+    upload.finest = finest;
+    upload.row = 0;
+    upload.resident = false;
+    for (int level = finest; level <= coarsest; level++)
+        pendingBytes += (*levels)[level].pixels.size();
+    upload.levels = std::move(levels);
+    pending.push_back(std::move(upload));
+}
+
+void TextureUploader::cancel(unsigned int texture)
+{
+    for (auto it = pending.begin(); it != pending.end();)
+    {
+        if (it->texture != texture)
+        {
+            ++it;
+            continue;
+        }
+        const std::vector<MipLevel> &levels = *it->levels;
+        pendingBytes -= levels[it->level].pixels.size() - static_cast<size_t>(levels[it->level].width) * it->components * it->row;
+        for (int level = it->finest; level < it->level; level++)
+            pendingBytes -= levels[level].pixels.size();
+        it = pending.erase(it);
+    }
+}
+
+TextureUploader::PendingTexture *TextureUploader::pickNext()
+{
+    for (PendingTexture &upload : pending)
+    {
+        const MipLevel &level = (*upload.levels)[upload.level];
+        if (std::max(level.width, level.height) <= COARSE_EDGE)
+            return &upload;
+    }
+    return pending.empty() ? nullptr : &pending.front();
+}
+
+TextureUploader::Slot *TextureUploader::acquireSlot(size_t bytes)
+{
+    if (ring.empty())
+    {
+        ring.resize(RING_SLOTS);
+        for (Slot &slot : ring)
+        {
+            glGenBuffers(1, &slot.buffer);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, SLOT_BYTES, nullptr, GL_STREAM_DRAW);
+            slot.capacity = SLOT_BYTES;
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    Slot &slot = ring[nextSlot];
+    if (slot.fence)
+    {
+        // Zero timeout: a slot the GPU is still reading from ends this frame's uploads
+        GLenum status = glClientWaitSync(slot.fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED)
+            return nullptr;
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+    if (bytes > slot.capacity)
+    {
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+        slot.capacity = bytes;
+    }
+    nextSlot = (nextSlot + 1) % ring.size();
+    return &slot;
+}
+
+// ===== Upload =====
+void TextureUploader::update(size_t budgetBytes)
+{
+    size_t uploaded = 0;
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    while (!pending.empty() && uploaded < budgetBytes)
+    {
+        PendingTexture &upload = *pickNext();
+        const MipLevel &level = (*upload.levels)[upload.level];
+        size_t rowBytes = static_cast<size_t>(level.width) * upload.components;
+        bool array = upload.target == GL_TEXTURE_2D_ARRAY;
+        int layer = upload.row / level.height;
+        int y = upload.row % level.height;
+
+        // Strip of whole rows of one layer that fits the slot and what is left of the budget; at least one row
+        int rows = static_cast<int>(std::min(SLOT_BYTES, budgetBytes - uploaded) / rowBytes);
+        rows = std::max(1, std::min(rows, level.height - y));
+        size_t bytes = rowBytes * rows;
+
+        glBindTexture(upload.target, upload.texture);
+        if (upload.row == 0)
+        {
+            // Allocate the level before any buffer is bound, or the null pointer would be read as a PBO offset
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            if (array)
+                glTexImage3D(GL_TEXTURE_2D_ARRAY, upload.level, upload.format, level.width, level.height, level.layers,
+                             0, upload.format, GL_UNSIGNED_BYTE, nullptr);
+            else
+                glTexImage2D(GL_TEXTURE_2D, upload.level, upload.format, level.width, level.height, 0,
+                             upload.format, GL_UNSIGNED_BYTE, nullptr);
+        }
+
+        Slot *slot = acquireSlot(bytes);
+        if (!slot)
+            break;
+
+        void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+                                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (!mapped)
+        {
+            std::cerr << "TextureUploader: failed to map staging buffer" << std::endl;
+            break;
+        }
+        std::memcpy(mapped, level.pixels.data() + rowBytes * upload.row, bytes);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+        if (array)
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, upload.level, 0, y, layer, level.width, rows, 1,
+                            upload.format, GL_UNSIGNED_BYTE, nullptr);
+        else
+            glTexSubImage2D(GL_TEXTURE_2D, upload.level, 0, y, level.width, rows,
+                            upload.format, GL_UNSIGNED_BYTE, nullptr);
+        slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        uploaded += bytes;
+        pendingBytes -= bytes;
+        upload.row += rows;
+        if (upload.row < level.height * level.layers)
+            continue;
+
+        // Level complete: sample from it and everything coarser
+        glTexParameteri(upload.target, GL_TEXTURE_BASE_LEVEL, upload.level);
+        glTexParameteri(upload.target, GL_TEXTURE_MAX_LEVEL, static_cast<int>(upload.levels->size()) - 1);
+        if (!upload.resident)
+        {
+            upload.resident = true;
+            glTexParameteri(upload.target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(upload.target, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glTexParameteri(upload.target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(upload.target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        }
+
+        if (onLevelResident)
+            onLevelResident(upload.texture, upload.level);
+        upload.row = 0;
+        if (upload.level > upload.finest)
+        {
+            upload.level--;
+            continue;
+        }
+
+        for (auto it = pending.begin(); it != pending.end(); ++it)
+        {
+            if (&*it == &upload)
+            {
+                pending.erase(it);
+                break;
+            }
+        }
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void TextureUploader::shutdown()
+{
+    for (Slot &slot : ring)
+    {
+        if (slot.fence)
+            glDeleteSync(slot.fence);
+        glDeleteBuffers(1, &slot.buffer);
+    }
+    ring.clear();
+    pending.clear();
+    pendingBytes = 0;
+}
@@ -0,0 +1,189 @@
+#include "VegetationScatter.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <random>
+#include "TaskGraph.h"
+
+// Candidates tried around an active point before it is retired. They sit just past the
+// spacing at evenly stepped angles (Roberts' variant of Bridson), which packs tighter and
+// needs far fewer tries than random ones between one and two spacings.
+static const int CandidatesPerPoint = 12;
+
+// Seed of one chunk: the scatter seed and the chunk's cell, mixed (splitmix64 finalizer)
+static uint32_t chunkSeed(uint32_t seed, int cellX, int cellZ)
+{
+    uint64_t h = (static_cast<uint64_t>(seed) << 32) ^ (static_cast<uint64_t>(static_cast<uint32_t>(cellX)) << 16) ^
+                 static_cast<uint64_t>(static_cast<uint32_t>(cellZ)) * 0x9E3779B97F4A7C15ull;
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+    return static_cast<uint32_t>(h ^ (h >> 31));
+}
+
+void VegetationScatter::addExclusion(const glm::vec2 &min, const glm::vec2 &max)
+{
+    exclusions.push_back({min, max});
+}
+
+void VegetationScatter::addClearing(const glm::vec2 &a, const glm::vec2 &b, float radius)
+{
+    clearings.push_back({a, b, radius});
+}
+
+bool VegetationScatter::isExcluded(const glm::vec2 &point) const
+{
+    for (const Exclusion &exclusion : exclusions)
+    {
+        if (point.x >= exclusion.min.x && point.x <= exclusion.max.x && point.y >= exclusion.min.y &&
+            point.y <= exclusion.max.y)
+            return true;
+    }
+    for (const Clearing &clearing : clearings)
+    {
+        // Distance to the nearest point of the segment
+        glm::vec2 segment = clearing.b - clearing.a;
+        float lengthSquared = glm::dot(segment, segment);
+        float t = lengthSquared > 0.0f ? glm::dot(point - clearing.a, segment) / lengthSquared : 0.0f;
+        glm::vec2 offset = point - (clearing.a + segment * std::min(std::max(t, 0.0f), 1.0f));
+        if (glm::dot(offset, offset) < clearing.radius * clearing.radius)
+            return true;
+    }
+    return false;
+}
+
+std::vector<VegetationScatter::Chunk> VegetationScatter::generate(const Settings &settings, const DensityMap &density,
+                                                                  const Placement &placement) const
+{
+    std::vector<Chunk> chunks;
+    if (settings.chunkSize <= 0.0f || settings.spacing <= 0.0f || settings.max.x <= settings.min.x ||
+        settings.max.y <= settings.min.y)
+        return chunks;
+
+    int columns = static_cast<int>(std::ceil((settings.max.x - settings.min.x) / settings.chunkSize));
+    int rows = static_cast<int>(std::ceil((settings.max.y - settings.min.y) / settings.chunkSize));
+    chunks.resize(static_cast<size_t>(columns) * rows);
+    for (int z = 0; z < rows; z++)
+    {
+        for (int x = 0; x < columns; x++)
+        {
+            Chunk &chunk = chunks[static_cast<size_t>(z) * columns + x];
+            chunk.cellX = x;
+            chunk.cellZ = z;
+            chunk.min = settings.min + glm::vec2(x, z) * settings.chunkSize;
+            chunk.max = glm::min(chunk.min + glm::vec2(settings.chunkSize), settings.max);
+        }
+    }
+
+    // Chunks share nothing, so each is one task
+    TaskGraph graph;
+    for (Chunk &chunk : chunks)
+    {
+        graph.add("scatter chunk", TaskAffinity::Worker, [this, &settings, &density, &placement, &chunk]()
+                  { generateChunk(settings, density, placement, chunk); });
+    }
+    graph.run();
+    return chunks;
+}
+
+void VegetationScatter::generateChunk(const Settings &settings, const DensityMap &density, const Placement &placement,
+                                      Chunk &chunk) const
+{
+    auto start = std::chrono::steady_clock::now();
+    std::mt19937 random(chunkSeed(settings.seed, chunk.cellX, chunk.cellZ));
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    // Half the spacing in from every edge, so points of neighbouring chunks are a full spacing apart
+    float spacing = settings.spacing;
+    glm::vec2 low = chunk.min + glm::vec2(0.5f * spacing);
+    glm::vec2 high = chunk.max - glm::vec2(0.5f * spacing);
+    std::vector<glm::vec2> samples;
+    if (high.x >= low.x && high.y >= low.y)
+    {
+        // Background grid of cells small enough to hold one sample each (Bridson)
+        float cellSize = spacing / std::sqrt(2.0f);
+        int gridWidth = static_cast<int>((high.x - low.x) / cellSize) + 1;
+        int gridHeight = static_cast<int>((high.y - low.y) / cellSize) + 1;
+        // Cells hold their sample's position, far away when empty, so a test never leaves the grid
+        const glm::vec2 empty(std::numeric_limits<float>::max());
+        std::vector<glm::vec2> grid(static_cast<size_t>(gridWidth) * gridHeight, empty);
+        std::vector<int> active;
+
+        auto addSample = [&](const glm::vec2 &sample)
+        {
+            int gx = static_cast<int>((sample.x - low.x) / cellSize);
+            int gy = static_cast<int>((sample.y - low.y) / cellSize);
+            grid[static_cast<size_t>(gy) * gridWidth + gx] = sample;
+            active.push_back(static_cast<int>(samples.size()));
+            samples.push_back(sample);
+        };
+        float spacingSquared = spacing * spacing;
+        auto isFarEnough = [&](const glm::vec2 &candidate)
+        {
+            int gx = static_cast<int>((candidate.x - low.x) / cellSize);
+            int gy = static_cast<int>((candidate.y - low.y) / cellSize);
+            for (int y = std::max(gy - 2, 0); y <= std::min(gy + 2, gridHeight - 1); y++)
+            {
+                for (int x = std::max(gx - 2, 0); x <= std::min(gx + 2, gridWidth - 1); x++)
+                {
+                    glm::vec2 offset = grid[static_cast<size_t>(y) * gridWidth + x] - candidate;
+                    if (glm::dot(offset, offset) < spacingSquared)
+                        return false;
+                }
+            }
+            return true;
+        };
+
+        // The ring of candidate directions, turned by a random angle for each active point
+        glm::vec2 ring[CandidatesPerPoint];
+        for (int i = 0; i < CandidatesPerPoint; i++)
+        {
+            float angle = 6.2831853f * i / CandidatesPerPoint;
+            ring[i] = 1.0001f * spacing * glm::vec2(std::cos(angle), std::sin(angle));
+        }
+
+        addSample(low + glm::vec2(unit(random), unit(random)) * (high - low));
+        while (!active.empty())
+        {
+            size_t pick = static_cast<size_t>(unit(random) * active.size()) % active.size();
+            glm::vec2 origin = samples[active[pick]];
+            float turn = unit(random) * 6.2831853f;
+            float cosTurn = std::cos(turn);
+            float sinTurn = std::sin(turn);
+            bool placed = false;
+            for (int attempt = 0; attempt < CandidatesPerPoint && !placed; attempt++)
+            {
+                const glm::vec2 &step = ring[attempt];
+                glm::vec2 candidate = origin + glm::vec2(step.x * cosTurn - step.y * sinTurn, step.x * sinTurn + step.y * cosTurn);
+                if (candidate.x < low.x || candidate.y < low.y || candidate.x > high.x || candidate.y > high.y ||
+                    !isFarEnough(candidate))
+                    continue;
+                addSample(candidate);
+                placed = true;
+            }
+            if (!placed)
+            {
+                active[pick] = active.back();
+                active.pop_back();
+            }
+        }
+    }
+
+    // Thinning keeps the spacing, so a sparse area is still blue noise
+    chunk.points.clear();
+    chunk.matrices.clear();
+    for (const glm::vec2 &sample : samples)
+    {
+        float keep = unit(random);
+        float rotation = unit(random) * 6.2831853f;
+        float scale = settings.minScale + unit(random) * (settings.maxScale - settings.minScale);
+        if (isExcluded(sample) || (density && keep >= density(sample.x, sample.y)))
+            continue;
+        Point point = {sample, rotation, scale};
+        chunk.points.push_back(point);
+        if (placement)
+            chunk.matrices.push_back(placement(point));
+    }
+
+    chunk.generationMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,266 @@
+#include "VirtualFileSystem.h"
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+static const char *envValue(const char *name)
+{
+    const char *value = std::getenv(name);
+    return (value && value[0] != '\0') ? value : nullptr;
+}
+
+VirtualFileSystem &VirtualFileSystem::Get()
+{
+    static VirtualFileSystem instance;
+    return instance;
+}
+
+void VirtualFileSystem::mountDefaults()
+{
+    // Held until every default is mounted, so a lookup racing the first call waits for the
+    // full mount set instead of memoising misses against a partial one
+    std::lock_guard<std::mutex> mountLock(defaultsMutex);
+    if (defaultsMounted)
+        return;
+
+    // Asset root: resolved once instead of probing on every lookup
+    if (const char *root = envValue("SIMPLECATAPULT_ASSET_ROOT"))
+    {
+        mountDirectory(root);
+    }
+    else
+    {
+        const std::string candidates[] = {".", "..", "../.."};
+        for (const auto &root : candidates)
+        {
+            std::error_code ec;
+            if (fs::is_directory(fs::path(root) / "images", ec))
+            {
+                mountDirectory(root);
+                break;
+            }
+        }
+    }
+
+    const char *loose = envValue("SIMPLECATAPULT_LOOSE_ASSETS");
+    if (loose && loose[0] != '0')
+    {
+        std::cout << "Asset pack disabled, loading loose files" << std::endl;
+    }
+    else if (const char *packPath = envValue("SIMPLECATAPULT_ASSET_PACK"))
+    {
+        mountPack(packPath);
+    }
+    else
+    {
+        const std::string candidates[] = {"assets.pak", "../assets.pak", "build/assets.pak"};
+        bool mounted = false;
+        for (const auto &path : candidates)
+        {
+            if (mountPack(path))
+            {
+                mounted = true;
+                break;
+            }
+        }
+        if (!mounted)
+            std::cout << "No asset pack found, loading loose files" << std::endl;
+    }
+
+    if (const char *overrideRoot = envValue("SIMPLECATAPULT_ASSET_OVERRIDE"))
+        mountDirectory(overrideRoot);
+    defaultsMounted = true;
+}
+
+bool VirtualFileSystem::mountDirectory(const std::string &root)
+{
+    Mount mount;
+    mount.root = root;
+
+    std::error_code ec;
+    const char *folders[] = {"images", "shaders"};
+    for (const char *folder : folders)
+    {
+        fs::path dir = fs::path(root) / folder;
+        if (!fs::is_directory(dir, ec))
+            continue;
+
+        for (fs::recursive_directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec))
+        {
+            if (it->is_regular_file(ec))
+                mount.files.insert(AssetPack::NormalizePath(std::string(folder) + "/" + fs::relative(it->path(), dir, ec).generic_string()));
+        }
+    }
+
+    if (mount.files.empty())
+    {
+        std::cerr << "Asset directory has no images/ or shaders/: " << root << std::endl;
+        return false;
+    }
+
+    std::cout << "Mounted asset directory: " << root << " (" << mount.files.size() << " files)" << std::endl;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    mounts.push_back(std::move(mount));
+    resolvedPaths.clear();
+    return true;
+}
+
+bool VirtualFileSystem::mountPack(const std::string &packPath)
+{
+    Mount mount;
+    mount.pack.reset(new AssetPack());
+    if (!mount.pack->open(packPath))
+        return false;
+
+    std::cout << "Mounted asset pack: " << packPath << " (" << mount.pack->getEntryCount() << " entries)" << std::endl;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    mounts.push_back(std::move(mount));
+    resolvedPaths.clear();
+    return true;
+}
+
+void VirtualFileSystem::unmountAll()
+{
+    std::lock_guard<std::mutex> mountLock(defaultsMutex);
+    std::lock_guard<std::mutex> lock(mutex);
+    mounts.clear();
+    resolvedPaths.clear();
+    defaultsMounted = false;
+}
+
+const VirtualFileSystem::Resolved &VirtualFileSystem::lookup(const std::string &path)
+{
+    auto cached = resolvedPaths.find(path);
+    if (cached != resolvedPaths.end())
+        return cached->second;
+
+    Resolved resolved;
+    resolved.key = AssetPack::NormalizePath(path);
+    resolved.mount = -1;
+    for (int i = static_cast<int>(mounts.size()) - 1; i >= 0; i--)
+    {
+        const Mount &mount = mounts[i];
+        if (mount.pack ? mount.pack->contains(resolved.key) : mount.files.count(resolved.key) > 0)
+        {
+            resolved.mount = i;
+            break;
+        }
+    }
+    return resolvedPaths.emplace(path, resolved).first->second;
+}
+
+bool VirtualFileSystem::exists(const std::string &path)
+{
+    mountDefaults();
+    std::lock_guard<std::mutex> lock(mutex);
+    return lookup(path).mount >= 0;
+}
+
+std::string VirtualFileSystem::resolve(const std::string &path)
+{
+    mountDefaults();
+    std::lock_guard<std::mutex> lock(mutex);
+    return lookup(path).key;
+}
+
+AssetData VirtualFileSystem::open(const std::string &path)
+{
+    mountDefaults();
+
+    AssetData asset;
+    std::string diskPath;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const Resolved &resolved = lookup(path);
+        if (resolved.mount < 0)
+            return asset;
+
+        const Mount &mount = mounts[resolved.mount];
+        if (mount.pack)
+        {
+            asset.bytes = mount.pack->find(resolved.key, asset.length);
+            return asset;
+        }
+        diskPath = mount.root + "/" + resolved.key;
+    }
+
+    // Loose files get their own mapping so callers see the same zero-copy view as packed ones
+    asset.mapping.reset(new MappedFile());
+    if (asset.mapping->open(diskPath))
+    {
+        asset.bytes = asset.mapping->data();
+        asset.length = asset.mapping->size();
+    }
+    else
+    {
+        asset.mapping.reset();
+    }
+    return asset;
+}
+
+std::string VirtualFileSystem::readText(const std::string &path)
+{
+    return open(path).text();
+}
+
+const AssetPack *VirtualFileSystem::getPack() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = mounts.rbegin(); it != mounts.rend(); ++it)
+    {
+        if (it->pack)
+            return it->pack.get();
+    }
+    return nullptr;
+}
+
+std::string VirtualFileSystem::getDiskPath(const std::string &path)
+{
+    mountDefaults();
+    std::lock_guard<std::mutex> lock(mutex);
+    const Resolved &resolved = lookup(path);
+    if (resolved.mount < 0 || mounts[resolved.mount].pack)
+        return "";
+    return mounts[resolved.mount].root + "/" + resolved.key;
+}
+
+uint64_t VirtualFileSystem::fingerprint(const std::string &path)
+{
+    mountDefaults();
+
+    std::string diskPath;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const Resolved &resolved = lookup(path);
+        if (resolved.mount < 0)
+            return 0;
+
+        const Mount &mount = mounts[resolved.mount];
+        if (mount.pack)
+            return mount.pack->findEntry(resolved.key)->contentHash;
+        diskPath = mount.root + "/" + resolved.key;
+    }
+
+    std::error_code ec;
+    uint64_t values[2] = {
+        static_cast<uint64_t>(fs::file_size(diskPath, ec)),
+        static_cast<uint64_t>(fs::last_write_time(diskPath, ec).time_since_epoch().count())};
+    uint64_t hash = AssetPack::HashBytes(values, sizeof(values));
+
+    // Hashing a multi-hundred-MB HDR on every launch would cost more than the cache saves
+    AssetData asset = open(path);
+    if (asset.valid())
+    {
+        const size_t sample = 64 * 1024;
+        size_t head = std::min(sample, asset.size());
+        hash = AssetPack::HashBytes(asset.data(), head, hash);
+        if (asset.size() > sample)
+            hash = AssetPack::HashBytes(asset.data() + asset.size() - sample, sample, hash);
+    }
+    return hash;
+}
@@ -23,7 +23,9 @@ Zombie::Zombie(const std::string &modelPath,
       walkCycle(0.0f), walkSpeed(8.0f), isMoving(false),
       health(100.0f), maxHealth(100.0f) // Default health: 100, boss zombies can have more
 {
-    model = new Model(modelPath);
+    // Streamed so spawning and respawning never stall a frame on an FBX import
+    model = new Model(modelPath, true);
+    model->setProxyShape(ProxyShape::Capsule);
 
     // Initialize animation cache on first zombie creation
     if (animationCacheLoaded.empty())
@@ -79,19 +81,26 @@ Zombie::~Zombie()
     delete model;
 }
 
-void Zombie::initializeAnimationCache()
+std::vector<std::string> Zombie::GetAnimationPaths()
 {
-    // Pre-load all animations into the cache (only called once)
-    std::vector<std::string> animationPaths = {
+    return {
         FindImagePath("zombie/animation/Zombie Idle2.fbx"),
         FindImagePath("zombie/animation/Zombie Walk2.fbx"),
         FindImagePath("zombie/animation/Zombie Running2.fbx"),
         FindImagePath("zombie/animation/Zombie Attack (2).fbx")};
+}
 
-    // Mark all animations as available (they'll be loaded on first use)
+void Zombie::initializeAnimationCache()
+{
+    // Pre-load all animations into the cache (only called once)
+    std::vector<std::string> animationPaths = GetAnimationPaths();
+
+    // Mark all animations as available and import them on the streamer's workers,
+    // so the first switch into each state finds its clip already in the shared cache
     for (const auto &path : animationPaths)
     {
-        animationCacheLoaded[path] = false; 
+        animationCacheLoaded[path] = false;
+        Model::PrefetchAnimation(path);
     }
 }
 
@@ -358,13 +367,8 @@ void Zombie::moveTowardsTarget(float deltaTime, const glm::vec3 &targetPosition,
     }
 }
 
-void Zombie::draw(unsigned int shaderProgram)
+glm::mat4 Zombie::getModelMatrix() const
 {
-    if (!alive)
-        return;
-
-    glUseProgram(shaderProgram);
-
     // Build model matrix
     glm::mat4 modelMatrix = glm::mat4(1.0f);
 
@@ -375,16 +379,29 @@ void Zombie::draw(unsigned int shaderProgram)
     modelMatrix = glm::rotate(modelMatrix, rotation.y, glm::vec3(0.0f, 1.0f, 0.0f));
 
     // Scale the zombie (uses configurable scale value)
-    modelMatrix = glm::scale(modelMatrix, glm::vec3(scale));
+    return glm::scale(modelMatrix, glm::vec3(scale));
+}
+
+void Zombie::addBounds(CullBounds &bounds) const
+{
+    if (!model || !model->hasBounds())
+    {
+        bounds.addUnbounded();
+        return;
+    }
+    // Animation swings limbs outside the bind pose box, so it gets some slack
+    bounds.add(getModelMatrix(), model->getCenter(), model->getSize() * 1.5f);
+}
 
-    // Set model matrix uniform
-    unsigned int modelLoc = glGetUniformLocation(shaderProgram, "model");
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(modelMatrix));
+void Zombie::draw(unsigned int occlusionQuery)
+{
+    if (!alive)
+        return;
 
-    // Set color (will be overridden by texture if available)
-    unsigned int colorLoc = glGetUniformLocation(shaderProgram, "objectColor");
-    glUniform3f(colorLoc, 0.8f, 0.8f, 0.8f);
+    glm::mat4 modelMatrix = getModelMatrix();
 
-    // Draw the model
-    model->Draw(shaderProgram);
+    // The model picks the skinned and textured permutation itself. The color is
+    // overridden by the texture if available.
+    model->noteTextureUsage(modelMatrix);
+    model->Draw(modelMatrix, glm::vec3(0.8f, 0.8f, 0.8f), occlusionQuery);
 }
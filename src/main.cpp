@@ -12,9 +12,24 @@
 #include "Camera.h"
 #include "Terrain.h"
 #include "Projectile.h"
+#include "ShaderManager.h"
+#include "ShaderPermutations.h"
+#include "FrustumCuller.h"
+#include "GLState.h"
+#include "OcclusionCuller.h"
+#include "RenderQueue.h"
+#include "SoftwareOcclusion.h"
 #include "Skybox.h"
 #include "Zombie.h"
 #include "PathUtils.h"
+#include "AssetStreamer.h"
+#include "TaskGraph.h"
+#include "TextureArrays.h"
+#include "TextureResidency.h"
+#include "TextureUploader.h"
+#include <cmath>
+#include <cstdlib>
+#include <memory>
 #include <vector>
 #include <map>
 
@@ -57,6 +72,20 @@ float projectileFollowDistance = 5.0f;
 float projectileFollowHeight = 2.0f;
 float projectileFollowZoom = 60.0f;
 
+// Asset streaming: GL work allowed per frame for finished background loads
+float streamingUploadBudgetMs = 2.0f;
+size_t streamingUploadBudgetBytes = 8 * 1024 * 1024;
+// Texel bytes copied through the PBO ring per frame (SIMPLECATAPULT_TEXTURE_UPLOAD_KB overrides)
+size_t textureUploadBudgetBytes = 4 * 1024 * 1024;
+// Video memory streamed textures may keep resident (SIMPLECATAPULT_TEXTURE_BUDGET_MB overrides)
+size_t textureResidencyBudgetBytes = 256 * 1024 * 1024;
+// Progressive boot: render from the first frame with a gradient sky and proxy geometry, and
+// finish the startup graph behind the render loop (SIMPLECATAPULT_PROGRESSIVE_BOOT=0 waits instead)
+bool progressiveBoot = true;
+float startupGraphBudgetMs = 4.0f;
+// Once a second, print the previous frame's render counters (SIMPLECATAPULT_RENDER_STATS=1)
+bool renderStats = false;
+
 // Projectile and Catapult
 Projectile *bomb = nullptr;
 Catapult *catapultPtr = nullptr;
@@ -258,18 +287,21 @@ void scroll_callback(GLFWwindow *window, double xoffset, double yoffset)
 }
 
 // ===== Health Display HUD =====
-void renderHealthBar(GLFWwindow *window, unsigned int shaderProgram, float health, float maxHealth, const glm::mat4 &originalProjection, const glm::mat4 &originalView)
+void renderHealthBar(GLFWwindow *window, float health, float maxHealth, const glm::mat4 &originalProjection, const glm::mat4 &originalView)
 {
     int width, height;
     glfwGetFramebufferSize(window, &width, &height);
 
-    // Store current state
-    GLboolean depthTestEnabled;
-    glGetBooleanv(GL_DEPTH_TEST, &depthTestEnabled);
-    glDisable(GL_DEPTH_TEST);
+    // Plain colour quads: the untextured, unskinned permutation
+    ShaderPermutations &shaders = ShaderPermutations::Get();
+    ShaderProgram *program = shaders.use(0);
+    if (!program)
+        return;
 
-    // Use shader program
-    glUseProgram(shaderProgram);
+    // Store current state; the shadow answers without a driver round trip
+    GLState &state = GLState::Get();
+    bool depthTestEnabled = state.isDepthTestEnabled();
+    state.setDepthTest(false);
 
     // Create orthographic projection for 2D HUD
     glm::mat4 projection = glm::ortho(0.0f, (float)width, (float)height, 0.0f, -1.0f, 1.0f);
@@ -295,14 +327,8 @@ void renderHealthBar(GLFWwindow *window, unsigned int shaderProgram, float healt
     }
 
     // Set uniforms
-    unsigned int hudProjLoc = glGetUniformLocation(shaderProgram, "projection");
-    unsigned int hudViewLoc = glGetUniformLocation(shaderProgram, "view");
-    unsigned int hudModelLoc = glGetUniformLocation(shaderProgram, "model");
-    unsigned int hudColorLoc = glGetUniformLocation(shaderProgram, "objectColor");
-
-    glUniformMatrix4fv(hudProjLoc, 1, GL_FALSE, glm::value_ptr(projection));
-    glUniformMatrix4fv(hudViewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniform1i(glGetUniformLocation(shaderProgram, "useTexture"), 0);
+    program->set("projection", projection);
+    program->set("view", view);
 
     // Draw background (dark red/black)
     float bgVertices[] = {
@@ -313,8 +339,8 @@ void renderHealthBar(GLFWwindow *window, unsigned int shaderProgram, float healt
         barX + barWidth, barY + barHeight, 0.0f, 0.0f, 1.0f, 0.0f,
         barX, barY + barHeight, 0.0f, 0.0f, 1.0f, 0.0f};
 
-    glBindVertexArray(healthBarVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, healthBarVBO);
+    state.bindVertexArray(healthBarVAO);
+    state.bindBuffer(GL_ARRAY_BUFFER, healthBarVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(bgVertices), bgVertices, GL_DYNAMIC_DRAW);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)0);
     glEnableVertexAttribArray(0);
@@ -322,8 +348,8 @@ void renderHealthBar(GLFWwindow *window, unsigned int shaderProgram, float healt
     glEnableVertexAttribArray(1);
 
     glm::mat4 hudModel = glm::mat4(1.0f);
-    glUniformMatrix4fv(hudModelLoc, 1, GL_FALSE, glm::value_ptr(hudModel));
-    glUniform3f(hudColorLoc, 0.2f, 0.0f, 0.0f);
+    shaders.setModel(hudModel);
+    shaders.setColor(glm::vec3(0.2f, 0.0f, 0.0f));
     glDrawArrays(GL_TRIANGLES, 0, 6);
 
     // Draw health bar (green to red gradient)
@@ -353,7 +379,7 @@ void renderHealthBar(GLFWwindow *window, unsigned int shaderProgram, float healt
         barX, barY + barHeight, 0.0f, 0.0f, 1.0f, 0.0f};
 
     glBufferData(GL_ARRAY_BUFFER, sizeof(healthVertices), healthVertices, GL_DYNAMIC_DRAW);
-    glUniform3f(hudColorLoc, healthColorR, healthColorG, healthColorB);
+    shaders.setColor(glm::vec3(healthColorR, healthColorG, healthColorB));
     glDrawArrays(GL_TRIANGLES, 0, 6);
 
     // Draw border (white outline)
@@ -389,66 +415,18 @@ void renderHealthBar(GLFWwindow *window, unsigned int shaderProgram, float healt
         barX + barWidth - borderThickness, barY + barHeight, 0.0f, 0.0f, 1.0f, 0.0f};
 
     glBufferData(GL_ARRAY_BUFFER, sizeof(borderVertices), borderVertices, GL_DYNAMIC_DRAW);
-    glUniform3f(hudColorLoc, 1.0f, 1.0f, 1.0f);
+    shaders.setColor(glm::vec3(1.0f, 1.0f, 1.0f));
     glDrawArrays(GL_TRIANGLES, 0, 24);
 
-    glBindVertexArray(0);
+    // Loaders run between frames and bind element buffers, which would land in a VAO left bound
+    state.bindVertexArray(0);
 
     // Restore original projection and view matrices
-    unsigned int restoreProjLoc = glGetUniformLocation(shaderProgram, "projection");
-    unsigned int restoreViewLoc = glGetUniformLocation(shaderProgram, "view");
-    glUniformMatrix4fv(restoreProjLoc, 1, GL_FALSE, glm::value_ptr(originalProjection));
-    glUniformMatrix4fv(restoreViewLoc, 1, GL_FALSE, glm::value_ptr(originalView));
+    program->set("projection", originalProjection);
+    program->set("view", originalView);
 
     // Restore depth test state
-    if (depthTestEnabled)
-    {
-        glEnable(GL_DEPTH_TEST);
-    }
-}
-
-// ===== Shader Helpers =====
-std::string loadShaderSource(const std::string &path)
-{
-    std::ifstream file(path);
-    if (!file.is_open())
-        file.open("../" + path);
-
-    if (!file.is_open())
-    {
-        std::cerr << "Error: Shader file not found at '" << path << "' or '../" << path << "'." << std::endl;
-        return "";
-    }
-
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    return buffer.str();
-}
-
-unsigned int compileShader(const std::string &vertexPath, const std::string &fragmentPath)
-{
-    std::string vertexCode = loadShaderSource(vertexPath);
-    std::string fragmentCode = loadShaderSource(fragmentPath);
-    const char *vShaderCode = vertexCode.c_str();
-    const char *fShaderCode = fragmentCode.c_str();
-
-    unsigned int vertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex, 1, &vShaderCode, NULL);
-    glCompileShader(vertex);
-
-    unsigned int fragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment, 1, &fShaderCode, NULL);
-    glCompileShader(fragment);
-
-    unsigned int program = glCreateProgram();
-    glAttachShader(program, vertex);
-    glAttachShader(program, fragment);
-    glLinkProgram(program);
-
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
-
-    return program;
+    state.setDepthTest(depthTestEnabled);
 }
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height)
@@ -494,6 +472,38 @@ int main()
 
     glEnable(GL_DEPTH_TEST);
     std::cout << "OpenGL Version: " << glGetString(GL_VERSION) << std::endl;
+    ShaderManager::Get().init();
+
+    // ===== Mount Assets =====
+    // Asset root is resolved once; a mapped pack replaces hundreds of individual file opens
+    VirtualFileSystem::Get().mountDefaults();
+    AssetStreamer::Get().start();
+    if (const char *budget = std::getenv("SIMPLECATAPULT_TEXTURE_UPLOAD_KB"))
+    {
+        long kilobytes = std::atol(budget);
+        if (kilobytes > 0)
+            textureUploadBudgetBytes = static_cast<size_t>(kilobytes) * 1024;
+    }
+    if (const char *budget = std::getenv("SIMPLECATAPULT_TEXTURE_BUDGET_MB"))
+    {
+        long megabytes = std::atol(budget);
+        if (megabytes > 0)
+            textureResidencyBudgetBytes = static_cast<size_t>(megabytes) * 1024 * 1024;
+    }
+    TextureResidency::Get().setBudget(textureResidencyBudgetBytes);
+    if (const char *progressive = std::getenv("SIMPLECATAPULT_PROGRESSIVE_BOOT"))
+        progressiveBoot = std::atoi(progressive) != 0;
+    if (const char *stats = std::getenv("SIMPLECATAPULT_RENDER_STATS"))
+        renderStats = std::atoi(stats) != 0;
+    // "cpu" rasterizes the walls in software; "gpu" or any nonzero number uses hardware queries
+    if (const char *occlusion = std::getenv("SIMPLECATAPULT_OCCLUSION"))
+    {
+        std::string mode = occlusion;
+        if (mode == "cpu")
+            SoftwareOcclusion::Get().start();
+        else
+            OcclusionCuller::Get().setEnabled(mode == "gpu" || std::atoi(occlusion) != 0);
+    }
 
     // Create a default white texture to avoid OpenGL texture binding errors
     if (defaultWhiteTexture == 0)
@@ -507,20 +517,71 @@ int main()
         glBindTexture(GL_TEXTURE_2D, 0);
     }
 
-    // ===== Compile Shaders =====
+    // ===== Startup Graph =====
+    // File reads, decodes and imports run on every core; GL objects are created on this thread
+    // as soon as their inputs are ready. Imports land in Model's shared cache, so the
+    // constructors below only build GPU resources.
     std::string vertexPath = "../shaders/vertex.glsl";
     std::string fragmentPath = "../shaders/fragment.glsl";
-    unsigned int shaderProgram = compileShader(vertexPath, fragmentPath);
+    std::string zombieModelPath = FindImagePath("zombie/uploads_files_2137887_zombie_fbx_rigged.fbx");
+    // Permutations every frame draws with; with parallel compile the driver builds them while
+    // the graph and terrain run. Others are built the first time a draw asks for them.
+    ShaderPermutations::Get().load(vertexPath, fragmentPath);
+    ShaderPermutations::Get().prepare({0, SHADER_TEXTURED, SHADER_TEXTURED | SHADER_TEXTURE_ARRAY,
+                                       SHADER_SKINNED | SHADER_TEXTURED, SHADER_INSTANCED,
+                                       SHADER_INSTANCED | SHADER_TEXTURED | SHADER_TEXTURE_ARRAY,
+                                       SHADER_DITHER_FADE | SHADER_TEXTURED | SHADER_TEXTURE_ARRAY});
+    Skybox skybox;
+    std::unique_ptr<Terrain> terrainOwner;
+
+    auto fileName = [](const std::string &path)
+    {
+        return path.substr(path.find_last_of('/') + 1);
+    };
 
-    // ===== Create Skybox =====
-    Skybox skybox(FindImagePath("Skybox/kloofendal_48d_partly_cloudy_puresky_16k.hdr"));
+    TaskGraph startup;
+    TaskGraph::TaskId skyLoad = startup.add("sky: load", TaskAffinity::Worker, [&]()
+                                            { skybox.load(FindImagePath("Skybox/kloofendal_48d_partly_cloudy_puresky_16k.hdr")); });
+    std::vector<TaskGraph::TaskId> terrainImports;
+    for (const std::string &path : Terrain::GetModelPaths())
+    {
+        terrainImports.push_back(startup.add("import " + fileName(path), TaskAffinity::Worker, [path]()
+                                             { Model::ImportScene(path, Model::ModelImportFlags); }));
+    }
+    startup.add("import zombie", TaskAffinity::Worker, [zombieModelPath]()
+                { Model::ImportScene(zombieModelPath, Model::ModelImportFlags); });
+    for (const std::string &path : Zombie::GetAnimationPaths())
+    {
+        startup.add("import " + fileName(path), TaskAffinity::Worker, [path]()
+                    { Model::ImportScene(path, Model::AnimationImportFlags); });
+    }
+    startup.add("sky: gpu", TaskAffinity::MainThread, [&]()
+                { skybox.createResources(); }, {skyLoad});
+
+    if (progressiveBoot)
+    {
+        // Only what the first frame cannot do without happens up front. The imports above warm
+        // the cache the streamed models read from; the sky swaps in when "sky: gpu" runs.
+        terrainOwner.reset(new Terrain(60.0f, 20, glm::vec3(0.0f), true));
+        ShaderPermutations::Get().finishPending();
+        startup.start();
+    }
+    else
+    {
+        startup.add("shaders", TaskAffinity::MainThread, [&]()
+                    { ShaderPermutations::Get().finishPending(); });
+        startup.add("terrain", TaskAffinity::MainThread, [&]()
+                    { terrainOwner.reset(new Terrain(60.0f)); }, terrainImports);
+        startup.run();
+        startup.printReport();
+    }
+    Terrain &terrain = *terrainOwner;
 
     // Create bomb AFTER context and GLEW are initialized
     bomb = new Projectile(glm::vec3(0.0f, 0.5f, 0.0f));
 
     // ===== Sun position for lighting (sun is in skybox) =====
     glm::vec3 sunPosition = glm::vec3(5.0f, 9.0f, -2.0f);
-    Terrain terrain(60.0f);
     Catapult catapult;
     catapultPtr = &catapult;
 
@@ -596,8 +657,6 @@ int main()
     // ============================================================================
     // ===== ZOMBIE CONFIGURATION SECTION =====
     // ============================================================================
-    std::string zombieModelPath = FindImagePath("zombie/uploads_files_2137887_zombie_fbx_rigged.fbx");
-
     // Zombie configuration structure (used for both initial spawn and respawn)
     struct ZombieConfig
     {
@@ -666,6 +725,24 @@ int main()
     }
 
     std::cout << "Spawned " << zombies.size() << " zombies with custom configurations!" << std::endl;
+
+    // The tree scatter must leave the catapult start, the zombie spawns and their patrol paths
+    // open, or checkTreeCollision would pin them in place
+    std::vector<TreeClearing> treeClearings;
+    glm::vec2 catapultStart(catapultStartPosition.x, catapultStartPosition.z);
+    treeClearings.push_back({catapultStart, catapultStart, 3.0f});
+    for (const auto &config : zombieConfigs)
+    {
+        glm::vec2 spawn(config.position.x, config.position.z);
+        treeClearings.push_back({spawn, spawn, 1.5f});
+        if (config.behavior == ZombieBehavior::PATROL)
+        {
+            treeClearings.push_back({spawn, glm::vec2(config.patrolA.x, config.patrolA.z), 1.5f});
+            treeClearings.push_back({glm::vec2(config.patrolA.x, config.patrolA.z),
+                                     glm::vec2(config.patrolB.x, config.patrolB.z), 1.5f});
+        }
+    }
+    terrain.setTreeClearings(treeClearings);
     // ============================================================================
     // ===== END OF ZOMBIE CONFIGURATION =====
     // ============================================================================
@@ -724,6 +801,7 @@ int main()
         // Delete and respawn all zombies
         for (auto *zombie : zombies)
         {
+            OcclusionCuller::Get().forget(zombie);
             delete zombie;
         }
         zombies.clear();
@@ -854,6 +932,17 @@ int main()
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
+        // Upload whatever the streaming workers finished, within this frame's budget
+        if (!startup.isFinished())
+        {
+            startup.poll(startupGraphBudgetMs);
+            if (startup.isFinished())
+                startup.printReport();
+        }
+        AssetStreamer::Get().processUploads(streamingUploadBudgetMs, streamingUploadBudgetBytes);
+        TextureResidency::Get().update();
+        TextureUploader::Get().update(textureUploadBudgetBytes);
+
         processInput(window, terrain);
 
         // If we just exited free-look mode due to catapult movement, reset camera to catapult position
@@ -1201,33 +1290,51 @@ int main()
         int width, height;
         glfwGetFramebufferSize(window, &width, &height);
         glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)width / (float)height, 0.1f, 100.0f);
+        TextureResidency::Get().setView(camera.Position, height / (2.0f * std::tan(glm::radians(camera.Zoom) * 0.5f)));
+
+        // Loaders and streaming bind behind the state cache's back between frames
+        GLState &state = GLState::Get();
+        state.invalidate();
 
         // ===== Draw Skybox First =====
         skybox.Draw(view, projection, deltaTime);
 
-        glUseProgram(shaderProgram);
-
-        unsigned int modelLoc = glGetUniformLocation(shaderProgram, "model");
-        unsigned int viewLoc = glGetUniformLocation(shaderProgram, "view");
-        unsigned int projLoc = glGetUniformLocation(shaderProgram, "projection");
-        unsigned int colorLoc = glGetUniformLocation(shaderProgram, "objectColor");
-
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-
-        glUniform1i(glGetUniformLocation(shaderProgram, "useTexture"), 0);
-        glUniform1i(glGetUniformLocation(shaderProgram, "texture_diffuse1"), 0);
-        glActiveTexture(GL_TEXTURE0);
         // Bind default white texture to avoid "unloadable texture" errors
-        glBindTexture(GL_TEXTURE_2D, defaultWhiteTexture);
+        state.bindTexture(0, GL_TEXTURE_2D, defaultWhiteTexture);
 
-        // Sun lighting uniforms
+        // View, lighting and sky values shared by every draw, handed to each shader
+        // permutation the first time it is bound this frame
         glm::vec3 sunDirection = glm::normalize(sunPosition);
         glm::vec3 sunColor = glm::vec3(1.0f, 0.95f, 0.8f);
-        glUniform3fv(glGetUniformLocation(shaderProgram, "sunDirection"), 1, glm::value_ptr(sunDirection));
-        glUniform3fv(glGetUniformLocation(shaderProgram, "sunColor"), 1, glm::value_ptr(sunColor));
-        glUniform3fv(glGetUniformLocation(shaderProgram, "viewPos"), 1, glm::value_ptr(camera.Position));
-        glUniform3fv(glGetUniformLocation(shaderProgram, "sunPos"), 1, glm::value_ptr(sunPosition));
+        glm::vec3 viewPos = camera.Position;
+        auto frameSetup = [view, projection, sunDirection, sunColor, viewPos, sunPosition, &skybox](ShaderProgram &program)
+        {
+            program.set("view", view);
+            program.set("projection", projection);
+
+            // Sun lighting uniforms
+            program.set("sunDirection", sunDirection);
+            program.set("sunColor", sunColor);
+            program.set("viewPos", viewPos);
+            program.set("sunPos", sunPosition);
+
+            // Sky-aware ambient: 9 SH coefficients plus the prefiltered reflection cube on unit 1
+            skybox.getEnvironment().bind(program, skybox.getEnvironmentRotation(), 1);
+        };
+        ShaderPermutations &shaders = ShaderPermutations::Get();
+        shaders.beginFrame(frameSetup);
+
+        // Scene draws below are submitted as packets and issued, sorted, before the HUD
+        RenderQueue &renderQueue = RenderQueue::Get();
+        renderQueue.begin(camera.Position, camera.Front, 100.0f);
+        // Objects outside the view are dropped before they reach the queue
+        FrustumCuller::Get().setViewProjection(projection * view);
+        // ...and, with SIMPLECATAPULT_OCCLUSION, those hidden behind the walls: in last frame's
+        // GPU queries, or in this frame's CPU depth buffer
+        OcclusionCuller &occlusion = OcclusionCuller::Get();
+        occlusion.beginFrame(camera.Position);
+        SoftwareOcclusion &softwareOcclusion = SoftwareOcclusion::Get();
+        softwareOcclusion.render(projection * view);
 
         // ===== Update Catapult Animation =====
         catapult.update(deltaTime);
@@ -1381,16 +1488,11 @@ int main()
         }
 
         // ===== Draw Terrain =====
-        glUniform3f(colorLoc, 0.4f, 0.3f, 0.2f); // Brown/mud color as fallback
-        terrain.draw(shaderProgram);
+        terrain.draw();
 
         // ===== Draw Catapult =====
-        glUniform1i(glGetUniformLocation(shaderProgram, "useTexture"), 0);
-        glUniform1i(glGetUniformLocation(shaderProgram, "texture_diffuse1"), 0);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, defaultWhiteTexture);
         // Use terrain height and normal for catapult (gravity applied, tilts with slope)
-        catapult.draw(shaderProgram, catapultTerrainHeight, catapultTerrainNormal);
+        catapult.draw(catapultTerrainHeight, catapultTerrainNormal);
 
         // ===== Update & Draw Bomb =====
         if (bomb)
@@ -1509,29 +1611,114 @@ int main()
                 }
             }
 
-            // Reset texture state for bomb
-            glUniform1i(glGetUniformLocation(shaderProgram, "useTexture"), 0);
-            glUniform1i(glGetUniformLocation(shaderProgram, "texture_diffuse1"), 0);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, defaultWhiteTexture);
-            glUniform3f(colorLoc, 0.35f, 0.3f, 0.25f);
-            bomb->draw(shaderProgram);
+            bomb->draw();
         }
 
         // ===== Draw Zombies =====
+        static std::vector<Zombie *> liveZombies;
+        static CullBounds zombieBounds;
+        static std::vector<uint8_t> zombieVisible;
+        liveZombies.clear();
+        zombieBounds.clear();
         for (auto *zombie : zombies)
         {
             if (zombie && zombie->isAlive())
             {
-                zombie->draw(shaderProgram);
+                liveZombies.push_back(zombie);
+                zombie->addBounds(zombieBounds);
             }
         }
+        FrustumCuller::Get().test(zombieBounds, zombieVisible);
+        softwareOcclusion.test(zombieBounds, zombieVisible);
+        for (size_t i = 0; i < liveZombies.size(); i++)
+        {
+            if (!zombieVisible[i])
+                continue;
+            glm::vec3 boundsMin, boundsMax;
+            zombieBounds.box(i, boundsMin, boundsMax);
+            unsigned int occlusionQuery = 0;
+            if (occlusion.request(liveZombies[i], boundsMin, boundsMax, occlusionQuery))
+                liveZombies[i]->draw(occlusionQuery);
+        }
+
+        // ===== Issue Scene Draws =====
+        occlusion.beginScene();
+        renderQueue.flush();
+        terrain.drawImpostors(frameSetup);
+        terrain.drawGrass(frameSetup, currentFrame);
+        occlusion.endScene();
+        // Box proxies against the finished depth buffer, read back next frame or later
+        occlusion.issueQueries(projection * view);
 
         // ===== Draw Health Bar =====
-        renderHealthBar(window, shaderProgram, catapult.getHealth(), catapult.getMaxHealth(), projection, view);
+        renderHealthBar(window, catapult.getHealth(), catapult.getMaxHealth(), projection, view);
 
         glfwSwapBuffers(window);
         glfwPollEvents();
+
+        // ===== Render Stats =====
+        ShaderProgram::EndFrame();
+        GLState::EndFrame();
+        FrustumCuller::EndFrame();
+        OcclusionCuller::EndFrame();
+        SoftwareOcclusion::EndFrame();
+        Model::EndFrame();
+        GrassField::EndFrame();
+        static double lastStatsTime = 0.0;
+        if (renderStats && glfwGetTime() - lastStatsTime >= 1.0)
+        {
+            lastStatsTime = glfwGetTime();
+            const ShaderProgram::Stats &uniforms = ShaderProgram::LastFrameStats();
+            const GLState::Stats &bindings = GLState::LastFrameStats();
+            const RenderQueue::Stats &queue = RenderQueue::LastFrameStats();
+            const FrustumCuller::Stats &culling = FrustumCuller::LastFrameStats();
+            std::cout << "Frame: " << uniforms.issued << " uniform updates issued, " << uniforms.skipped
+                      << " skipped as unchanged; " << bindings.issued << " state changes issued, " << bindings.elided
+                      << " elided" << std::endl;
+            std::cout << "Render queue: " << queue.packets << " packets, " << queue.triangles << " triangles, "
+                      << queue.unsortedChanges << " program/texture/VAO switches in submission order, "
+                      << queue.sortedChanges << " sorted" << std::endl;
+            const Model::MeshletStats &meshlets = Model::LastFrameMeshletStats();
+            std::cout << "Meshlets: " << meshlets.frustumCulled << " outside the frustum of " << meshlets.tested
+                      << " tested; " << meshlets.trianglesCulled
+                      << " triangles not submitted" << std::endl;
+            std::cout << "Culling: " << culling.visible << " of " << culling.submitted << " objects visible; "
+                      << terrain.getImpostorCount() << " trees as impostors" << std::endl;
+            const GrassField::Stats &grass = GrassField::LastFrameStats();
+            std::cout << "Grass: " << grass.chunksDrawn << " chunks drawn, " << grass.chunksSkipped << " skipped, "
+                      << grass.blades << " blades" << std::endl;
+            if (OcclusionCuller::Get().isEnabled())
+            {
+                const OcclusionCuller::Stats &occlusionStats = OcclusionCuller::LastFrameStats();
+                std::cout << "Occlusion: " << occlusionStats.tested << " proxies tested, " << occlusionStats.skipped
+                          << " instances skipped, " << occlusionStats.conditional
+                          << " drawn under conditional rendering; " << occlusionStats.pixelsShaded
+                          << " pixels shaded" << std::endl;
+            }
+            if (SoftwareOcclusion::Get().isRunning())
+            {
+                const SoftwareOcclusion::Stats &software = SoftwareOcclusion::LastFrameStats();
+                std::cout << "Software occlusion: " << software.rejected << " of " << software.tested
+                          << " objects rejected; " << software.occluderTriangles << " occluder triangles in "
+                          << software.rasterMs << " ms, tests " << software.testMs << " ms" << std::endl;
+            }
+        }
+
+        // Two separate milestones: something playable on screen, and every requested asset resident
+        static bool firstFrameReported = false;
+        if (!firstFrameReported)
+        {
+            firstFrameReported = true;
+            std::cout << "Time to first frame: " << glfwGetTime() * 1000.0 << " ms" << std::endl;
+        }
+        static bool fullFidelityReported = false;
+        if (!fullFidelityReported && startup.isFinished() && AssetStreamer::Get().isIdle() &&
+            TextureUploader::Get().isIdle())
+        {
+            fullFidelityReported = true;
+            std::cout << "Time to full fidelity: " << glfwGetTime() * 1000.0 << " ms (startup graph "
+                      << startup.getTotalMs() << " ms)" << std::endl;
+        }
     }
 
     // Cleanup zombies
@@ -1541,6 +1728,17 @@ int main()
     }
     zombies.clear();
 
+    // Stop the workers while the GL context is still alive; startup work left over from a
+    // window closed early is dropped rather than run
+    startup.cancel();
+    AssetStreamer::Get().shutdown();
+    TextureUploader::Get().shutdown();
+    TextureResidency::Get().shutdown();
+    TextureArrays::Get().shutdown();
+    ShaderPermutations::Get().shutdown();
+    OcclusionCuller::Get().shutdown();
+    SoftwareOcclusion::Get().shutdown();
+
     glfwTerminate();
     return 0;
 }
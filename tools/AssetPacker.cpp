@@ -0,0 +1,320 @@
+// AssetPacker: bundles images/ and shaders/ into a single assets.pak, plus the
+// material texture arrays baked from them (see TextureArrays.h)
+// Usage: AssetPacker <source root> <output file>
+#include "AssetPack.h"
+#include "TextureArrays.h"
+#include "../third_party/stb_image.h"
+#include "ImageRows.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+struct PackInput
+{
+    std::string key;    // Normalized path stored in the pack
+    fs::path diskPath;  // Where the bytes come from
+    std::vector<unsigned char> bytes; // Generated at pack time instead, when diskPath is empty
+    uint64_t size;
+};
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static void collectFiles(const fs::path &root, const std::string &folder, std::vector<PackInput> &inputs)
+{
+    fs::path dir = root / folder;
+    if (!fs::is_directory(dir))
+    {
+        std::cerr << "Skipping missing folder: " << dir.string() << std::endl;
+        return;
+    }
+
+    for (const auto &item : fs::recursive_directory_iterator(dir))
+    {
+        if (!item.is_regular_file())
+            continue;
+
+        // Skip OS metadata such as .DS_Store
+        std::string name = item.path().filename().string();
+        if (!name.empty() && name[0] == '.')
+            continue;
+
+        PackInput input;
+        input.key = AssetPack::NormalizePath(folder + "/" + fs::relative(item.path(), dir).generic_string());
+        input.diskPath = item.path();
+        input.size = static_cast<uint64_t>(item.file_size());
+        inputs.push_back(input);
+    }
+}
+
+// ===== Texture arrays =====
+struct Image
+{
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> pixels; // RGBA8
+};
+
+// 2x2 box filter, so large reductions average every source texel instead of skipping most
+static Image halve(const Image &src)
+{
+    Image dst;
+    dst.width = std::max(1, src.width / 2);
+    dst.height = std::max(1, src.height / 2);
+    dst.pixels.resize(static_cast<size_t>(dst.width) * dst.height * 4);
+    for (int y = 0; y < dst.height; y++)
+    {
+        int y0 = std::min(src.height - 1, y * 2), y1 = std::min(src.height - 1, y * 2 + 1);
+        for (int x = 0; x < dst.width; x++)
+        {
+            int x0 = std::min(src.width - 1, x * 2), x1 = std::min(src.width - 1, x * 2 + 1);
+            for (int c = 0; c < 4; c++)
+            {
+                int sum = src.pixels[(static_cast<size_t>(y0) * src.width + x0) * 4 + c] +
+                          src.pixels[(static_cast<size_t>(y0) * src.width + x1) * 4 + c] +
+                          src.pixels[(static_cast<size_t>(y1) * src.width + x0) * 4 + c] +
+                          src.pixels[(static_cast<size_t>(y1) * src.width + x1) * 4 + c];
+                dst.pixels[(static_cast<size_t>(y) * dst.width + x) * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
+            }
+        }
+    }
+    return dst;
+}
+
+// Halves while the image is at least twice the target, then finishes with a bilinear resample
+static Image resize(Image image, int edge)
+{
+    while (image.width >= edge * 2 && image.height >= edge * 2)
+        image = halve(image);
+    if (image.width == edge && image.height == edge)
+        return image;
+
+    Image dst;
+    dst.width = edge;
+    dst.height = edge;
+    dst.pixels.resize(static_cast<size_t>(edge) * edge * 4);
+    for (int y = 0; y < edge; y++)
+    {
+        float sy = std::max(0.0f, (y + 0.5f) * image.height / edge - 0.5f);
+        int y0 = std::min(image.height - 1, static_cast<int>(sy)), y1 = std::min(image.height - 1, y0 + 1);
+        float fy = sy - y0;
+        for (int x = 0; x < edge; x++)
+        {
+            float sx = std::max(0.0f, (x + 0.5f) * image.width / edge - 0.5f);
+            int x0 = std::min(image.width - 1, static_cast<int>(sx)), x1 = std::min(image.width - 1, x0 + 1);
+            float fx = sx - x0;
+            for (int c = 0; c < 4; c++)
+            {
+                auto at = [&](int px, int py)
+                { return static_cast<float>(image.pixels[(static_cast<size_t>(py) * image.width + px) * 4 + c]); };
+                float top = at(x0, y0) + (at(x1, y0) - at(x0, y0)) * fx;
+                float bottom = at(x0, y1) + (at(x1, y1) - at(x0, y1)) * fx;
+                dst.pixels[(static_cast<size_t>(y) * edge + x) * 4 + c] = static_cast<unsigned char>(top + (bottom - top) * fy + 0.5f);
+            }
+        }
+    }
+    return dst;
+}
+
+static bool bakeTextureArray(const fs::path &root, const TextureArrayDefinition &definition, PackInput &input)
+{
+    std::vector<std::string> paths;
+    std::vector<Image> images;
+    for (const char *layer : definition.layers)
+    {
+        Image image;
+        int components = 0;
+        unsigned char *pixels = stbi_load((root / layer).string().c_str(), &image.width, &image.height, &components, 4);
+        if (!pixels)
+        {
+            std::cerr << "Skipping texture array layer " << layer << ": " << stbi_failure_reason() << std::endl;
+            continue;
+        }
+        // Bottom row first, like the 2D textures the game decodes itself
+        FlipImageRows(pixels, image.width, image.height, 4);
+        image.pixels.assign(pixels, pixels + static_cast<size_t>(image.width) * image.height * 4);
+        stbi_image_free(pixels);
+        paths.push_back(layer);
+        images.push_back(std::move(image));
+    }
+    if (images.empty())
+        return false;
+
+    // Shared edge: the largest power of two that no layer has to be enlarged to reach
+    int edge = definition.maxEdge;
+    for (const Image &image : images)
+    {
+        while (edge > 1 && (edge > image.width || edge > image.height))
+            edge /= 2;
+    }
+
+    TextureArrayHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, TEXTURE_ARRAY_MAGIC, 4);
+    header.version = TEXTURE_ARRAY_VERSION;
+    header.width = edge;
+    header.height = edge;
+    header.layerCount = static_cast<uint32_t>(images.size());
+
+    std::vector<TextureArrayLayer> table(images.size());
+    std::string strings;
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        table[i].pathOffset = static_cast<uint32_t>(strings.size());
+        table[i].pathLength = static_cast<uint32_t>(paths[i].size());
+        strings += paths[i];
+    }
+    header.stringTableSize = static_cast<uint32_t>(strings.size());
+    header.dataOffset = alignUp(sizeof(header) + table.size() * sizeof(TextureArrayLayer) + strings.size(), 16);
+
+    std::vector<unsigned char> &bytes = input.bytes;
+    bytes.assign(static_cast<size_t>(header.dataOffset), 0);
+    std::memcpy(bytes.data(), &header, sizeof(header));
+    std::memcpy(bytes.data() + sizeof(header), table.data(), table.size() * sizeof(TextureArrayLayer));
+    std::memcpy(bytes.data() + sizeof(header) + table.size() * sizeof(TextureArrayLayer), strings.data(), strings.size());
+    for (Image &image : images)
+    {
+        Image layer = resize(std::move(image), edge);
+        bytes.insert(bytes.end(), layer.pixels.begin(), layer.pixels.end());
+    }
+
+    input.key = AssetPack::NormalizePath(definition.key);
+    input.size = bytes.size();
+    std::cout << "Baked " << input.key << ": " << images.size() << " layers at " << edge << "x" << edge << std::endl;
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: AssetPacker <source root> <output file>" << std::endl;
+        return 1;
+    }
+
+    fs::path root = argv[1];
+    std::string outputPath = argv[2];
+
+    std::vector<PackInput> inputs;
+    collectFiles(root, "images", inputs);
+    collectFiles(root, "shaders", inputs);
+    for (const TextureArrayDefinition &definition : GetTextureArrayDefinitions())
+    {
+        PackInput input;
+        if (bakeTextureArray(root, definition, input))
+            inputs.push_back(std::move(input));
+    }
+
+    std::sort(inputs.begin(), inputs.end(), [](const PackInput &a, const PackInput &b)
+              { return AssetPack::HashPath(a.key) < AssetPack::HashPath(b.key); });
+
+    // Directory and string table
+    std::vector<PackEntry> entries(inputs.size());
+    std::string stringTable;
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        PackEntry &entry = entries[i];
+        std::memset(&entry, 0, sizeof(entry));
+        entry.pathHash = AssetPack::HashPath(inputs[i].key);
+        entry.size = inputs[i].size;
+        entry.pathOffset = static_cast<uint32_t>(stringTable.size());
+        entry.pathLength = static_cast<uint32_t>(inputs[i].key.size());
+        stringTable += inputs[i].key;
+
+        if (i > 0 && entries[i - 1].pathHash == entry.pathHash)
+            std::cout << "Note: hash collision between " << inputs[i - 1].key << " and " << inputs[i].key << std::endl;
+    }
+
+    PackHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, PACK_MAGIC, 4);
+    header.version = PACK_VERSION;
+    header.entryCount = static_cast<uint32_t>(entries.size());
+    header.stringTableOffset = sizeof(PackHeader) + entries.size() * sizeof(PackEntry);
+    header.stringTableSize = stringTable.size();
+
+    // Lay out the data blobs
+    uint64_t offset = alignUp(header.stringTableOffset + header.stringTableSize, PACK_DATA_ALIGNMENT);
+    for (auto &entry : entries)
+    {
+        entry.offset = offset;
+        offset = alignUp(offset + entry.size, PACK_DATA_ALIGNMENT);
+    }
+
+    std::ofstream out(outputPath, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        std::cerr << "Failed to open output: " << outputPath << std::endl;
+        return 1;
+    }
+
+    // Header and directory are rewritten once the content hashes are known
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(PackEntry));
+    out.write(stringTable.data(), stringTable.size());
+
+    std::vector<char> buffer(1 << 20);
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        PackEntry &entry = entries[i];
+
+        // Zero padding up to the aligned start of this blob
+        uint64_t position = static_cast<uint64_t>(out.tellp());
+        std::vector<char> padding(static_cast<size_t>(entry.offset - position), 0);
+        out.write(padding.data(), padding.size());
+
+        if (inputs[i].diskPath.empty())
+        {
+            const std::vector<unsigned char> &bytes = inputs[i].bytes;
+            entry.contentHash = AssetPack::HashBytes(bytes.data(), bytes.size());
+            out.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+            continue;
+        }
+
+        std::ifstream in(inputs[i].diskPath, std::ios::binary);
+        if (!in)
+        {
+            std::cerr << "Failed to read: " << inputs[i].diskPath.string() << std::endl;
+            return 1;
+        }
+
+        uint64_t hash = 1469598103934665603ULL;
+        uint64_t remaining = entry.size;
+        while (remaining > 0)
+        {
+            size_t chunk = static_cast<size_t>(std::min<uint64_t>(remaining, buffer.size()));
+            in.read(buffer.data(), chunk);
+            if (static_cast<size_t>(in.gcount()) != chunk)
+            {
+                std::cerr << "Short read: " << inputs[i].diskPath.string() << std::endl;
+                return 1;
+            }
+            hash = AssetPack::HashBytes(buffer.data(), chunk, hash);
+            out.write(buffer.data(), chunk);
+            remaining -= chunk;
+        }
+        entry.contentHash = hash;
+    }
+
+    out.seekp(0);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(PackEntry));
+
+    if (!out)
+    {
+        std::cerr << "Failed to write: " << outputPath << std::endl;
+        return 1;
+    }
+
+    std::cout << "Packed " << entries.size() << " files (" << offset / (1024 * 1024) << " MB) into " << outputPath << std::endl;
+    return 0;
+}